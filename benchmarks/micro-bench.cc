@@ -0,0 +1,730 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+/*
+ * Microbenchmarks of the building blocks of a step: the semaphore handoff,
+ * the message interface round trip and the encoding and decoding of the
+ * containers. Results are written as JSON, one entry per benchmark with the
+ * median and the best nanoseconds per operation over the repetitions.
+ *
+ *   ./ns3 run "ns3penv-micro-bench --output=micro.json --filter=box/float"
+ */
+
+#include <ns3/abort.h>
+#include <ns3/command-line.h>
+#include <ns3/ns3penv-module.h>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ns3;
+
+namespace
+{
+
+/// Shortest duration of one timed repetition
+constexpr std::chrono::nanoseconds MIN_REPETITION_TIME = std::chrono::milliseconds(20);
+
+/// Keeps the compiler from optimizing away the work behind p
+template <typename T>
+void
+Escape(T* p)
+{
+    asm volatile("" : : "g"(p) : "memory");
+}
+
+struct Result
+{
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> params;
+    uint64_t iterations; //!< per repetition
+    double medianNs;     //!< per operation
+    double minNs;        //!< per operation
+};
+
+class Suite
+{
+  public:
+    Suite(std::string filter, uint32_t repetitions)
+        : m_filter(std::move(filter)),
+          m_repetitions(repetitions)
+    {
+    }
+
+    /**
+     * Runs op in repetitions long enough to time, unless name does not
+     * match the filter
+     */
+    void Run(const std::string& name,
+             std::vector<std::pair<std::string, std::string>> params,
+             const std::function<void()>& op)
+    {
+        std::string fullName = name;
+        for (const auto& [key, value] : params)
+        {
+            fullName += "/" + value;
+        }
+        if (fullName.find(m_filter) == std::string::npos)
+        {
+            return;
+        }
+        // calibrate the iterations, which also warms up
+        uint64_t iterations = 1;
+        while (Time(op, iterations) < MIN_REPETITION_TIME && iterations < (1ULL << 30))
+        {
+            iterations *= 2;
+        }
+        std::vector<double> perOp;
+        for (uint32_t r = 0; r < m_repetitions; ++r)
+        {
+            perOp.push_back(double(Time(op, iterations).count()) / iterations);
+        }
+        std::sort(perOp.begin(), perOp.end());
+        m_results.push_back(
+            {fullName, std::move(params), iterations, perOp[perOp.size() / 2], perOp.front()});
+        std::cerr << fullName << ": " << perOp[perOp.size() / 2] << " ns" << std::endl;
+    }
+
+    void WriteJson(std::ostream& os) const
+    {
+        os << "{\n  \"suite\": \"micro\",\n";
+        os << "  \"context\": {\"cpus\": " << std::thread::hardware_concurrency()
+           << ", \"compiler\": \"" << __VERSION__ << "\", \"repetitions\": " << m_repetitions
+           << "},\n";
+        os << "  \"results\": [";
+        for (std::size_t i = 0; i < m_results.size(); ++i)
+        {
+            const Result& result = m_results[i];
+            os << (i ? ",\n" : "\n") << "    {\"name\": \"" << result.name << "\", \"params\": {";
+            for (std::size_t j = 0; j < result.params.size(); ++j)
+            {
+                os << (j ? ", " : "") << "\"" << result.params[j].first << "\": \""
+                   << result.params[j].second << "\"";
+            }
+            os << "}, \"iterations\": " << result.iterations
+               << ", \"ns_per_op\": " << result.medianNs << ", \"min_ns_per_op\": " << result.minNs
+               << "}";
+        }
+        os << "\n  ]\n}\n";
+    }
+
+  private:
+    static std::chrono::nanoseconds Time(const std::function<void()>& op, uint64_t iterations)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            op();
+        }
+        return std::chrono::steady_clock::now() - start;
+    }
+
+    std::string m_filter;
+    uint32_t m_repetitions;
+    std::vector<Result> m_results;
+};
+
+const char*
+WaitModeName(Ns3penvWaitMode mode)
+{
+    switch (mode)
+    {
+    case Ns3penvWaitMode::SPIN:
+        return "spin";
+    case Ns3penvWaitMode::SPIN_YIELD:
+        return "spin_yield";
+    case Ns3penvWaitMode::SPIN_FUTEX:
+        return "spin_futex";
+    }
+    return "unknown";
+}
+
+/**
+ * Pure spinning only makes sense with a core per side
+ */
+std::vector<Ns3penvWaitMode>
+WaitModes()
+{
+    std::vector<Ns3penvWaitMode> modes{Ns3penvWaitMode::SPIN_YIELD, Ns3penvWaitMode::SPIN_FUTEX};
+    if (std::thread::hardware_concurrency() > 1)
+    {
+        modes.insert(modes.begin(), Ns3penvWaitMode::SPIN);
+    }
+    return modes;
+}
+
+void
+BenchSemaphore(Suite& suite, uint32_t spinBudget)
+{
+    Ns3penvSemaphoreWord word(0);
+    suite.Run("semaphore/uncontended", {}, [&word, spinBudget]() {
+        Ns3penvSemaphore::sem_post(&word);
+        Ns3penvSemaphore::sem_wait(&word, Ns3penvWaitMode::SPIN, spinBudget);
+    });
+
+    for (Ns3penvWaitMode mode : WaitModes())
+    {
+        // ping and pong each on their own cache line, as in Ns3penvMsgSync
+        Ns3penvMsgChannel channel;
+        channel.m_emptyCount.m_count = 0;
+        std::atomic<bool> stop{false};
+        std::thread peer([&]() {
+            while (true)
+            {
+                Ns3penvSemaphore::sem_wait(&channel.m_fullCount, mode, spinBudget);
+                if (stop.load(std::memory_order_relaxed))
+                {
+                    return;
+                }
+                Ns3penvSemaphore::sem_post(&channel.m_emptyCount);
+            }
+        });
+        suite.Run("semaphore/handoff", {{"wait_mode", WaitModeName(mode)}}, [&]() {
+            Ns3penvSemaphore::sem_post(&channel.m_fullCount);
+            Ns3penvSemaphore::sem_wait(&channel.m_emptyCount, mode, spinBudget);
+        });
+        stop = true;
+        Ns3penvSemaphore::sem_post(&channel.m_fullCount);
+        peer.join();
+    }
+}
+
+/// One record of the vector interface, a struct of N of them for the struct one
+struct BenchRecord
+{
+    double values[8];
+};
+
+template <uint32_t N>
+struct BenchBlock
+{
+    BenchRecord records[N];
+};
+
+/**
+ * A C++ to Python to C++ round trip between two threads, each with its own
+ * mapping of the segment, the Python side copying the state into the reply
+ */
+template <typename Msg, bool UseVector>
+void
+BenchRoundTrip(Suite& suite,
+               const std::string& name,
+               std::vector<std::pair<std::string, std::string>> params,
+               uint32_t vectorSize,
+               Ns3penvWaitMode mode,
+               uint32_t spinBudget)
+{
+    typedef Ns3penvMsgInterfaceImpl<Msg, Msg> Impl;
+    std::string segName = "ns3penv-bench-" + std::to_string(getpid());
+    Impl py(true,
+            UseVector,
+            false,
+            1 << 24,
+            segName.c_str(),
+            "cpp2py",
+            "py2cpp",
+            "lockable",
+            mode,
+            spinBudget);
+    if constexpr (UseVector)
+    {
+        py.GetCpp2PyVector()->resize(vectorSize);
+        py.GetPy2CppVector()->resize(vectorSize);
+    }
+    Impl cpp(false,
+             UseVector,
+             false,
+             1 << 24,
+             segName.c_str(),
+             "cpp2py",
+             "py2cpp",
+             "lockable",
+             mode,
+             spinBudget);
+
+    std::atomic<bool> stop{false};
+    std::thread peer([&]() {
+        while (true)
+        {
+            py.PyRecvBegin();
+            if (stop.load(std::memory_order_relaxed))
+            {
+                py.PyRecvEnd();
+                return;
+            }
+            py.PySendBegin();
+            if constexpr (UseVector)
+            {
+                std::copy(py.GetCpp2PyVector()->begin(),
+                          py.GetCpp2PyVector()->end(),
+                          py.GetPy2CppVector()->begin());
+            }
+            else
+            {
+                *py.GetPy2CppStruct() = *py.GetCpp2PyStruct();
+            }
+            py.PyRecvEnd();
+            py.PySendEnd();
+        }
+    });
+
+    Msg state{};
+    double value = 0;
+    params.emplace_back("wait_mode", WaitModeName(mode));
+    suite.Run(name, std::move(params), [&]() {
+        value += 1;
+        cpp.CppSendBegin();
+        if constexpr (UseVector)
+        {
+            for (auto& element : *cpp.GetCpp2PyVector())
+            {
+                element.values[0] = value;
+            }
+        }
+        else
+        {
+            *cpp.GetCpp2PyStruct() = state;
+            cpp.GetCpp2PyStruct()->records[0].values[0] = value;
+        }
+        cpp.CppSendEnd();
+        cpp.CppRecvBegin();
+        if constexpr (UseVector)
+        {
+            Escape(&(*cpp.GetPy2CppVector())[0]);
+        }
+        else
+        {
+            state = *cpp.GetPy2CppStruct();
+        }
+        cpp.CppRecvEnd();
+    });
+
+    stop = true;
+    cpp.CppSendBegin();
+    cpp.CppSendEnd();
+    peer.join();
+    py.CleanSharedMemory();
+}
+
+void
+BenchMsgInterface(Suite& suite, uint32_t spinBudget)
+{
+    for (Ns3penvWaitMode mode : WaitModes())
+    {
+        BenchRoundTrip<BenchBlock<1>, false>(suite,
+                                             "msg_interface/round_trip",
+                                             {{"layout", "struct"}, {"records", "1"}},
+                                             0,
+                                             mode,
+                                             spinBudget);
+        BenchRoundTrip<BenchBlock<64>, false>(suite,
+                                              "msg_interface/round_trip",
+                                              {{"layout", "struct"}, {"records", "64"}},
+                                              0,
+                                              mode,
+                                              spinBudget);
+        BenchRoundTrip<BenchRecord, true>(suite,
+                                          "msg_interface/round_trip",
+                                          {{"layout", "vector"}, {"records", "1"}},
+                                          1,
+                                          mode,
+                                          spinBudget);
+        BenchRoundTrip<BenchRecord, true>(suite,
+                                          "msg_interface/round_trip",
+                                          {{"layout", "vector"}, {"records", "64"}},
+                                          64,
+                                          mode,
+                                          spinBudget);
+    }
+}
+
+/// Reads a connection in large chunks, as the frames of a batch come in together
+class BufferedReader
+{
+  public:
+    explicit BufferedReader(int fd)
+        : m_fd(fd),
+          m_buffer(256 * 1024),
+          m_start(0),
+          m_end(0)
+    {
+    }
+
+    /// Reads size bytes, false once the peer has closed the connection
+    bool Read(void* data, std::size_t size)
+    {
+        auto* bytes = static_cast<uint8_t*>(data);
+        while (size > 0)
+        {
+            if (m_start == m_end)
+            {
+                ssize_t received = recv(m_fd, m_buffer.data(), m_buffer.size(), 0);
+                if (received <= 0)
+                {
+                    return false;
+                }
+                m_start = 0;
+                m_end = received;
+            }
+            std::size_t count = std::min(size, m_end - m_start);
+            std::memcpy(bytes, m_buffer.data() + m_start, count);
+            m_start += count;
+            bytes += count;
+            size -= count;
+        }
+        return true;
+    }
+
+  private:
+    int m_fd;
+    std::vector<uint8_t> m_buffer;
+    std::size_t m_start;
+    std::size_t m_end;
+};
+
+/**
+ * Listens on a loopback port and serves one connection of a socket
+ * transport the way the Python side does: greets it, then echoes every
+ * message and drops the streamed records until it is closed
+ */
+std::thread
+ServeLoopbackAgent(std::string& address)
+{
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(addr);
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&addr), length) != 0 ||
+        listen(listener, 1) != 0 ||
+        getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &length) != 0)
+    {
+        std::cerr << "Cannot listen on a loopback port" << std::endl;
+        std::exit(1);
+    }
+    address = "tcp://127.0.0.1:" + std::to_string(ntohs(addr.sin_port));
+
+    return std::thread([listener]() {
+        int fd = accept(listener, nullptr, nullptr);
+        close(listener);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        Ns3penvFrameHeader hello{sizeof(uint64_t), NS3PENV_FRAME_HELLO};
+        uint64_t spaceHash = 0;
+        iovec helloIov[2] = {{&hello, sizeof(hello)}, {&spaceHash, sizeof(spaceHash)}};
+        msghdr helloMsg{};
+        helloMsg.msg_iov = helloIov;
+        helloMsg.msg_iovlen = 2;
+        sendmsg(fd, &helloMsg, MSG_NOSIGNAL);
+
+        BufferedReader reader(fd);
+        Ns3penvFrameHeader header;
+        std::vector<uint8_t> payload;
+        while (reader.Read(&header, sizeof(header)))
+        {
+            payload.resize(header.size);
+            if (!reader.Read(payload.data(), payload.size()))
+            {
+                break;
+            }
+            if (header.channel == NS3PENV_FRAME_MESSAGE)
+            {
+                iovec iov[2] = {{&header, sizeof(header)}, {payload.data(), payload.size()}};
+                msghdr msg{};
+                msg.msg_iov = iov;
+                msg.msg_iovlen = 2;
+                sendmsg(fd, &msg, MSG_NOSIGNAL);
+            }
+        }
+        close(fd);
+    });
+}
+
+/**
+ * A state of size bytes there and back through a transport, and records
+ * of size bytes streamed through it, one per operation
+ */
+void
+BenchTransport(Suite& suite,
+               const std::string& backend,
+               Ns3penvTransport& transport,
+               uint32_t size)
+{
+    std::vector<std::pair<std::string, std::string>> params{{"backend", backend},
+                                                            {"size", std::to_string(size)}};
+    uint8_t value = 0;
+    suite.Run("transport/round_trip", params, [&]() {
+        transport.CppSendBegin();
+        Ns3penvGymMsg* msg = transport.GetCpp2PyStruct();
+        transport.Reserve(msg, size);
+        msg->size = size;
+        msg->buffer.get()[0] = ++value;
+        transport.CppSendEnd();
+        transport.CppRecvBegin();
+        Escape(transport.GetPy2CppStruct()->buffer.get());
+        transport.CppRecvEnd();
+    });
+
+    std::vector<uint8_t> record(size);
+    suite.Run("transport/stream", params, [&]() {
+        record[0] = ++value;
+        while (!transport.CppTrySend(record.data(), record.size()))
+        {
+            std::this_thread::yield();
+        }
+    });
+}
+
+/**
+ * The shared memory segment against the socket transport on loopback, for
+ * a few state sizes. The agent ends are threads: the shm one copies the
+ * state into the reply as the Python binding does and drains the ring.
+ */
+void
+BenchTransports(Suite& suite, const std::vector<uint32_t>& sizes, uint32_t spinBudget)
+{
+    typedef Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg> Impl;
+    std::string segName = "ns3penv-bench-transport-" + std::to_string(getpid());
+    Impl py(true,
+            false,
+            false,
+            1 << 26,
+            segName.c_str(),
+            "cpp2py",
+            "py2cpp",
+            "lockable",
+            Ns3penvWaitMode::SPIN_FUTEX,
+            spinBudget,
+            64);
+    Impl cpp(false,
+             false,
+             false,
+             1 << 26,
+             segName.c_str(),
+             "cpp2py",
+             "py2cpp",
+             "lockable",
+             Ns3penvWaitMode::SPIN_FUTEX,
+             spinBudget);
+
+    std::atomic<bool> stop{false};
+    std::thread peer([&]() {
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            while (py.PyTryRecv([](const uint8_t* data, uint32_t) { Escape(data); }))
+            {
+            }
+            if (py.PyRecvBeginFor(10) != Ns3penvWaitStatus::OK)
+            {
+                continue;
+            }
+            Ns3penvGymMsg* state = py.GetCpp2PyStruct();
+            if (state->size == 0)
+            {
+                py.PyRecvEnd();
+                return;
+            }
+            py.PySendBegin();
+            Ns3penvGymMsg* reply = py.GetPy2CppStruct();
+            py.Reserve(reply, state->size);
+            std::memcpy(reply->buffer.get(), state->buffer.get(), state->size);
+            reply->size = state->size;
+            py.PyRecvEnd();
+            py.PySendEnd();
+        }
+    });
+
+    Ns3penvShmTransport shm(&cpp);
+    for (uint32_t size : sizes)
+    {
+        BenchTransport(suite, "shm", shm, size);
+    }
+    stop = true;
+    cpp.CppSendBegin();
+    cpp.GetCpp2PyStruct()->size = 0;
+    cpp.CppSendEnd();
+    peer.join();
+    py.CleanSharedMemory();
+
+    std::string address;
+    std::thread agent = ServeLoopbackAgent(address);
+    {
+        Ns3penvSocketTransport socket(address);
+        for (uint32_t size : sizes)
+        {
+            BenchTransport(suite, "socket", socket, size);
+        }
+        socket.Flush();
+    }
+    agent.join();
+}
+
+const char*
+DtypeName(ns3penv::Dtype dtype)
+{
+    switch (dtype)
+    {
+    case ns3penv::INT:
+        return "int32";
+    case ns3penv::UINT:
+        return "uint32";
+    case ns3penv::FLOAT:
+        return "float32";
+    case ns3penv::DOUBLE:
+        return "float64";
+    case ns3penv::INT8:
+        return "int8";
+    case ns3penv::UINT8:
+        return "uint8";
+    case ns3penv::INT64:
+        return "int64";
+    case ns3penv::FLOAT16:
+        return "float16";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * Encoding and decoding of one box of every dtype and a few sizes: to
+ * protobuf, to the flat layout, and back by creating a new container or
+ * updating the one of the previous step
+ */
+void
+BenchBoxes(Suite& suite, const std::vector<uint32_t>& sizes)
+{
+    for (int dtype = ns3penv::INT; dtype <= ns3penv::FLOAT16; ++dtype)
+    {
+        for (uint32_t size : sizes)
+        {
+            OpenGymVisitDtype(ns3penv::Dtype(dtype), [&](auto type) {
+                typedef typename decltype(type)::type T;
+                std::vector<uint32_t> shape{size};
+                Ptr<OpenGymBoxContainer<T>> box = CreateObject<OpenGymBoxContainer<T>>(shape, T());
+                std::span<T> values = box->MutableView();
+                for (uint32_t i = 0; i < size; ++i)
+                {
+                    values[i] = T(i % 100);
+                }
+                std::vector<std::pair<std::string, std::string>> params{
+                    {"dtype", DtypeName(ns3penv::Dtype(dtype))},
+                    {"size", std::to_string(size)}};
+
+                std::string bytes;
+                suite.Run("box/encode", params, [&]() {
+                    box->GetDataContainerPbMsg().SerializeToString(&bytes);
+                    Escape(bytes.data());
+                });
+
+                std::vector<uint8_t> flat(box->GetFlatDataSize());
+                Ns3penvFlatStateHeader header;
+                suite.Run("box/encode_flat", params, [&]() {
+                    box->SerializeFlat(&header, flat.data());
+                    Escape(flat.data());
+                });
+
+                ns3penv::DataContainer msg;
+                suite.Run("box/decode_create", params, [&]() {
+                    msg.ParseFromString(bytes);
+                    Ptr<OpenGymDataContainer> data =
+                        OpenGymDataContainer::CreateFromDataContainerPbMsg(msg);
+                    Escape(PeekPointer(data));
+                });
+
+                Ptr<OpenGymDataContainer> reused =
+                    OpenGymDataContainer::CreateFromDataContainerPbMsg(msg);
+                suite.Run("box/decode_update", params, [&]() {
+                    msg.ParseFromString(bytes);
+                    reused->UpdateFromDataContainerPbMsg(msg);
+                    Escape(PeekPointer(reused));
+                });
+
+                ns3penv::SpaceDescription space;
+                space.mutable_box()->set_dtype(ns3penv::Dtype(dtype));
+                space.mutable_box()->add_shape(size);
+                Ptr<OpenGymActionDecoder> decoder = CreateObject<OpenGymActionDecoder>();
+                if (decoder->Compile(space))
+                {
+                    suite.Run("box/decode_compiled", params, [&]() {
+                        msg.ParseFromString(bytes);
+                        decoder->Decode(msg);
+                        Escape(PeekPointer(decoder));
+                    });
+                }
+            });
+        }
+    }
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    std::string output;
+    std::string filter;
+    uint32_t repetitions = 5;
+    uint32_t spinBudget = 64;
+    bool quick = false;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("output", "File to write the JSON results to, stdout if empty", output);
+    cmd.AddValue("filter", "Only run the benchmarks whose name contains this", filter);
+    cmd.AddValue("repetitions", "Timed repetitions of every benchmark", repetitions);
+    cmd.AddValue("spinBudget", "Spin budget of the waits", spinBudget);
+    cmd.AddValue("quick", "Only the smallest sizes, for a smoke run", quick);
+    cmd.Parse(argc, argv);
+    // the median is read from the repetitions
+    NS_ABORT_MSG_IF(repetitions == 0, "--repetitions must be at least 1");
+
+    Suite suite(filter, repetitions);
+    BenchSemaphore(suite, spinBudget);
+    BenchMsgInterface(suite, spinBudget);
+    BenchTransports(suite,
+                    quick ? std::vector<uint32_t>{64} : std::vector<uint32_t>{64, 4096, 65536},
+                    spinBudget);
+    BenchBoxes(suite,
+               quick ? std::vector<uint32_t>{16} : std::vector<uint32_t>{16, 1024, 65536});
+
+    if (output.empty())
+    {
+        suite.WriteJson(std::cout);
+    }
+    else
+    {
+        std::ofstream file(output);
+        suite.WriteJson(file);
+    }
+    return 0;
+}
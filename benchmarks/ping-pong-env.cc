@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+/*
+ * The environment of the macro benchmark: it does nothing but exchange a
+ * float Box observation of obsSize values and a Discrete action every
+ * simulated microsecond, so the steps per second it reaches are the
+ * ceiling of the interface. Driven by ping_pong.py.
+ */
+
+#include <ns3/command-line.h>
+#include <ns3/ns3penv-module.h>
+#include <ns3/simulator.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("Ns3penvPingPong");
+
+class PingPongEnv : public OpenGymEnv
+{
+  public:
+    PingPongEnv(uint32_t obsSize, uint32_t steps);
+    static TypeId GetTypeId();
+
+    Ptr<OpenGymSpace> GetActionSpace() override;
+    Ptr<OpenGymSpace> GetObservationSpace() override;
+    bool GetGameOver() override;
+    Ptr<OpenGymDataContainer> GetObservation() override;
+    float GetReward() override;
+    std::string GetExtraInfo() override;
+    bool ExecuteActions(Ptr<OpenGymDataContainer> action) override;
+
+    void Step();
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    uint32_t m_obsSize;
+    uint32_t m_steps;
+    uint32_t m_step;
+    Ptr<OpenGymBoxContainer<float>> m_obs; //!< the same container every step
+};
+
+PingPongEnv::PingPongEnv(uint32_t obsSize, uint32_t steps)
+    : m_obsSize(obsSize),
+      m_steps(steps),
+      m_step(0)
+{
+    m_obs = CreateObject<OpenGymBoxContainer<float>>(std::vector<uint32_t>{obsSize}, 0.0f);
+}
+
+TypeId
+PingPongEnv::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::PingPongEnv").SetParent<OpenGymEnv>().SetGroupName("OpenGym");
+    return tid;
+}
+
+void
+PingPongEnv::DoDispose()
+{
+    m_obs = nullptr;
+    OpenGymEnv::DoDispose();
+}
+
+Ptr<OpenGymSpace>
+PingPongEnv::GetActionSpace()
+{
+    return CreateObject<OpenGymDiscreteSpace>(2);
+}
+
+Ptr<OpenGymSpace>
+PingPongEnv::GetObservationSpace()
+{
+    return CreateObject<OpenGymBoxSpace>(0, 1e9, std::vector<uint32_t>{m_obsSize}, "float");
+}
+
+bool
+PingPongEnv::GetGameOver()
+{
+    return m_step >= m_steps;
+}
+
+Ptr<OpenGymDataContainer>
+PingPongEnv::GetObservation()
+{
+    m_obs->SetValue(0, float(m_step));
+    return m_obs;
+}
+
+float
+PingPongEnv::GetReward()
+{
+    return 1;
+}
+
+std::string
+PingPongEnv::GetExtraInfo()
+{
+    return "";
+}
+
+bool
+PingPongEnv::ExecuteActions(Ptr<OpenGymDataContainer> action)
+{
+    return bool(action);
+}
+
+void
+PingPongEnv::Step()
+{
+    ++m_step;
+    Notify();
+    if (m_step < m_steps)
+    {
+        Simulator::Schedule(MicroSeconds(1), &PingPongEnv::Step, this);
+    }
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t obsSize = 16;
+    uint32_t steps = 10000;
+    uint32_t envId = 0;
+    bool flat = false;
+    bool stats = false;
+    std::string waitMode = "spin";
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("obsSize", "Values of the float Box observation", obsSize);
+    cmd.AddValue("steps", "Steps before the game is over", steps);
+    cmd.AddValue("envId", "Env id, selecting segment seg<envId>", envId);
+    cmd.AddValue("flat", "Send the observation in the flat layout", flat);
+    cmd.AddValue("stats", "Record the step statistics", stats);
+    cmd.AddValue("waitMode", "spin, spin_yield or spin_futex", waitMode);
+    cmd.Parse(argc, argv);
+
+    Ns3penvWaitMode mode = waitMode == "spin_futex" ? Ns3penvWaitMode::SPIN_FUTEX
+                           : waitMode == "spin_yield" ? Ns3penvWaitMode::SPIN_YIELD
+                                                      : Ns3penvWaitMode::SPIN;
+    Ns3penvMsgInterface::Get()->SetWaitMode(mode);
+
+    Ptr<OpenGymInterface> openGymInterface = OpenGymInterface::Get(envId);
+    openGymInterface->SetUseFlatObservation(flat);
+    openGymInterface->SetRecordStepStats(stats);
+    Ptr<PingPongEnv> env = CreateObject<PingPongEnv>(obsSize, steps);
+    env->SetOpenGymInterface(openGymInterface);
+
+    Simulator::Schedule(MicroSeconds(1), &PingPongEnv::Step, env);
+    Simulator::Run();
+    env->NotifySimulationEnd();
+    Simulator::Destroy();
+    return 0;
+}
@@ -0,0 +1,140 @@
+# Copyright (c) 2025 NCSR Demokritos, Greece
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation;
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+#
+# Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+
+"""Macro benchmark: steps per second of the ns3penv-ping-pong scenario
+against the observation size and the number of environments run in parallel.
+
+Each environment is a separate Python process (Ns3Env is a singleton) with
+its own ns-3 process and segment seg<envId>. The aggregate rate is the total
+number of steps over the wall time between the first environment starting
+its step loop and the last one finishing it.
+"""
+
+import argparse
+import json
+import multiprocessing
+import os
+import platform
+import time
+from typing import Any
+
+TARGET = "ns3penv-ping-pong"
+
+
+def run_env(args: tuple[str, int, int, int, bool, str]) -> tuple[float, float]:
+    """Run the step loop of one environment, returning its start and end time"""
+    from ns3env import Ns3Env
+
+    ns3_path, env_id, obs_size, steps, flat, wait_mode = args
+    env = Ns3Env(
+        targetName=TARGET,
+        ns3Path=ns3_path,
+        ns3Settings={
+            "obsSize": obs_size,
+            "steps": steps,
+            "envId": env_id,
+            "flat": int(flat),
+            "waitMode": wait_mode,
+        },
+        msg_interface_settings={
+            "segName": f"seg{env_id}",
+            "cpp2pyMsgName": f"cpp2py{env_id}",
+            "py2cppMsgName": f"py2cpp{env_id}",
+            "lockableName": f"lockable{env_id}",
+            "handleFinish": False,
+            "waitMode": wait_mode,
+        },
+    )
+    try:
+        env.reset()
+        start = time.time()
+        done = False
+        while not done:
+            _, _, done, _, _ = env.step(0)
+        end = time.time()
+    finally:
+        env.close()
+    return start, end
+
+
+def run_point(
+    ns3_path: str, obs_size: int, envs: int, steps: int, flat: bool, wait_mode: str
+) -> dict[str, Any]:
+    jobs = [(ns3_path, i, obs_size, steps, flat, wait_mode) for i in range(envs)]
+    if envs == 1:
+        times = [run_env(jobs[0])]
+    else:
+        with multiprocessing.get_context("spawn").Pool(envs) as pool:
+            times = pool.map(run_env, jobs)
+    wall = max(end for _, end in times) - min(start for start, _ in times)
+    total = steps * envs
+    return {
+        "name": "ping_pong",
+        "params": {
+            "obs_size": obs_size,
+            "envs": envs,
+            "flat": flat,
+            "wait_mode": wait_mode,
+        },
+        "steps": total,
+        "seconds": wall,
+        "steps_per_s": total / wall,
+        "us_per_step": wall * 1e6 / steps,
+    }
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--ns3", required=True, help="path of the ns-3 tree")
+    parser.add_argument("--sizes", type=int, nargs="+", default=[16, 1024, 65536])
+    parser.add_argument("--envs", type=int, nargs="+", default=[1, 2, 4])
+    parser.add_argument("--steps", type=int, default=10000)
+    parser.add_argument("--flat", action="store_true", help="flat observations")
+    parser.add_argument(
+        "--wait-mode", default="spin", choices=["spin", "spin_yield", "spin_futex"]
+    )
+    parser.add_argument("--output", default="macro-bench.json")
+    args = parser.parse_args()
+
+    results = []
+    for envs in args.envs:
+        for size in args.sizes:
+            result = run_point(
+                args.ns3, size, envs, args.steps, args.flat, args.wait_mode
+            )
+            print(
+                f"ping_pong obs_size={size} envs={envs}: "
+                f"{result['steps_per_s']:.0f} steps/s, "
+                f"{result['us_per_step']:.1f} us/step"
+            )
+            results.append(result)
+
+    report = {
+        "suite": "macro",
+        "context": {
+            "cpus": os.cpu_count(),
+            "python": platform.python_version(),
+            "steps": args.steps,
+        },
+        "results": results,
+    }
+    with open(args.output, "w") as f:
+        json.dump(report, f, indent=2)
+
+
+if __name__ == "__main__":
+    main()
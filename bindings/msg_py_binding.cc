@@ -20,25 +20,271 @@
 
 #include <ns3/ns3penv-module.h>
 
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
 
 namespace py = pybind11;
 
+namespace
+{
+
+/// Slice of the timed waits, between two checks for pending signals
+constexpr uint64_t WAIT_SLICE_US = 50000;
+
+ns3::Ns3penvWaitStatus
+WaitStatus(bool done)
+{
+    return done ? ns3::Ns3penvWaitStatus::OK : ns3::Ns3penvWaitStatus::TIMEOUT;
+}
+
+ns3::Ns3penvWaitStatus
+WaitStatus(ns3::Ns3penvWaitStatus status)
+{
+    return status;
+}
+
+/**
+ * Calls waitFor(timeout_us) in slices without the GIL until it succeeds,
+ * so that other Python threads run meanwhile and Ctrl-C still works.
+ * Raises ConnectionError once the simulation process is found gone.
+ */
+template <typename F>
+void
+WaitInterruptible(F&& waitFor)
+{
+    while (true)
+    {
+        ns3::Ns3penvWaitStatus status;
+        {
+            py::gil_scoped_release release;
+            status = WaitStatus(waitFor(WAIT_SLICE_US));
+        }
+        if (status == ns3::Ns3penvWaitStatus::OK)
+        {
+            return;
+        }
+        if (status == ns3::Ns3penvWaitStatus::PEER_GONE)
+        {
+            PyErr_SetString(PyExc_ConnectionError, "The ns-3 simulation process is gone");
+            throw py::error_already_set();
+        }
+        if (PyErr_CheckSignals() != 0)
+        {
+            throw py::error_already_set();
+        }
+    }
+}
+
+/**
+ * Copies payload into msg, growing its buffer if needed. Must be called
+ * between PySendBegin and PySendEnd; when the payload does not fit, cancel
+ * hands the buffer back before MemoryError is raised.
+ */
+template <typename Impl, typename Cancel>
+void
+WriteMsg(Impl& self, Ns3penvGymMsg* msg, std::string_view payload, Cancel&& cancel)
+{
+    if (payload.size() > UINT32_MAX || !self.Reserve(msg, payload.size()))
+    {
+        cancel();
+        PyErr_Format(PyExc_MemoryError,
+                     "Shared memory segment has %zu bytes left, which is not enough for a "
+                     "message of %zu bytes. Increase shmSize",
+                     self.GetFreeMemory(),
+                     payload.size());
+        throw py::error_already_set();
+    }
+    std::memcpy(msg->buffer.get(), payload.data(), payload.size());
+    msg->size = payload.size();
+}
+
+/**
+ * Serialized bytes of a protobuf message, or the object itself if it
+ * already is bytes
+ */
+py::bytes
+Serialized(const py::object& message)
+{
+    if (py::isinstance<py::bytes>(message))
+    {
+        return py::bytes(message);
+    }
+    return py::bytes(message.attr("SerializeToString")());
+}
+
+py::dtype
+FlatDtype(uint16_t dtype)
+{
+    switch (dtype)
+    {
+    case ns3penv::INT:
+        return py::dtype::of<int32_t>();
+    case ns3penv::UINT:
+        return py::dtype::of<uint32_t>();
+    case ns3penv::FLOAT:
+        return py::dtype::of<float>();
+    case ns3penv::DOUBLE:
+        return py::dtype::of<double>();
+    case ns3penv::INT8:
+        return py::dtype::of<int8_t>();
+    case ns3penv::UINT8:
+        return py::dtype::of<uint8_t>();
+    case ns3penv::INT64:
+        return py::dtype::of<int64_t>();
+    case ns3penv::FLOAT16:
+        return py::dtype("float16");
+    default:
+        throw py::value_error("Unsupported flat dtype " + std::to_string(dtype));
+    }
+}
+
+/// Keys of the phases in the step statistics, in Ns3penvStepPhase order
+constexpr const char* STEP_PHASE_NAMES[NS3PENV_NUM_PHASES] = {"observe",
+                                                             "build",
+                                                             "wait_empty",
+                                                             "serialize",
+                                                             "wait_action",
+                                                             "parse",
+                                                             "decode",
+                                                             "execute"};
+
+py::dict
+HistogramDict(const Ns3penvHistogramCounts& counts)
+{
+    uint64_t count = counts.m_count.load(std::memory_order_relaxed);
+    uint64_t sum = counts.m_sum.load(std::memory_order_relaxed);
+    py::dict dict;
+    dict["count"] = count;
+    dict["mean"] = count ? double(sum) / count : 0.0;
+    dict["min"] = count ? counts.m_min.load(std::memory_order_relaxed) : 0;
+    dict["max"] = counts.m_max.load(std::memory_order_relaxed);
+    dict["p50"] = Ns3penvHistogram::percentile(&counts, 0.5);
+    dict["p90"] = Ns3penvHistogram::percentile(&counts, 0.9);
+    dict["p99"] = Ns3penvHistogram::percentile(&counts, 0.99);
+    dict["p999"] = Ns3penvHistogram::percentile(&counts, 0.999);
+    return dict;
+}
+
+/**
+ * The step statistics as a dict of histograms and out-of-range counts, or
+ * None if the C++ side does not record them
+ */
+py::object
+StatsDict(const Ns3penvStats* stats)
+{
+    if (stats == nullptr)
+    {
+        return py::none();
+    }
+    py::dict dict;
+    for (uint32_t i = 0; i < NS3PENV_NUM_PHASES; ++i)
+    {
+        dict[STEP_PHASE_NAMES[i]] = HistogramDict(stats->m_phases[i]);
+    }
+    dict["state_size"] = HistogramDict(stats->m_stateSize);
+    dict["action_size"] = HistogramDict(stats->m_actionSize);
+    py::dict outOfRange;
+    outOfRange["actions_clipped"] = stats->m_actionsClipped.load(std::memory_order_relaxed);
+    outOfRange["observations_replaced"] =
+        stats->m_observationsReplaced.load(std::memory_order_relaxed);
+    dict["out_of_range"] = outOfRange;
+    return dict;
+}
+
+} // namespace
+
 PYBIND11_MODULE(ns3penv_gym_msg_py, m)
 {
     m.attr("msg_buffer_size") = MSG_BUFFER_SIZE;
 
+    py::enum_<Ns3penvWaitMode>(m, "Ns3penvWaitMode")
+        .value("SPIN", Ns3penvWaitMode::SPIN)
+        .value("SPIN_YIELD", Ns3penvWaitMode::SPIN_YIELD)
+        .value("SPIN_FUTEX", Ns3penvWaitMode::SPIN_FUTEX);
+
+    py::enum_<ns3::Ns3penvWaitStatus>(m, "Ns3penvWaitStatus")
+        .value("OK", ns3::Ns3penvWaitStatus::OK)
+        .value("TIMEOUT", ns3::Ns3penvWaitStatus::TIMEOUT)
+        .value("PEER_GONE", ns3::Ns3penvWaitStatus::PEER_GONE);
+
+    py::class_<Ns3penvFlatStateHeader>(m, "Ns3penvFlatStateHeader")
+        .def_readonly("dtype", &Ns3penvFlatStateHeader::dtype)
+        .def_readonly("ndim", &Ns3penvFlatStateHeader::ndim)
+        .def_property_readonly("shape",
+                               [](const Ns3penvFlatStateHeader& header) {
+                                   py::tuple shape(header.ndim);
+                                   for (uint32_t i = 0; i < header.ndim; ++i)
+                                   {
+                                       shape[i] = header.shape[i];
+                                   }
+                                   return shape;
+                               })
+        .def_readonly("reward", &Ns3penvFlatStateHeader::reward)
+        .def_readonly("isGameOver", &Ns3penvFlatStateHeader::isGameOver)
+        .def_readonly("reason", &Ns3penvFlatStateHeader::reason)
+        .def_readonly("infoSize", &Ns3penvFlatStateHeader::infoSize)
+        .def_readonly("dataOffset", &Ns3penvFlatStateHeader::dataOffset)
+        .def_readonly("dataSize", &Ns3penvFlatStateHeader::dataSize);
+
     py::class_<Ns3penvGymMsg>(m, "Ns3penvGymMsg")
         .def(py::init<>())
         .def_readwrite("size", &Ns3penvGymMsg::size)
+        .def_readonly("capacity", &Ns3penvGymMsg::capacity)
         .def("get_buffer",
              [](Ns3penvGymMsg& msg) {
                  // Get memoryview of the buffer
-                 return py::memoryview::from_memory((void*)msg.buffer, msg.size);
+                 return py::memoryview::from_memory((void*)msg.buffer.get(), msg.size);
              })
-        .def("get_buffer_full", [](Ns3penvGymMsg& msg) {
-            // Get memoryview of the buffer
-            return py::memoryview::from_memory((void*)msg.buffer, MSG_BUFFER_SIZE);
+        .def("get_buffer_full",
+             [](Ns3penvGymMsg& msg) {
+                 // Get memoryview of the buffer
+                 return py::memoryview::from_memory((void*)msg.buffer.get(), msg.capacity);
+             })
+        .def("is_flat",
+             [](Ns3penvGymMsg& msg) { return Ns3penvIsFlatState(msg.buffer.get(), msg.size); })
+        .def("get_flat_header",
+             [](Ns3penvGymMsg& msg) {
+                 return *reinterpret_cast<const Ns3penvFlatStateHeader*>(msg.buffer.get());
+             })
+        .def("get_flat_info",
+             [](Ns3penvGymMsg& msg) {
+                 const auto* header =
+                     reinterpret_cast<const Ns3penvFlatStateHeader*>(msg.buffer.get());
+                 return py::str(reinterpret_cast<const char*>(msg.buffer.get()) +
+                                    sizeof(Ns3penvFlatStateHeader),
+                                header->infoSize);
+             })
+        .def("get_flat_data", [](py::object self) {
+            // numpy view of the payload in shared memory, no copy. It is only
+            // valid until the reader releases the message with PyRecvEnd
+            Ns3penvGymMsg& msg = self.cast<Ns3penvGymMsg&>();
+            const auto* header = reinterpret_cast<const Ns3penvFlatStateHeader*>(msg.buffer.get());
+            std::vector<py::ssize_t> shape(header->shape, header->shape + header->ndim);
+            return py::array(FlatDtype(header->dtype),
+                             shape,
+                             msg.buffer.get() + header->dataOffset,
+                             self);
+        })
+        .def("get_flat_record", [](py::object self, py::dtype dtype) {
+            // the payload of a typed env as one record of its structured
+            // dtype, a view like get_flat_data
+            Ns3penvGymMsg& msg = self.cast<Ns3penvGymMsg&>();
+            const auto* header = reinterpret_cast<const Ns3penvFlatStateHeader*>(msg.buffer.get());
+            if (py::ssize_t(header->dataSize) != dtype.itemsize())
+            {
+                throw py::value_error("Flat state of " + std::to_string(header->dataSize) +
+                                      " bytes does not match the struct of " +
+                                      std::to_string(dtype.itemsize()));
+            }
+            return py::array(dtype,
+                             std::vector<py::ssize_t>{1},
+                             msg.buffer.get() + header->dataOffset,
+                             self);
         });
 
     py::class_<ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>>(
@@ -52,18 +298,252 @@ PYBIND11_MODULE(ns3penv_gym_msg_py, m)
                       const char*,
                       const char*,
                       const char*>())
+        .def(py::init<bool,
+                      bool,
+                      bool,
+                      uint32_t,
+                      const char*,
+                      const char*,
+                      const char*,
+                      const char*,
+                      Ns3penvWaitMode,
+                      uint32_t,
+                      uint32_t>())
+        .def("SetWaitMode",
+             &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::SetWaitMode)
+        .def("GetWaitMode",
+             &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::GetWaitMode)
+        .def("GetSpinBudget",
+             &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::GetSpinBudget)
         .def("PyRecvBegin",
-             &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::PyRecvBegin)
+             [](ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>& self) {
+                 WaitInterruptible([&self](uint64_t t) { return self.PyRecvBeginFor(t); });
+             })
+        .def("PyRecvBeginFor",
+             &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::PyRecvBeginFor,
+             py::call_guard<py::gil_scoped_release>())
         .def("PyRecvEnd", &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::PyRecvEnd)
         .def("PySendBegin",
-             &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::PySendBegin)
+             [](ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>& self) {
+                 WaitInterruptible([&self](uint64_t t) { return self.PySendBeginFor(t); });
+             })
+        .def("PySendBeginFor",
+             &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::PySendBeginFor,
+             py::call_guard<py::gil_scoped_release>())
         .def("PySendEnd", &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::PySendEnd)
+        .def("PySendCancel",
+             &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::PySendCancel)
+        .def("PyRecvAndParse",
+             [](ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>& self,
+                py::object message) {
+                 // wait, copy and release the buffer in one call, then parse
+                 // while the simulation already goes on
+                 WaitInterruptible([&self](uint64_t t) { return self.PyRecvBeginFor(t); });
+                 Ns3penvGymMsg* msg = self.GetCpp2PyStruct();
+                 py::bytes payload(reinterpret_cast<const char*>(msg->buffer.get()), msg->size);
+                 self.PyRecvEnd();
+                 message.attr("ParseFromString")(payload);
+             })
+        .def("PySendSerialized",
+             [](ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>& self,
+                const py::object& message) {
+                 // serialize first, so the buffer is only held for the copy
+                 py::bytes payload = Serialized(message);
+                 WaitInterruptible([&self](uint64_t t) { return self.PySendBeginFor(t); });
+                 WriteMsg(self, self.GetPy2CppStruct(), payload, [&self]() {
+                     self.PySendCancel();
+                 });
+                 self.PySendEnd();
+             })
         .def("GetCpp2PyStruct",
              &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::GetCpp2PyStruct,
              py::return_value_policy::reference)
         .def("GetPy2CppStruct",
              &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::GetPy2CppStruct,
              py::return_value_policy::reference)
+        .def("Reserve",
+             &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::Reserve<Ns3penvGymMsg>)
+        .def("GetFreeMemory",
+             &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::GetFreeMemory)
+        .def("HasRing", &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::HasRing)
+        .def("GetSpaceHash",
+             &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::GetSpaceHash)
+        .def("PySetSpaceHash",
+             &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::PySetSpaceHash)
+        .def("GetEpoch", &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::GetEpoch)
+        .def("GetCppHeartbeat",
+             &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::GetCppHeartbeat)
+        .def("GetPyHeartbeat",
+             &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::GetPyHeartbeat)
+        .def("PyIsPeerAlive",
+             &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::PyIsPeerAlive)
+        .def("PyForgetPeer",
+             &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::PyForgetPeer)
+        .def("GetStats",
+             [](ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>& self) {
+                 return StatsDict(self.GetStats(false));
+             })
+        .def("PyTrySend",
+             [](ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>& self,
+                const py::bytes& data) {
+                 std::string_view view = data;
+                 return self.PyTrySend(view.data(), view.size());
+             })
+        .def("PyTryRecv",
+             [](ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>& self) -> py::object {
+                 // None if the ring is empty, otherwise a copy of the oldest record
+                 py::object record = py::none();
+                 self.PyTryRecv([&record](const uint8_t* data, uint32_t size) {
+                     record = py::bytes(reinterpret_cast<const char*>(data), size);
+                 });
+                 return record;
+             })
         .def("CleanSharedMemory",
              &ns3::Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg>::CleanSharedMemory);
+
+    typedef ns3::Ns3penvBatchMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg> BatchImpl;
+    py::class_<BatchImpl>(m, "Ns3penvBatchMsgInterfaceImpl")
+        .def(py::init<uint32_t,
+                      uint32_t,
+                      const char*,
+                      const char*,
+                      const char*,
+                      const char*,
+                      Ns3penvWaitMode,
+                      uint32_t>())
+        .def("GetNumSlots", &BatchImpl::GetNumSlots)
+        .def("SetWaitMode", &BatchImpl::SetWaitMode)
+        .def("GetCpp2PyStruct", &BatchImpl::GetCpp2PyStruct, py::return_value_policy::reference)
+        .def("GetPy2CppStruct", &BatchImpl::GetPy2CppStruct, py::return_value_policy::reference)
+        .def("Reserve", &BatchImpl::Reserve<Ns3penvGymMsg>)
+        .def("GetFreeMemory", &BatchImpl::GetFreeMemory)
+        .def("PyGetNumReady", &BatchImpl::PyGetNumReady)
+        .def("PyRecvBeginAny",
+             [](BatchImpl& self, uint32_t count) {
+                 std::vector<uint32_t> slots;
+                 WaitInterruptible([&](uint64_t t) {
+                     slots = self.PyRecvBeginAny(count, t);
+                     return !slots.empty();
+                 });
+                 return slots;
+             })
+        .def("PyRecvEnd", &BatchImpl::PyRecvEnd)
+        .def("PySendBegin",
+             [](BatchImpl& self, uint32_t slot) {
+                 WaitInterruptible([&](uint64_t t) { return self.PySendBeginFor(slot, t); });
+             })
+        .def("PySendEnd", &BatchImpl::PySendEnd)
+        .def("PySendCancel", &BatchImpl::PySendCancel)
+        .def("PySendSerialized",
+             [](BatchImpl& self, uint32_t slot, const py::object& message) {
+                 py::bytes payload = Serialized(message);
+                 WaitInterruptible([&](uint64_t t) { return self.PySendBeginFor(slot, t); });
+                 WriteMsg(self, self.GetPy2CppStruct(slot), payload, [&]() {
+                     self.PySendCancel(slot);
+                 });
+                 self.PySendEnd(slot);
+             })
+        .def("PyGetFinished", &BatchImpl::PyGetFinished)
+        .def("PyRecvFlatBatch",
+             [](BatchImpl& self, uint32_t count) {
+                 // waits for count flat states and stacks them into one
+                 // (count, *shape) array, releasing the slots afterwards
+                 std::vector<uint32_t> slots;
+                 WaitInterruptible([&](uint64_t t) {
+                     slots = self.PyRecvBeginAny(count, t);
+                     return !slots.empty();
+                 });
+                 const py::ssize_t k = slots.size();
+                 py::array_t<uint32_t> ids(k);
+                 py::array_t<float> rewards(k);
+                 py::array_t<bool> dones(k);
+                 py::list infos;
+
+                 // every state that is not the final one must share this layout
+                 const Ns3penvFlatStateHeader* layout = nullptr;
+                 std::string error;
+                 for (uint32_t slot : slots)
+                 {
+                     Ns3penvGymMsg* msg = self.GetCpp2PyStruct(slot);
+                     if (self.PyGetFinished(slot))
+                     {
+                         continue;
+                     }
+                     if (!Ns3penvIsFlatState(msg->buffer.get(), msg->size))
+                     {
+                         error = "state of slot " + std::to_string(slot) + " is not flat";
+                         break;
+                     }
+                     const auto* header =
+                         reinterpret_cast<const Ns3penvFlatStateHeader*>(msg->buffer.get());
+                     if (layout == nullptr)
+                     {
+                         layout = header;
+                     }
+                     else if (header->dtype != layout->dtype || header->ndim != layout->ndim ||
+                              !std::equal(header->shape,
+                                          header->shape + header->ndim,
+                                          layout->shape))
+                     {
+                         error = "state of slot " + std::to_string(slot) +
+                                 " does not match the shape of the batch";
+                         break;
+                     }
+                 }
+
+                 py::object obs = py::none();
+                 if (error.empty() && layout != nullptr)
+                 {
+                     std::vector<py::ssize_t> shape{k};
+                     shape.insert(shape.end(), layout->shape, layout->shape + layout->ndim);
+                     py::array batch(FlatDtype(layout->dtype), shape);
+                     std::memset(batch.mutable_data(), 0, batch.nbytes());
+                     for (py::ssize_t i = 0; i < k; ++i)
+                     {
+                         ids.mutable_at(i) = slots[i];
+                         Ns3penvGymMsg* msg = self.GetCpp2PyStruct(slots[i]);
+                         if (self.PyGetFinished(slots[i]))
+                         {
+                             rewards.mutable_at(i) = 0;
+                             dones.mutable_at(i) = true;
+                             infos.append(py::str());
+                             continue;
+                         }
+                         const auto* header =
+                             reinterpret_cast<const Ns3penvFlatStateHeader*>(msg->buffer.get());
+                         std::memcpy(static_cast<uint8_t*>(batch.mutable_data()) +
+                                         i * header->dataSize,
+                                     msg->buffer.get() + header->dataOffset,
+                                     header->dataSize);
+                         rewards.mutable_at(i) = header->reward;
+                         dones.mutable_at(i) = header->isGameOver;
+                         infos.append(py::str(reinterpret_cast<const char*>(msg->buffer.get()) +
+                                                  sizeof(Ns3penvFlatStateHeader),
+                                              header->infoSize));
+                     }
+                     obs = batch;
+                 }
+                 else if (error.empty())
+                 {
+                     // only final states
+                     for (py::ssize_t i = 0; i < k; ++i)
+                     {
+                         ids.mutable_at(i) = slots[i];
+                         rewards.mutable_at(i) = 0;
+                         dones.mutable_at(i) = true;
+                         infos.append(py::str());
+                     }
+                 }
+
+                 for (uint32_t slot : slots)
+                 {
+                     self.PyRecvEnd(slot);
+                 }
+                 if (!error.empty())
+                 {
+                     throw py::value_error(error);
+                 }
+                 return py::make_tuple(ids, obs, rewards, dones, infos);
+             })
+        .def("CleanSharedMemory", &BatchImpl::CleanSharedMemory);
 }
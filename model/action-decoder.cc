@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#include "action-decoder.h"
+
+#include "quantize.h"
+
+#include <ns3/log.h>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("OpenGymActionDecoder");
+
+NS_OBJECT_ENSURE_REGISTERED(OpenGymActionDecoder);
+
+/** A box already holding all values of its shape, so decoding never allocates */
+template <typename T>
+static Ptr<OpenGymDataContainer>
+CreateSizedBox(const std::vector<uint32_t>& shape)
+{
+    return CreateObject<OpenGymBoxContainer<T>>(shape, T());
+}
+
+TypeId
+OpenGymActionDecoder::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::OpenGymActionDecoder")
+                            .SetParent<Object>()
+                            .SetGroupName("OpenGym")
+                            .AddConstructor<OpenGymActionDecoder>();
+    return tid;
+}
+
+OpenGymActionDecoder::OpenGymActionDecoder()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+OpenGymActionDecoder::~OpenGymActionDecoder()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+OpenGymActionDecoder::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    m_nodes.clear();
+    m_containers.clear();
+    m_messages.clear();
+}
+
+bool
+OpenGymActionDecoder::Compile(const ns3penv::SpaceDescription& spaceDesc)
+{
+    NS_LOG_FUNCTION(this);
+    m_nodes.clear();
+    m_containers.clear();
+    if (AddNode(spaceDesc, 0, 0, false) < 0)
+    {
+        m_nodes.clear();
+        m_containers.clear();
+        return false;
+    }
+    m_messages.assign(m_nodes.size(), nullptr);
+    return true;
+}
+
+int32_t
+OpenGymActionDecoder::AddNode(const ns3penv::SpaceDescription& spaceDesc,
+                              uint32_t parent,
+                              uint32_t position,
+                              bool inDict)
+{
+    Node node;
+    node.dtype = ns3penv::INT;
+    node.length = 0;
+    node.parent = parent;
+    node.position = position;
+    node.inDict = inDict;
+    node.name = spaceDesc.name();
+    node.copy = nullptr;
+    node.clip = nullptr;
+    node.low = 0;
+    node.high = 0;
+
+    Ptr<OpenGymDataContainer> container;
+    switch (spaceDesc.space_variant_case())
+    {
+    case ns3penv::SpaceDescription::kDiscrete: {
+        node.length = spaceDesc.discrete().n();
+        node.check = &CheckDiscrete;
+        node.copy = &CopyDiscrete;
+        container = CreateObject<OpenGymDiscreteContainer>(node.length);
+        break;
+    }
+    case ns3penv::SpaceDescription::kBox: {
+        const auto& box = spaceDesc.box();
+        std::vector<uint32_t> shape{box.shape().begin(), box.shape().end()};
+        uint64_t length = 1;
+        for (const auto& dim : shape)
+        {
+            length *= dim;
+        }
+        if (length > INT32_MAX)
+        {
+            return -1;
+        }
+        node.dtype = box.dtype();
+        node.length = length;
+        node.low = box.low();
+        node.high = box.high();
+        bool known = OpenGymVisitDtype(node.dtype, [&](auto type) {
+            typedef typename decltype(type)::type T;
+            node.check = &CheckBox<T>;
+            node.copy = &CopyBox<T>;
+            if (node.low < node.high)
+            {
+                node.clip = &ClipBox<T>;
+            }
+            container = CreateSizedBox<T>(shape);
+        });
+        if (!known)
+        {
+            return -1;
+        }
+        break;
+    }
+    case ns3penv::SpaceDescription::kTuple: {
+        node.length = spaceDesc.tuple().element_size();
+        node.check = &CheckTuple;
+        container = CreateObject<OpenGymTupleContainer>();
+        break;
+    }
+    case ns3penv::SpaceDescription::kDict: {
+        node.length = spaceDesc.dict().element_size();
+        node.check = &CheckDict;
+        container = CreateObject<OpenGymDictContainer>();
+        break;
+    }
+    default:
+        return -1;
+    }
+
+    node.data = PeekPointer(container);
+    int32_t index = m_nodes.size();
+    m_nodes.push_back(node);
+    m_containers.push_back(container);
+
+    if (spaceDesc.has_tuple())
+    {
+        Ptr<OpenGymTupleContainer> tuple = DynamicCast<OpenGymTupleContainer>(container);
+        const auto& elements = spaceDesc.tuple().element();
+        for (int i = 0; i < elements.size(); ++i)
+        {
+            int32_t child = AddNode(elements[i], index, i, false);
+            if (child < 0)
+            {
+                return -1;
+            }
+            tuple->Add(m_containers[child]);
+        }
+    }
+    else if (spaceDesc.has_dict())
+    {
+        Ptr<OpenGymDictContainer> dict = DynamicCast<OpenGymDictContainer>(container);
+        const auto& elements = spaceDesc.dict().element();
+        for (int i = 0; i < elements.size(); ++i)
+        {
+            int32_t child = AddNode(elements[i], index, i, true);
+            if (child < 0)
+            {
+                return -1;
+            }
+            dict->Add(elements[i].name(), m_containers[child]);
+        }
+    }
+    return index;
+}
+
+bool
+OpenGymActionDecoder::CheckDiscrete(const ns3penv::DataContainer& msg, const Node& node)
+{
+    if (!msg.has_discrete())
+    {
+        return false;
+    }
+    int32_t value = msg.discrete().data();
+    return value >= 0 && (node.length == 0 || static_cast<uint32_t>(value) < node.length);
+}
+
+void
+OpenGymActionDecoder::CopyDiscrete(const ns3penv::DataContainer& msg, const Node& node)
+{
+    static_cast<OpenGymDiscreteContainer*>(node.data)->SetValue(msg.discrete().data());
+}
+
+template <typename T>
+bool
+OpenGymActionDecoder::CheckBox(const ns3penv::DataContainer& msg, const Node& node)
+{
+    // the handler may have resized the box since the previous step
+    return msg.has_box() && msg.box().dtype() == node.dtype &&
+           OpenGymBoxFieldSize<T>(OpenGymBoxTraits<T>::Get(msg.box())) == node.length &&
+           static_cast<OpenGymBoxContainer<T>*>(node.data)->GetDataView().size() == node.length;
+}
+
+template <typename T>
+void
+OpenGymActionDecoder::CopyBox(const ns3penv::DataContainer& msg, const Node& node)
+{
+    // the box was sized by Compile, so this does not allocate
+    std::span<T> data = static_cast<OpenGymBoxContainer<T>*>(node.data)->MutableView();
+    OpenGymBoxFieldCopy<T>(OpenGymBoxTraits<T>::Get(msg.box()), data.data());
+}
+
+template <typename T>
+uint32_t
+OpenGymActionDecoder::ClipBox(const Node& node)
+{
+    return OpenGymClip(static_cast<OpenGymBoxContainer<T>*>(node.data)->MutableView(),
+                       node.low,
+                       node.high);
+}
+
+bool
+OpenGymActionDecoder::CheckTuple(const ns3penv::DataContainer& msg, const Node& node)
+{
+    return msg.has_tuple() && static_cast<uint32_t>(msg.tuple().element_size()) == node.length;
+}
+
+bool
+OpenGymActionDecoder::CheckDict(const ns3penv::DataContainer& msg, const Node& node)
+{
+    return msg.has_dict() && static_cast<uint32_t>(msg.dict().element_size()) == node.length;
+}
+
+bool
+OpenGymActionDecoder::Decode(const ns3penv::DataContainer& dataContainer)
+{
+    if (m_nodes.empty())
+    {
+        return false;
+    }
+
+    // check the whole message first, parents always precede their children
+    // and have checked the number of elements
+    for (std::size_t i = 0; i < m_nodes.size(); ++i)
+    {
+        const Node& node = m_nodes[i];
+        const ns3penv::DataContainer* msg = &dataContainer;
+        if (i > 0)
+        {
+            const ns3penv::DataContainer* parent = m_messages[node.parent];
+            if (node.inDict)
+            {
+                msg = &parent->dict().element(node.position);
+                if (msg->name() != node.name)
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                msg = &parent->tuple().element(node.position);
+            }
+        }
+        if (!node.check(*msg, node))
+        {
+            return false;
+        }
+        m_messages[i] = msg;
+    }
+
+    for (std::size_t i = 0; i < m_nodes.size(); ++i)
+    {
+        const Node& node = m_nodes[i];
+        if (node.copy)
+        {
+            node.copy(*m_messages[i], node);
+        }
+    }
+    return true;
+}
+
+uint32_t
+OpenGymActionDecoder::Clip()
+{
+    uint32_t changed = 0;
+    for (const auto& node : m_nodes)
+    {
+        if (node.clip)
+        {
+            changed += node.clip(node);
+        }
+    }
+    return changed;
+}
+
+Ptr<OpenGymDataContainer>
+OpenGymActionDecoder::GetContainer() const
+{
+    if (m_containers.empty())
+    {
+        return nullptr;
+    }
+    return m_containers.front();
+}
+
+} // namespace ns3
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#ifndef OPENGYM_ACTION_DECODER_H
+#define OPENGYM_ACTION_DECODER_H
+
+#include "container.h"
+#include "messages.pb.h"
+
+#include <ns3/object.h>
+
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @brief Decodes action messages of a fixed action space into containers
+ * built once up front
+ *
+ * Compile turns the space description into a flat table with one node per
+ * container, in pre-order, and creates the containers the actions are
+ * decoded into. Decode then walks the table instead of recursing over the
+ * message: it first checks every node of the message against the plan, so
+ * that a malformed action is rejected without touching the containers, and
+ * then copies the values with a kernel chosen per dtype at compile time.
+ */
+class OpenGymActionDecoder : public Object
+{
+  public:
+    OpenGymActionDecoder();
+    ~OpenGymActionDecoder() override;
+
+    static TypeId GetTypeId();
+
+    /**
+     * @brief build the plan and the containers for the action space
+     * @returns false if the space cannot be described by a plan
+     */
+    bool Compile(const ns3penv::SpaceDescription& spaceDesc);
+
+    /**
+     * @brief fill the containers from an action message
+     * @returns false, leaving the containers as they were, if the message
+     * does not match the action space
+     */
+    bool Decode(const ns3penv::DataContainer& dataContainer);
+
+    /**
+     * @brief clamp the boxes filled by Decode to the bounds of their spaces,
+     * see OpenGymClip. Bounds that are not an interval, such as the 0 and 0
+     * describing spaces built from per-value bounds, clamp nothing.
+     * @returns the number of values changed
+     */
+    uint32_t Clip();
+
+    /** @brief get the root of the containers filled by Decode */
+    Ptr<OpenGymDataContainer> GetContainer() const;
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    struct Node;
+    typedef bool (*CheckKernel)(const ns3penv::DataContainer& msg, const Node& node);
+    typedef void (*CopyKernel)(const ns3penv::DataContainer& msg, const Node& node);
+    typedef uint32_t (*ClipKernel)(const Node& node);
+
+    /** @brief one container of the action, children follow their parent */
+    struct Node
+    {
+        ns3penv::Dtype dtype;       // boxes only
+        uint32_t length;            // values of a box, n of a discrete, children otherwise
+        uint32_t parent;            // index of the parent node, unused for the root
+        uint32_t position;          // index among the elements of the parent
+        bool inDict;                // whether the parent is a dict
+        std::string name;           // expected name inside a dict
+        CheckKernel check;
+        CopyKernel copy;            // null for tuples and dicts
+        ClipKernel clip;            // null unless a box with bounds
+        float low;                  // bounds of a box
+        float high;
+        OpenGymDataContainer* data; // owned through m_containers
+    };
+
+    int32_t AddNode(const ns3penv::SpaceDescription& spaceDesc,
+                    uint32_t parent,
+                    uint32_t position,
+                    bool inDict);
+
+    static bool CheckDiscrete(const ns3penv::DataContainer& msg, const Node& node);
+    static void CopyDiscrete(const ns3penv::DataContainer& msg, const Node& node);
+    template <typename T>
+    static bool CheckBox(const ns3penv::DataContainer& msg, const Node& node);
+    template <typename T>
+    static void CopyBox(const ns3penv::DataContainer& msg, const Node& node);
+    template <typename T>
+    static uint32_t ClipBox(const Node& node);
+    static bool CheckTuple(const ns3penv::DataContainer& msg, const Node& node);
+    static bool CheckDict(const ns3penv::DataContainer& msg, const Node& node);
+
+    std::vector<Node> m_nodes;
+    std::vector<Ptr<OpenGymDataContainer>> m_containers;   // one per node
+    std::vector<const ns3penv::DataContainer*> m_messages; // scratch, one per node
+};
+
+} // namespace ns3
+
+#endif /* OPENGYM_ACTION_DECODER_H */
@@ -22,8 +22,13 @@
 
 #include "container.h"
 
+#include "spaces.h"
+
 #include <ns3/log.h>
 
+#include <algorithm>
+#include <cstring>
+
 namespace ns3
 {
 
@@ -31,6 +36,218 @@ NS_LOG_COMPONENT_DEFINE("OpenGymDataContainer");
 
 NS_OBJECT_ENSURE_REGISTERED(OpenGymDataContainer);
 
+/**
+ * Sorts and merges the dirty spans of a box holding size values. Spans
+ * separated by a few unchanged values are joined, as resending those is
+ * cheaper than describing another span. Returns false if the spans cover
+ * so much of the box that sending it in full is cheaper.
+ */
+static bool
+MergeDirtySpans(std::vector<std::pair<uint32_t, uint32_t>>& spans, std::size_t size)
+{
+    const uint32_t maxGap = 4;
+    std::sort(spans.begin(), spans.end());
+    std::size_t merged = 0;
+    for (std::size_t i = 1; i < spans.size(); ++i)
+    {
+        if (spans[i].first <= spans[merged].second + maxGap)
+        {
+            spans[merged].second = std::max(spans[merged].second, spans[i].second);
+        }
+        else
+        {
+            spans[++merged] = spans[i];
+        }
+    }
+    if (!spans.empty())
+    {
+        spans.resize(merged + 1);
+    }
+    std::size_t count = 0;
+    for (const auto& [begin, end] : spans)
+    {
+        count += end - begin;
+    }
+    return 2 * count <= size;
+}
+
+/**
+ * Index of a box dtype in the offsets and counts used to lay out an
+ * OpenGymBoxStorage, -1 for none.
+ */
+static int
+BoxStorageIndex(ns3penv::Dtype dtype)
+{
+    return OpenGymVisitDtype(dtype, [](auto) {}) ? dtype - 1 : -1;
+}
+
+/** Number of values of a box space */
+static uint64_t
+BoxLength(const ns3penv::BoxSpace& box)
+{
+    uint64_t length = 1;
+    for (const auto& dim : box.shape())
+    {
+        length *= dim;
+    }
+    return length;
+}
+
+typedef std::array<uint64_t, std::tuple_size_v<OpenGymBoxStorage::Offsets>> BoxCounts;
+
+/**
+ * Adds the values of the boxes of a space to counts, per dtype. Clears
+ * boxesOnly if the space has any other leaf.
+ */
+static void
+CountBoxValues(const ns3penv::SpaceDescription& desc, BoxCounts& counts, bool& boxesOnly)
+{
+    switch (desc.space_variant_case())
+    {
+    case ns3penv::SpaceDescription::kBox: {
+        int index = BoxStorageIndex(desc.box().dtype());
+        NS_ABORT_MSG_IF(index < 0, "Unsupported data type");
+        counts[index] += BoxLength(desc.box());
+        break;
+    }
+    case ns3penv::SpaceDescription::kTuple:
+        for (const auto& element : desc.tuple().element())
+        {
+            CountBoxValues(element, counts, boxesOnly);
+        }
+        break;
+    case ns3penv::SpaceDescription::kDict:
+        for (const auto& element : desc.dict().element())
+        {
+            CountBoxValues(element, counts, boxesOnly);
+        }
+        break;
+    default:
+        boxesOnly = false;
+        break;
+    }
+}
+
+/**
+ * Allocates the storage for the boxes of a space. flatDtype is set to the
+ * dtype of all values if the space has nothing but boxes of one dtype,
+ * NoDType otherwise.
+ */
+static std::shared_ptr<OpenGymBoxStorage>
+CreateBoxStorage(const ns3penv::SpaceDescription& desc, ns3penv::Dtype& flatDtype)
+{
+    BoxCounts counts{};
+    bool boxesOnly = true;
+    CountBoxValues(desc, counts, boxesOnly);
+
+    auto storage = std::make_shared<OpenGymBoxStorage>();
+    flatDtype = ns3penv::NoDType;
+    int used = 0;
+    for (std::size_t i = 0; i < counts.size(); ++i)
+    {
+        NS_ABORT_MSG_IF(counts[i] > UINT32_MAX, "Space has too many values");
+        if (counts[i] == 0)
+        {
+            continue;
+        }
+        auto dtype = static_cast<ns3penv::Dtype>(i + 1);
+        OpenGymVisitDtype(dtype, [&](auto type) {
+            storage->Values<typename decltype(type)::type>().resize(counts[i]);
+        });
+        flatDtype = dtype;
+        ++used;
+    }
+    if (!boxesOnly || used != 1)
+    {
+        flatDtype = ns3penv::NoDType;
+    }
+    return storage;
+}
+
+template <typename T>
+static Ptr<OpenGymDataContainer>
+CreateBoundBox(const ns3penv::BoxSpace& boxSpace,
+               const std::shared_ptr<OpenGymBoxStorage>& storage,
+               uint32_t& offset)
+{
+    std::vector<uint32_t> shape{boxSpace.shape().begin(), boxSpace.shape().end()};
+    uint32_t length = BoxLength(boxSpace);
+    Ptr<OpenGymBoxContainer<T>> box = CreateObject<OpenGymBoxContainer<T>>(shape);
+    box->BindStorage(storage, offset, length);
+    offset += length;
+    return box;
+}
+
+/**
+ * Creates the container of a space, with its boxes laid out in storage
+ * from offsets on, and advances offsets past them.
+ */
+static Ptr<OpenGymDataContainer>
+CreateBoundContainer(const ns3penv::SpaceDescription& desc,
+                     const std::shared_ptr<OpenGymBoxStorage>& storage,
+                     OpenGymBoxStorage::Offsets& offsets)
+{
+    switch (desc.space_variant_case())
+    {
+    case ns3penv::SpaceDescription::kDiscrete:
+        return CreateObject<OpenGymDiscreteContainer>(desc.discrete().n());
+    case ns3penv::SpaceDescription::kBox: {
+        const auto& box = desc.box();
+        Ptr<OpenGymDataContainer> container;
+        bool known = OpenGymVisitDtype(box.dtype(), [&](auto type) {
+            container = CreateBoundBox<typename decltype(type)::type>(box,
+                                                                      storage,
+                                                                      offsets[box.dtype() - 1]);
+        });
+        NS_ABORT_MSG_IF(!known, "Unsupported data type");
+        return container;
+    }
+    case ns3penv::SpaceDescription::kTuple: {
+        Ptr<OpenGymTupleContainer> tuple = CreateObject<OpenGymTupleContainer>();
+        tuple->AddFromSpaceDescription(desc.tuple(), storage, offsets);
+        return tuple;
+    }
+    case ns3penv::SpaceDescription::kDict: {
+        Ptr<OpenGymDictContainer> dict = CreateObject<OpenGymDictContainer>();
+        dict->AddFromSpaceDescription(desc.dict(), storage, offsets);
+        return dict;
+    }
+    default:
+        NS_ABORT_MSG("Unsupported space type");
+    }
+    return nullptr;
+}
+
+/** Size of the flat encoding of all values in storage of type dtype */
+static uint32_t
+FlatStorageSize(const OpenGymBoxStorage& storage, ns3penv::Dtype dtype)
+{
+    uint32_t size = 0;
+    OpenGymVisitDtype(dtype, [&](auto type) {
+        typedef typename decltype(type)::type T;
+        size = storage.Values<T>().size() * sizeof(T);
+    });
+    return size;
+}
+
+/** Writes all values in storage of type dtype as one flat vector */
+static void
+SerializeFlatStorage(const OpenGymBoxStorage& storage,
+                     ns3penv::Dtype dtype,
+                     Ns3penvFlatStateHeader* header,
+                     uint8_t* payload)
+{
+    bool known = OpenGymVisitDtype(dtype, [&](auto type) {
+        const auto& values = storage.Values<typename decltype(type)::type>();
+        header->dtype = dtype;
+        header->ndim = 1;
+        header->shape[0] = values.size();
+        header->dataSize = FlatStorageSize(storage, dtype);
+        std::memcpy(payload, values.data(), header->dataSize);
+    });
+    NS_ABORT_MSG_IF(!known, "Container cannot be flat-encoded");
+}
+
 TypeId
 OpenGymDataContainer::GetTypeId()
 {
@@ -61,102 +278,101 @@ OpenGymDataContainer::DoInitialize()
     // NS_LOG_FUNCTION (this);
 }
 
+ns3penv::DataContainer
+OpenGymDataContainer::GetDataContainerPbMsg()
+{
+    ns3penv::DataContainer dataMsg;
+    GetDataContainerPbMsg(&dataMsg);
+    return dataMsg;
+}
+
+void
+OpenGymDataContainer::GetDataContainerPbMsg(ns3penv::DataContainer* dataMsg)
+{
+    std::string name = dataMsg->name();
+    *dataMsg = GetDataContainerPbMsg();
+    dataMsg->set_name(name);
+}
+
+uint32_t
+OpenGymDataContainer::GetFlatDataSize() const
+{
+    return 0;
+}
+
+void
+OpenGymDataContainer::SerializeFlat(Ns3penvFlatStateHeader* /* header */,
+                                    uint8_t* /* payload */) const
+{
+    NS_ABORT_MSG("Container cannot be flat-encoded");
+}
+
+bool
+OpenGymDataContainer::DeserializeFlat(const uint8_t* /* payload */, uint32_t /* size */)
+{
+    return false;
+}
+
+void
+OpenGymDataContainer::RequestFullResync()
+{
+}
+
 Ptr<OpenGymDataContainer>
-OpenGymDataContainer::CreateFromDataContainerPbMsg(ns3penv::DataContainer& dataContainerPbMsg)
+OpenGymDataContainer::CreateFromDataContainerPbMsg(
+    const ns3penv::DataContainer& dataContainerPbMsg)
 {
     Ptr<OpenGymDataContainer> actDataContainer;
 
     switch (dataContainerPbMsg.data_case())
     {
     case ns3penv::DataContainer::kDiscrete: {
-        const auto& discreteMsg = dataContainerPbMsg.discrete();
-
-        Ptr<OpenGymDiscreteContainer> discrete = CreateObject<OpenGymDiscreteContainer>();
-        discrete->SetValue(discreteMsg.data());
-        actDataContainer = discrete;
+        actDataContainer = CreateObject<OpenGymDiscreteContainer>();
         break;
     }
     case ns3penv::DataContainer::kBox: {
-        const auto& boxMsg = dataContainerPbMsg.box();
-
-        switch (boxMsg.dtype())
-        {
-        case ns3penv::INT: {
-            Ptr<OpenGymBoxContainer<int32_t>> box = CreateObject<OpenGymBoxContainer<int32_t>>();
-            std::vector<int32_t> myData{boxMsg.intdata().begin(), boxMsg.intdata().end()};
-            box->SetData(myData);
-            actDataContainer = box;
-            break;
-        }
-        case ns3penv::UINT: {
-            Ptr<OpenGymBoxContainer<uint32_t>> box = CreateObject<OpenGymBoxContainer<uint32_t>>();
-            std::vector<uint32_t> myData{boxMsg.uintdata().begin(), boxMsg.uintdata().end()};
-            box->SetData(myData);
-            actDataContainer = box;
-            break;
-        }
-        case ns3penv::FLOAT: {
-            Ptr<OpenGymBoxContainer<float>> box = CreateObject<OpenGymBoxContainer<float>>();
-            std::vector<float> myData{boxMsg.floatdata().begin(), boxMsg.floatdata().end()};
-            box->SetData(myData);
-            actDataContainer = box;
-            break;
-        }
-        case ns3penv::DOUBLE: {
-            Ptr<OpenGymBoxContainer<double>> box = CreateObject<OpenGymBoxContainer<double>>();
-            std::vector<double> myData{boxMsg.doubledata().begin(), boxMsg.doubledata().end()};
-            box->SetData(myData);
-            actDataContainer = box;
-            break;
-        }
-        default: {
-            NS_ABORT_MSG("Unsupported data type");
-            break;
-        }
-        }
+        bool known = OpenGymVisitDtype(dataContainerPbMsg.box().dtype(), [&](auto type) {
+            actDataContainer = CreateObject<OpenGymBoxContainer<typename decltype(type)::type>>();
+        });
+        NS_ABORT_MSG_IF(!known, "Unsupported data type");
         break;
     }
     case ns3penv::DataContainer::kTuple: {
-        Ptr<OpenGymTupleContainer> tupleData = CreateObject<OpenGymTupleContainer>();
-
-        const auto& tupleMsg = dataContainerPbMsg.tuple();
-        std::vector<ns3penv::DataContainer> elements;
-        elements.assign(tupleMsg.element().begin(), tupleMsg.element().end());
-
-        for (auto& element : elements)
-        {
-            Ptr<OpenGymDataContainer> subData =
-                OpenGymDataContainer::CreateFromDataContainerPbMsg(element);
-            tupleData->Add(subData);
-        }
-
-        actDataContainer = tupleData;
+        actDataContainer = CreateObject<OpenGymTupleContainer>();
         break;
     }
     case ns3penv::DataContainer::kDict: {
-        Ptr<OpenGymDictContainer> dictData = CreateObject<OpenGymDictContainer>();
-        const auto& dictMsg = dataContainerPbMsg.dict();
-
-        std::vector<ns3penv::DataContainer> elements{dictMsg.element().begin(),
-                                                     dictMsg.element().end()};
-
-        for (auto& element : elements)
-        {
-            Ptr<OpenGymDataContainer> subSpace =
-                OpenGymDataContainer::CreateFromDataContainerPbMsg(element);
-            dictData->Add(element.name(), subSpace);
-        }
-
-        actDataContainer = dictData;
+        actDataContainer = CreateObject<OpenGymDictContainer>();
         break;
     }
     default:
         NS_ABORT_MSG("Unsupported data container type");
         break;
     }
+    // a new container of the right type always accepts the message
+    actDataContainer->UpdateFromDataContainerPbMsg(dataContainerPbMsg);
     return actDataContainer;
 }
 
+bool
+OpenGymDataContainer::UpdateFromDataContainerPbMsg(
+    const ns3penv::DataContainer& /* dataContainerPbMsg */)
+{
+    return false;
+}
+
+Ptr<OpenGymDataContainer>
+OpenGymDataContainer::UpdateOrCreateFromDataContainerPbMsg(
+    Ptr<OpenGymDataContainer> container,
+    const ns3penv::DataContainer& dataContainerPbMsg)
+{
+    if (container && container->UpdateFromDataContainerPbMsg(dataContainerPbMsg))
+    {
+        return container;
+    }
+    return CreateFromDataContainerPbMsg(dataContainerPbMsg);
+}
+
 TypeId
 OpenGymDiscreteContainer::GetTypeId()
 {
@@ -196,13 +412,23 @@ OpenGymDiscreteContainer::DoInitialize()
     // NS_LOG_FUNCTION (this);
 }
 
-ns3penv::DataContainer
-OpenGymDiscreteContainer::GetDataContainerPbMsg()
+void
+OpenGymDiscreteContainer::GetDataContainerPbMsg(ns3penv::DataContainer* dataMsg)
 {
-    ns3penv::DataContainer dataMsg;
-    ns3penv::DiscreteDataContainer* discreteMsg = dataMsg.mutable_discrete();
+    ns3penv::DiscreteDataContainer* discreteMsg = dataMsg->mutable_discrete();
     discreteMsg->set_data(GetValue());
-    return dataMsg;
+}
+
+bool
+OpenGymDiscreteContainer::UpdateFromDataContainerPbMsg(
+    const ns3penv::DataContainer& dataContainerPbMsg)
+{
+    if (!dataContainerPbMsg.has_discrete())
+    {
+        return false;
+    }
+    SetValue(dataContainerPbMsg.discrete().data());
+    return true;
 }
 
 bool
@@ -238,15 +464,39 @@ OpenGymBoxContainer<T>::GetTypeId()
 
 template <typename T>
 OpenGymBoxContainer<T>::OpenGymBoxContainer()
+    : m_dtype(OpenGymBoxTraits<T>::dtype),
+      m_view(nullptr),
+      m_viewSize(0),
+      m_deltaMode(false),
+      m_needsResync(true),
+      m_seq(0)
 {
-    SetDtype();
 }
 
 template <typename T>
 OpenGymBoxContainer<T>::OpenGymBoxContainer(std::vector<uint32_t> shape)
-    : m_shape(shape)
+    : m_shape(shape),
+      m_dtype(OpenGymBoxTraits<T>::dtype),
+      m_view(nullptr),
+      m_viewSize(0),
+      m_deltaMode(false),
+      m_needsResync(true),
+      m_seq(0)
 {
-    SetDtype();
+}
+
+template <typename T>
+OpenGymBoxContainer<T>::OpenGymBoxContainer(std::vector<uint32_t> shape, T value)
+    : m_shape(shape),
+      m_dtype(OpenGymBoxTraits<T>::dtype),
+      m_view(nullptr),
+      m_viewSize(0),
+      m_deltaMode(false),
+      m_needsResync(true),
+      m_seq(0)
+{
+    Reserve();
+    m_data.resize(ShapeLength(), value);
 }
 
 template <typename T>
@@ -256,135 +506,509 @@ OpenGymBoxContainer<T>::~OpenGymBoxContainer()
 
 template <typename T>
 void
-OpenGymBoxContainer<T>::SetDtype()
+OpenGymBoxContainer<T>::DoDispose()
 {
-    std::string name = TypeNameGet<T>();
-    if (name == "int8_t" || name == "int16_t" || name == "int32_t" || name == "int64_t")
+}
+
+template <typename T>
+void
+OpenGymBoxContainer<T>::DoInitialize()
+{
+}
+
+template <typename T>
+void
+OpenGymBoxContainer<T>::GetDataContainerPbMsg(ns3penv::DataContainer* dataMsg)
+{
+    CheckShape();
+    ns3penv::BoxDataContainer* boxMsg = dataMsg->mutable_box();
+    // a reused message keeps the capacity of its fields
+    boxMsg->Clear();
+
+    *boxMsg->mutable_shape() = {m_shape.begin(), m_shape.end()};
+
+    boxMsg->set_dtype(m_dtype);
+
+    if (m_deltaMode)
     {
-        m_dtype = ns3penv::INT;
+        boxMsg->set_seq(++m_seq);
+        bool delta = !m_needsResync && MergeDirtySpans(m_dirty, Size());
+        m_needsResync = false;
+        if (delta)
+        {
+            boxMsg->set_isdelta(true);
+            for (const auto& [begin, end] : m_dirty)
+            {
+                boxMsg->add_spanoffsets(begin);
+                boxMsg->add_spanlengths(end - begin);
+            }
+            AddSpans(OpenGymBoxTraits<T>::Mutable(boxMsg));
+            m_dirty.clear();
+            return;
+        }
+        m_dirty.clear();
     }
-    else if (name == "uint8_t" || name == "uint16_t" || name == "uint32_t" || name == "uint64_t")
+
+    AddValues(OpenGymBoxTraits<T>::Mutable(boxMsg), 0, Size());
+}
+
+template <typename T>
+bool
+OpenGymBoxContainer<T>::UpdateFromDataContainerPbMsg(
+    const ns3penv::DataContainer& dataContainerPbMsg)
+{
+    if (!dataContainerPbMsg.has_box() || dataContainerPbMsg.box().dtype() != m_dtype)
     {
-        m_dtype = ns3penv::UINT;
+        return false;
     }
-    else if (name == "float")
+    const auto& boxMsg = dataContainerPbMsg.box();
+    std::vector<uint32_t> shape{boxMsg.shape().begin(), boxMsg.shape().end()};
+    if (m_view && !shape.empty() && shape != m_shape)
     {
-        m_dtype = ns3penv::FLOAT;
+        return false;
     }
-    else if (name == "double")
+    const auto& values = OpenGymBoxTraits<T>::Get(boxMsg);
+    uint32_t count = OpenGymBoxFieldSize<T>(values);
+    if (m_view && count != m_viewSize)
     {
-        m_dtype = ns3penv::DOUBLE;
+        return false;
     }
-    else
+    if (!m_view)
     {
-        NS_ABORT_MSG("Unsupported data type: " + name);
+        // resize keeps the capacity, so a box of steady size does not allocate
+        m_data.resize(count);
+        m_shape = std::move(shape);
+        if (!MatchesShape())
+        {
+            // keep the values as one dimension rather than losing them
+            m_shape.clear();
+        }
     }
+    OpenGymBoxFieldCopy<T>(values, Values());
+    RequestFullResync();
+    return true;
 }
 
 template <typename T>
+template <typename F>
 void
-OpenGymBoxContainer<T>::DoDispose()
+OpenGymBoxContainer<T>::AddSpans(F* field) const
 {
+    uint32_t count = 0;
+    for (const auto& [begin, end] : m_dirty)
+    {
+        count += end - begin;
+    }
+    OpenGymBoxFieldReserve<T>(field, count);
+    for (const auto& [begin, end] : m_dirty)
+    {
+        AddValues(field, begin, end);
+    }
 }
 
 template <typename T>
+template <typename F>
 void
-OpenGymBoxContainer<T>::DoInitialize()
+OpenGymBoxContainer<T>::AddValues(F* field, uint32_t begin, uint32_t end) const
 {
+    // a plain copy, F always holds T or its bytes
+    OpenGymBoxFieldAppend<T>(field, Values() + begin, Values() + end);
 }
 
 template <typename T>
-ns3penv::DataContainer
-OpenGymBoxContainer<T>::GetDataContainerPbMsg()
+uint32_t
+OpenGymBoxContainer<T>::GetFlatDataSize() const
 {
-    ns3penv::DataContainer dataMsg;
-    ns3penv::BoxDataContainer* boxMsg = dataMsg.mutable_box();
+    if (m_deltaMode || m_shape.size() > NS3PENV_FLAT_MAX_NDIM)
+    {
+        return 0;
+    }
+    // Python views the payload with the shape of the header
+    CheckShape();
+    return Size() * sizeof(T);
+}
 
-    std::vector<uint32_t> shape = GetShape();
-    *boxMsg->mutable_shape() = {shape.begin(), shape.end()};
+template <typename T>
+void
+OpenGymBoxContainer<T>::SerializeFlat(Ns3penvFlatStateHeader* header, uint8_t* payload) const
+{
+    header->dtype = m_dtype;
+    if (m_shape.empty())
+    {
+        header->ndim = 1;
+        header->shape[0] = Size();
+    }
+    else
+    {
+        header->ndim = m_shape.size();
+        std::copy(m_shape.begin(), m_shape.end(), header->shape);
+    }
+    header->dataSize = Size() * sizeof(T);
+    std::memcpy(payload, Values(), header->dataSize);
+}
 
-    boxMsg->set_dtype(m_dtype);
-    std::vector<T> data = GetData();
+template <typename T>
+bool
+OpenGymBoxContainer<T>::AddValue(T value)
+{
+    if (m_view || (!m_shape.empty() && Size() >= ShapeLength()))
+    {
+        return false;
+    }
+    m_data.push_back(value);
+    m_needsResync = true;
+    return true;
+}
 
-    switch (m_dtype)
+template <typename T>
+T
+OpenGymBoxContainer<T>::GetValue(uint32_t idx)
+{
+    T data = 0;
+    if (idx < Size())
     {
-    case ns3penv::INT: {
-        *boxMsg->mutable_intdata() = {data.begin(), data.end()};
-        break;
+        data = Values()[idx];
     }
-    case ns3penv::UINT: {
-        *boxMsg->mutable_uintdata() = {data.begin(), data.end()};
-        break;
+    return data;
+}
+
+template <typename T>
+T
+OpenGymBoxContainer<T>::GetValue(const std::vector<uint32_t>& index)
+{
+    uint32_t flat;
+    if (!GetFlatIndex(index, flat))
+    {
+        return 0;
     }
-    case ns3penv::FLOAT: {
-        *boxMsg->mutable_floatdata() = {data.begin(), data.end()};
-        break;
+    return GetValue(flat);
+}
+
+template <typename T>
+bool
+OpenGymBoxContainer<T>::SetValue(const std::vector<uint32_t>& index, T value)
+{
+    uint32_t flat;
+    return GetFlatIndex(index, flat) && SetValue(flat, value);
+}
+
+template <typename T>
+bool
+OpenGymBoxContainer<T>::SetValue(uint32_t idx, T value)
+{
+    if (idx >= Size())
+    {
+        return false;
     }
-    case ns3penv::DOUBLE: {
-        *boxMsg->mutable_doubledata() = {data.begin(), data.end()};
-        break;
+    T* values = Values();
+    if (m_deltaMode && values[idx] != value)
+    {
+        MarkDirty(idx, idx + 1);
+    }
+    values[idx] = value;
+    return true;
+}
+
+template <typename T>
+void
+OpenGymBoxContainer<T>::MarkChanged(const T* data, std::size_t size)
+{
+    if (!m_deltaMode || m_needsResync)
+    {
+        return;
     }
-    default: {
-        NS_ABORT_MSG("Unsupported data type.");
+    if (size != Size())
+    {
+        m_needsResync = true;
+        return;
     }
+    const T* values = Values();
+    uint32_t i = 0;
+    while (i < size)
+    {
+        if (data[i] == values[i])
+        {
+            ++i;
+            continue;
+        }
+        uint32_t begin = i;
+        while (i < size && data[i] != values[i])
+        {
+            ++i;
+        }
+        MarkDirty(begin, i);
     }
+}
 
-    return dataMsg;
+template <typename T>
+bool
+OpenGymBoxContainer<T>::SetData(const std::vector<T>& data)
+{
+    return SetData(std::span<const T>(data));
 }
 
 template <typename T>
 bool
-OpenGymBoxContainer<T>::AddValue(T value)
+OpenGymBoxContainer<T>::SetData(std::vector<T>&& data)
 {
-    m_data.push_back(value);
+    if (m_view)
+    {
+        return SetData(std::span<const T>(data));
+    }
+    if (!m_shape.empty() && data.size() != ShapeLength())
+    {
+        return false;
+    }
+    MarkChanged(data.data(), data.size());
+    m_data = std::move(data);
     return true;
 }
 
 template <typename T>
-T
-OpenGymBoxContainer<T>::GetValue(uint32_t idx)
+bool
+OpenGymBoxContainer<T>::SetData(std::span<const T> data)
 {
-    T data = 0;
-    if (idx < m_data.size())
+    if ((m_view && data.size() != m_viewSize) ||
+        (!m_shape.empty() && data.size() != ShapeLength()))
     {
-        data = m_data.at(idx);
+        return false;
     }
-    return data;
+    MarkChanged(data.data(), data.size());
+    if (m_view)
+    {
+        std::copy(data.begin(), data.end(), m_view);
+    }
+    else
+    {
+        // reuses the capacity of the values
+        m_data.assign(data.begin(), data.end());
+    }
+    return true;
+}
+
+template <typename T>
+void
+OpenGymBoxContainer<T>::SetDeltaMode(bool deltaMode)
+{
+    m_deltaMode = deltaMode;
+    m_needsResync = true;
+    m_dirty.clear();
+}
+
+template <typename T>
+bool
+OpenGymBoxContainer<T>::GetDeltaMode() const
+{
+    return m_deltaMode;
+}
+
+template <typename T>
+void
+OpenGymBoxContainer<T>::MarkDirty(uint32_t begin, uint32_t end)
+{
+    end = std::min<uint32_t>(end, Size());
+    if (!m_deltaMode || m_needsResync || begin >= end)
+    {
+        return;
+    }
+    if (!m_dirty.empty() && m_dirty.back().second == begin)
+    {
+        m_dirty.back().second = end;
+        return;
+    }
+    m_dirty.emplace_back(begin, end);
+}
+
+template <typename T>
+void
+OpenGymBoxContainer<T>::RequestFullResync()
+{
+    m_needsResync = true;
+    m_dirty.clear();
+}
+
+template <typename T>
+const std::vector<uint32_t>&
+OpenGymBoxContainer<T>::GetShape() const
+{
+    return m_shape;
 }
 
 template <typename T>
 bool
-OpenGymBoxContainer<T>::SetData(std::vector<T> data)
+OpenGymBoxContainer<T>::Reshape(std::vector<uint32_t> shape)
 {
-    m_data = data;
+    std::swap(m_shape, shape);
+    if (m_view && !m_shape.empty() && ShapeLength() != m_viewSize)
+    {
+        std::swap(m_shape, shape);
+        return false;
+    }
     return true;
 }
 
 template <typename T>
 std::vector<uint32_t>
-OpenGymBoxContainer<T>::GetShape()
+OpenGymBoxContainer<T>::GetStrides() const
 {
-    return m_shape;
+    std::vector<uint32_t> strides(m_shape.size());
+    uint32_t stride = 1;
+    for (std::size_t i = m_shape.size(); i-- > 0;)
+    {
+        strides[i] = stride;
+        stride *= m_shape[i];
+    }
+    return strides;
+}
+
+template <typename T>
+std::span<const T>
+OpenGymBoxContainer<T>::GetSlice(uint32_t i) const
+{
+    if (m_shape.empty() || i >= m_shape[0] || !MatchesShape())
+    {
+        return {};
+    }
+    uint32_t length = Size() / m_shape[0];
+    return std::span<const T>(Values() + i * length, length);
+}
+
+template <typename T>
+std::span<T>
+OpenGymBoxContainer<T>::MutableSlice(uint32_t i)
+{
+    if (m_shape.empty() || i >= m_shape[0] || !MatchesShape())
+    {
+        return {};
+    }
+    uint32_t length = Size() / m_shape[0];
+    return std::span<T>(Values() + i * length, length);
+}
+
+template <typename T>
+bool
+OpenGymBoxContainer<T>::MatchesShape() const
+{
+    return m_shape.empty() || Size() == ShapeLength();
+}
+
+template <typename T>
+uint64_t
+OpenGymBoxContainer<T>::ShapeLength() const
+{
+    uint64_t length = 1;
+    for (const auto& dim : m_shape)
+    {
+        length *= dim;
+    }
+    return length;
+}
+
+template <typename T>
+void
+OpenGymBoxContainer<T>::CheckShape() const
+{
+    NS_ABORT_MSG_IF(!MatchesShape(),
+                    "Box of " << m_shape.size() << " dimensions holding " << ShapeLength()
+                              << " values has " << Size());
+}
+
+template <typename T>
+bool
+OpenGymBoxContainer<T>::GetFlatIndex(const std::vector<uint32_t>& index, uint32_t& flat) const
+{
+    if (index.size() != m_shape.size() || !MatchesShape())
+    {
+        return false;
+    }
+    flat = 0;
+    for (std::size_t i = 0; i < index.size(); ++i)
+    {
+        if (index[i] >= m_shape[i])
+        {
+            return false;
+        }
+        flat = flat * m_shape[i] + index[i];
+    }
+    return true;
 }
 
 template <typename T>
 std::vector<T>
-OpenGymBoxContainer<T>::GetData()
+OpenGymBoxContainer<T>::GetData() const
 {
+    return std::vector<T>(Values(), Values() + Size());
+}
+
+template <typename T>
+std::span<const T>
+OpenGymBoxContainer<T>::GetDataView() const
+{
+    return std::span<const T>(Values(), Size());
+}
+
+template <typename T>
+std::vector<T>&
+OpenGymBoxContainer<T>::MutableData()
+{
+    NS_ABORT_MSG_IF(m_view, "Box is bound to a shared storage, use SetData or SetValue");
     return m_data;
 }
 
+template <typename T>
+std::span<T>
+OpenGymBoxContainer<T>::MutableView()
+{
+    return std::span<T>(Values(), Size());
+}
+
+template <typename T>
+void
+OpenGymBoxContainer<T>::Reserve()
+{
+    if (m_view)
+    {
+        return;
+    }
+    uint64_t length = 1;
+    for (const auto& dim : m_shape)
+    {
+        length *= dim;
+    }
+    NS_ABORT_MSG_IF(length > UINT32_MAX, "Box has too many values");
+    m_data.reserve(length);
+}
+
+template <typename T>
+void
+OpenGymBoxContainer<T>::BindStorage(std::shared_ptr<OpenGymBoxStorage> storage,
+                                    uint32_t offset,
+                                    uint32_t length)
+{
+    std::vector<T>& values = storage->Values<T>();
+    NS_ABORT_MSG_IF(uint64_t(offset) + length > values.size(),
+                    "Box does not fit the shared storage");
+    std::copy_n(Values(), std::min(Size(), length), values.data() + offset);
+    m_view = values.data() + offset;
+    m_viewSize = length;
+    m_storage = std::move(storage);
+    m_data.clear();
+    m_data.shrink_to_fit();
+    RequestFullResync();
+}
+
 template <typename T>
 void
 OpenGymBoxContainer<T>::Print(std::ostream& where) const
 {
     where << "[";
-    for (auto i = m_data.begin(); i != m_data.end(); ++i)
+    const T* end = Values() + Size();
+    for (const T* i = Values(); i != end; ++i)
     {
         where << std::to_string(*i);
         auto i2 = i;
         i2++;
-        if (i2 != m_data.end())
+        if (i2 != end)
         {
             where << ", ";
         }
@@ -403,10 +1027,22 @@ OpenGymTupleContainer::GetTypeId()
 }
 
 OpenGymTupleContainer::OpenGymTupleContainer()
+    : m_flatDtype(ns3penv::NoDType)
 {
     // NS_LOG_FUNCTION (this);
 }
 
+OpenGymTupleContainer::OpenGymTupleContainer(Ptr<OpenGymTupleSpace> space)
+{
+    NS_LOG_FUNCTION(this);
+    const ns3penv::SpaceDescription& desc = space->GetCachedSpaceDescription();
+    ns3penv::Dtype flatDtype;
+    m_storage = CreateBoxStorage(desc, flatDtype);
+    OpenGymBoxStorage::Offsets offsets{};
+    AddFromSpaceDescription(desc.tuple(), m_storage, offsets);
+    m_flatDtype = flatDtype;
+}
+
 OpenGymTupleContainer::~OpenGymTupleContainer()
 {
     // NS_LOG_FUNCTION (this);
@@ -424,20 +1060,60 @@ OpenGymTupleContainer::DoInitialize()
     // NS_LOG_FUNCTION (this);
 }
 
-ns3penv::DataContainer
-OpenGymTupleContainer::GetDataContainerPbMsg()
+void
+OpenGymTupleContainer::GetDataContainerPbMsg(ns3penv::DataContainer* dataMsg)
 {
-    ns3penv::DataContainer dataMsg;
-    ns3penv::TupleDataContainer* tupleMsg = dataMsg.mutable_tuple();
+    ns3penv::TupleDataContainer* tupleMsg = dataMsg->mutable_tuple();
+    tupleMsg->Clear();
 
     for (const auto& subSpace : m_tuple)
     {
-        ns3penv::DataContainer subDataContainer = subSpace->GetDataContainerPbMsg();
+        subSpace->GetDataContainerPbMsg(tupleMsg->add_element());
+    }
+}
 
-        tupleMsg->add_element()->CopyFrom(subDataContainer);
+bool
+OpenGymTupleContainer::UpdateFromDataContainerPbMsg(
+    const ns3penv::DataContainer& dataContainerPbMsg)
+{
+    if (!dataContainerPbMsg.has_tuple())
+    {
+        return false;
+    }
+    const auto& elements = dataContainerPbMsg.tuple().element();
+    if (m_tuple.size() > static_cast<std::size_t>(elements.size()))
+    {
+        m_tuple.resize(elements.size());
+        m_flatDtype = ns3penv::NoDType;
     }
+    for (int i = 0; i < elements.size(); ++i)
+    {
+        if (static_cast<std::size_t>(i) == m_tuple.size())
+        {
+            m_tuple.push_back(CreateFromDataContainerPbMsg(elements[i]));
+            m_flatDtype = ns3penv::NoDType;
+        }
+        else
+        {
+            Ptr<OpenGymDataContainer> data =
+                UpdateOrCreateFromDataContainerPbMsg(m_tuple[i], elements[i]);
+            if (data != m_tuple[i])
+            {
+                m_tuple[i] = data;
+                m_flatDtype = ns3penv::NoDType;
+            }
+        }
+    }
+    return true;
+}
 
-    return dataMsg;
+void
+OpenGymTupleContainer::RequestFullResync()
+{
+    for (const auto& subSpace : m_tuple)
+    {
+        subSpace->RequestFullResync();
+    }
 }
 
 bool
@@ -445,9 +1121,41 @@ OpenGymTupleContainer::Add(Ptr<OpenGymDataContainer> space)
 {
     NS_LOG_FUNCTION(this);
     m_tuple.push_back(space);
+    // the new element is not part of the storage
+    m_flatDtype = ns3penv::NoDType;
     return true;
 }
 
+void
+OpenGymTupleContainer::AddFromSpaceDescription(const ns3penv::TupleSpace& tupleSpace,
+                                               std::shared_ptr<OpenGymBoxStorage> storage,
+                                               OpenGymBoxStorage::Offsets& offsets)
+{
+    m_tuple.reserve(m_tuple.size() + tupleSpace.element_size());
+    for (const auto& element : tupleSpace.element())
+    {
+        m_tuple.push_back(CreateBoundContainer(element, storage, offsets));
+    }
+    m_flatDtype = ns3penv::NoDType;
+}
+
+uint32_t
+OpenGymTupleContainer::GetFlatDataSize() const
+{
+    if (!m_storage || m_flatDtype == ns3penv::NoDType)
+    {
+        return 0;
+    }
+    return FlatStorageSize(*m_storage, m_flatDtype);
+}
+
+void
+OpenGymTupleContainer::SerializeFlat(Ns3penvFlatStateHeader* header, uint8_t* payload) const
+{
+    // the boxes of the tuple in order, which is how the storage is laid out
+    SerializeFlatStorage(*m_storage, m_flatDtype, header, payload);
+}
+
 Ptr<OpenGymDataContainer>
 OpenGymTupleContainer::Get(uint32_t idx)
 {
@@ -461,6 +1169,12 @@ OpenGymTupleContainer::Get(uint32_t idx)
     return data;
 }
 
+const std::vector<Ptr<OpenGymDataContainer>>&
+OpenGymTupleContainer::GetElements() const
+{
+    return m_tuple;
+}
+
 void
 OpenGymTupleContainer::Print(std::ostream& where) const
 {
@@ -494,10 +1208,22 @@ OpenGymDictContainer::GetTypeId()
 }
 
 OpenGymDictContainer::OpenGymDictContainer()
+    : m_flatDtype(ns3penv::NoDType)
 {
     NS_LOG_FUNCTION(this);
 }
 
+OpenGymDictContainer::OpenGymDictContainer(Ptr<OpenGymDictSpace> space)
+{
+    NS_LOG_FUNCTION(this);
+    const ns3penv::SpaceDescription& desc = space->GetCachedSpaceDescription();
+    ns3penv::Dtype flatDtype;
+    m_storage = CreateBoxStorage(desc, flatDtype);
+    OpenGymBoxStorage::Offsets offsets{};
+    AddFromSpaceDescription(desc.dict(), m_storage, offsets);
+    m_flatDtype = flatDtype;
+}
+
 OpenGymDictContainer::~OpenGymDictContainer()
 {
     NS_LOG_FUNCTION(this);
@@ -515,21 +1241,63 @@ OpenGymDictContainer::DoInitialize()
     NS_LOG_FUNCTION(this);
 }
 
-ns3penv::DataContainer
-OpenGymDictContainer::GetDataContainerPbMsg()
+void
+OpenGymDictContainer::GetDataContainerPbMsg(ns3penv::DataContainer* dataMsg)
 {
-    ns3penv::DataContainer dataMsg;
-    ns3penv::DictDataContainer* dictMsg = dataMsg.mutable_dict();
+    ns3penv::DictDataContainer* dictMsg = dataMsg->mutable_dict();
+    dictMsg->Clear();
 
     for (auto& [name, subSpace] : m_dict)
     {
-        ns3penv::DataContainer subDataContainer = subSpace->GetDataContainerPbMsg();
-        subDataContainer.set_name(name);
+        ns3penv::DataContainer* subDataContainer = dictMsg->add_element();
+        subDataContainer->set_name(name);
+        subSpace->GetDataContainerPbMsg(subDataContainer);
+    }
+}
 
-        dictMsg->add_element()->CopyFrom(subDataContainer);
+bool
+OpenGymDictContainer::UpdateFromDataContainerPbMsg(
+    const ns3penv::DataContainer& dataContainerPbMsg)
+{
+    if (!dataContainerPbMsg.has_dict())
+    {
+        return false;
+    }
+    const auto& elements = dataContainerPbMsg.dict().element();
+    if (m_dict.size() != static_cast<std::size_t>(elements.size()))
+    {
+        m_dict.clear();
+        m_flatDtype = ns3penv::NoDType;
     }
+    for (const auto& element : elements)
+    {
+        Ptr<OpenGymDataContainer>& data = m_dict[element.name()];
+        Ptr<OpenGymDataContainer> updated = UpdateOrCreateFromDataContainerPbMsg(data, element);
+        if (updated != data)
+        {
+            data = updated;
+            m_flatDtype = ns3penv::NoDType;
+        }
+    }
+    if (m_dict.size() != static_cast<std::size_t>(elements.size()))
+    {
+        // keys changed, drop the stale ones
+        m_dict.clear();
+        for (const auto& element : elements)
+        {
+            m_dict[element.name()] = CreateFromDataContainerPbMsg(element);
+        }
+    }
+    return true;
+}
 
-    return dataMsg;
+void
+OpenGymDictContainer::RequestFullResync()
+{
+    for (auto& [name, subSpace] : m_dict)
+    {
+        subSpace->RequestFullResync();
+    }
 }
 
 bool
@@ -537,9 +1305,40 @@ OpenGymDictContainer::Add(std::string key, Ptr<OpenGymDataContainer> data)
 {
     NS_LOG_FUNCTION(this);
     m_dict.insert(std::pair<std::string, Ptr<OpenGymDataContainer>>(key, data));
+    // the new entry is not part of the storage
+    m_flatDtype = ns3penv::NoDType;
     return true;
 }
 
+void
+OpenGymDictContainer::AddFromSpaceDescription(const ns3penv::DictSpace& dictSpace,
+                                              std::shared_ptr<OpenGymBoxStorage> storage,
+                                              OpenGymBoxStorage::Offsets& offsets)
+{
+    for (const auto& element : dictSpace.element())
+    {
+        m_dict[element.name()] = CreateBoundContainer(element, storage, offsets);
+    }
+    m_flatDtype = ns3penv::NoDType;
+}
+
+uint32_t
+OpenGymDictContainer::GetFlatDataSize() const
+{
+    if (!m_storage || m_flatDtype == ns3penv::NoDType)
+    {
+        return 0;
+    }
+    return FlatStorageSize(*m_storage, m_flatDtype);
+}
+
+void
+OpenGymDictContainer::SerializeFlat(Ns3penvFlatStateHeader* header, uint8_t* payload) const
+{
+    // dict spaces describe their entries in key order, as the storage
+    SerializeFlatStorage(*m_storage, m_flatDtype, header, payload);
+}
+
 Ptr<OpenGymDataContainer>
 OpenGymDictContainer::Get(std::string key)
 {
@@ -552,6 +1351,12 @@ OpenGymDictContainer::Get(std::string key)
     return data;
 }
 
+const std::map<std::string, Ptr<OpenGymDataContainer>>&
+OpenGymDictContainer::GetEntries() const
+{
+    return m_dict;
+}
+
 void
 OpenGymDictContainer::Print(std::ostream& where) const
 {
@@ -582,5 +1387,9 @@ template class OpenGymBoxContainer<int32_t>;
 template class OpenGymBoxContainer<uint32_t>;
 template class OpenGymBoxContainer<float>;
 template class OpenGymBoxContainer<double>;
+template class OpenGymBoxContainer<int8_t>;
+template class OpenGymBoxContainer<uint8_t>;
+template class OpenGymBoxContainer<int64_t>;
+template class OpenGymBoxContainer<OpenGymFloat16>;
 
 } // namespace ns3
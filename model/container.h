@@ -24,10 +24,20 @@
 #define OPENGYM_CONTAINER_H
 
 #include "messages.pb.h"
+#include "ns3penv-flat-msg.h"
+#include "quantize.h"
 
 #include <ns3/object.h>
 #include <ns3/type-name.h>
 
+#include <array>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
 namespace ns3
 {
 
@@ -45,12 +55,64 @@ class OpenGymDataContainer : public Object
 
     static TypeId GetTypeId();
 
-    /** @brief get the protobuf message */
-    virtual ns3penv::DataContainer GetDataContainerPbMsg() = 0;
+    /**
+     * @brief get the protobuf message, by default written by the overload
+     * below. Kept virtual for containers that only override this one.
+     */
+    virtual ns3penv::DataContainer GetDataContainerPbMsg();
+
+    /**
+     * @brief write the protobuf message into dataMsg, replacing its data
+     * but keeping its name. A reused or arena-allocated dataMsg saves the
+     * allocations of building a new message. The default copies the message
+     * of the overload above; a container overrides at least one of the two.
+     */
+    virtual void GetDataContainerPbMsg(ns3penv::DataContainer* dataMsg);
+
+    /**
+     * @brief get the size in bytes of the raw payload of the flat encoding
+     * @returns 0 if the container cannot be flat-encoded
+     */
+    virtual uint32_t GetFlatDataSize() const;
+
+    /**
+     * @brief fill dtype and shape of the flat header and write the raw
+     * payload, which must have room for GetFlatDataSize() bytes
+     */
+    virtual void SerializeFlat(Ns3penvFlatStateHeader* header, uint8_t* payload) const;
+
+    /**
+     * @brief fill the container from a raw payload as SerializeFlat writes it
+     * @returns false if the container cannot be, the default
+     */
+    virtual bool DeserializeFlat(const uint8_t* payload, uint32_t size);
+
+    /**
+     * @brief make the next protobuf message carry the full data, for
+     * containers in delta mode. Does nothing by default.
+     */
+    virtual void RequestFullResync();
 
     /** @brief create the container from the protobuf message */
     static Ptr<OpenGymDataContainer> CreateFromDataContainerPbMsg(
-        ns3penv::DataContainer& dataContainer);
+        const ns3penv::DataContainer& dataContainer);
+
+    /**
+     * @brief fill the container in place from the protobuf message
+     * @returns false if the message does not match the type of the
+     * container, true otherwise. Children of a Tuple or Dict that do not
+     * match are replaced.
+     */
+    virtual bool UpdateFromDataContainerPbMsg(const ns3penv::DataContainer& dataContainer);
+
+    /**
+     * @brief fill container in place from the protobuf message if possible,
+     * so that the object graph is reused across steps
+     * @returns container, or a new container if it is null or does not match
+     */
+    static Ptr<OpenGymDataContainer> UpdateOrCreateFromDataContainerPbMsg(
+        Ptr<OpenGymDataContainer> container,
+        const ns3penv::DataContainer& dataContainer);
 
     /** @brief print the container for debugging purposes */
     virtual void Print(std::ostream& where) const = 0;
@@ -93,10 +155,17 @@ class OpenGymDiscreteContainer : public OpenGymDataContainer
      */
     static TypeId GetTypeId();
 
+    using OpenGymDataContainer::GetDataContainerPbMsg;
+
     /**
      * @brief Read the protobuf message and get the container data
      */
-    ns3penv::DataContainer GetDataContainerPbMsg() override;
+    void GetDataContainerPbMsg(ns3penv::DataContainer* dataMsg) override;
+
+    /**
+     * @brief Set the value from the protobuf message
+     */
+    bool UpdateFromDataContainerPbMsg(const ns3penv::DataContainer& dataContainer) override;
 
     /**
      * @brief Print the container for debugging purposes
@@ -133,6 +202,180 @@ class OpenGymDiscreteContainer : public OpenGymDataContainer
     uint32_t m_value; // the actual discrete value
 };
 
+class OpenGymTupleSpace;
+class OpenGymDictSpace;
+
+/**
+ * @brief Maps the value type of a box to its dtype and to the field of
+ * BoxDataContainer holding its values
+ *
+ * Types without a protobuf field of their size are sent as raw bytes in
+ * byteData, in the byte order of the host.
+ */
+template <typename T>
+struct OpenGymBoxTraits;
+
+#define OPENGYM_BOX_TRAITS(type, fieldType, boxDtype, field)                                       \
+    template <>                                                                                    \
+    struct OpenGymBoxTraits<type>                                                                  \
+    {                                                                                              \
+        typedef fieldType Field;                                                                   \
+        static constexpr ns3penv::Dtype dtype = ns3penv::boxDtype;                                 \
+                                                                                                   \
+        static Field* Mutable(ns3penv::BoxDataContainer* box)                                      \
+        {                                                                                          \
+            return box->mutable_##field();                                                         \
+        }                                                                                          \
+                                                                                                   \
+        static const Field& Get(const ns3penv::BoxDataContainer& box)                              \
+        {                                                                                          \
+            return box.field();                                                                    \
+        }                                                                                          \
+    }
+
+OPENGYM_BOX_TRAITS(int32_t, google::protobuf::RepeatedField<int32_t>, INT, intdata);
+OPENGYM_BOX_TRAITS(uint32_t, google::protobuf::RepeatedField<uint32_t>, UINT, uintdata);
+OPENGYM_BOX_TRAITS(float, google::protobuf::RepeatedField<float>, FLOAT, floatdata);
+OPENGYM_BOX_TRAITS(double, google::protobuf::RepeatedField<double>, DOUBLE, doubledata);
+OPENGYM_BOX_TRAITS(int8_t, std::string, INT8, bytedata);
+OPENGYM_BOX_TRAITS(uint8_t, std::string, UINT8, bytedata);
+OPENGYM_BOX_TRAITS(int64_t, google::protobuf::RepeatedField<int64_t>, INT64, int64data);
+OPENGYM_BOX_TRAITS(OpenGymFloat16, std::string, FLOAT16, bytedata);
+
+#undef OPENGYM_BOX_TRAITS
+
+/** @brief number of values of type T in a box message field */
+template <typename T>
+uint32_t
+OpenGymBoxFieldSize(const typename OpenGymBoxTraits<T>::Field& field)
+{
+    if constexpr (std::is_same_v<typename OpenGymBoxTraits<T>::Field, std::string>)
+    {
+        return field.size() / sizeof(T);
+    }
+    else
+    {
+        return field.size();
+    }
+}
+
+/** @brief copy the values of a box message field to dst */
+template <typename T>
+void
+OpenGymBoxFieldCopy(const typename OpenGymBoxTraits<T>::Field& field, T* dst)
+{
+    if constexpr (std::is_same_v<typename OpenGymBoxTraits<T>::Field, std::string>)
+    {
+        std::memcpy(dst, field.data(), OpenGymBoxFieldSize<T>(field) * sizeof(T));
+    }
+    else
+    {
+        std::copy(field.begin(), field.end(), dst);
+    }
+}
+
+/** @brief append the values in [begin, end) to a box message field */
+template <typename T>
+void
+OpenGymBoxFieldAppend(typename OpenGymBoxTraits<T>::Field* field, const T* begin, const T* end)
+{
+    if constexpr (std::is_same_v<typename OpenGymBoxTraits<T>::Field, std::string>)
+    {
+        field->append(reinterpret_cast<const char*>(begin), (end - begin) * sizeof(T));
+    }
+    else
+    {
+        field->Add(begin, end);
+    }
+}
+
+/** @brief reserve room for count more values in a box message field */
+template <typename T>
+void
+OpenGymBoxFieldReserve(typename OpenGymBoxTraits<T>::Field* field, uint32_t count)
+{
+    if constexpr (std::is_same_v<typename OpenGymBoxTraits<T>::Field, std::string>)
+    {
+        field->reserve(field->size() + count * sizeof(T));
+    }
+    else
+    {
+        field->Reserve(field->size() + count);
+    }
+}
+
+/**
+ * @brief call f with std::type_identity of the value type of a box dtype
+ * @returns false, without calling f, if dtype is not a box dtype
+ */
+template <typename F>
+bool
+OpenGymVisitDtype(ns3penv::Dtype dtype, F&& f)
+{
+    switch (dtype)
+    {
+    case ns3penv::INT:
+        f(std::type_identity<int32_t>());
+        return true;
+    case ns3penv::UINT:
+        f(std::type_identity<uint32_t>());
+        return true;
+    case ns3penv::FLOAT:
+        f(std::type_identity<float>());
+        return true;
+    case ns3penv::DOUBLE:
+        f(std::type_identity<double>());
+        return true;
+    case ns3penv::INT8:
+        f(std::type_identity<int8_t>());
+        return true;
+    case ns3penv::UINT8:
+        f(std::type_identity<uint8_t>());
+        return true;
+    case ns3penv::INT64:
+        f(std::type_identity<int64_t>());
+        return true;
+    case ns3penv::FLOAT16:
+        f(std::type_identity<OpenGymFloat16>());
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief The values of all boxes of a tuple or dict built from its space,
+ * one contiguous buffer per dtype
+ */
+struct OpenGymBoxStorage
+{
+    /** @brief one offset per buffer, indexed by dtype - 1 */
+    typedef std::array<uint32_t, 8> Offsets;
+
+    // in the order of the dtypes
+    std::tuple<std::vector<int32_t>,
+               std::vector<uint32_t>,
+               std::vector<float>,
+               std::vector<double>,
+               std::vector<int8_t>,
+               std::vector<uint8_t>,
+               std::vector<int64_t>,
+               std::vector<OpenGymFloat16>>
+        m_values;
+
+    template <typename T>
+    std::vector<T>& Values()
+    {
+        return std::get<std::vector<T>>(m_values);
+    }
+
+    template <typename T>
+    const std::vector<T>& Values() const
+    {
+        return std::get<std::vector<T>>(m_values);
+    }
+};
+
 /**
  * @brief Represents a container of a one-dimensional array of numbers
  */
@@ -142,11 +385,21 @@ class OpenGymBoxContainer : public OpenGymDataContainer
   public:
     OpenGymBoxContainer();
     OpenGymBoxContainer(std::vector<uint32_t> shape);
+    /**
+     * @brief a box of the given shape already holding all its values, set
+     * to value, so that filling it in place never allocates
+     */
+    OpenGymBoxContainer(std::vector<uint32_t> shape, T value);
     ~OpenGymBoxContainer() override;
 
     static TypeId GetTypeId();
 
-    ns3penv::DataContainer GetDataContainerPbMsg() override;
+    using OpenGymDataContainer::GetDataContainerPbMsg;
+    void GetDataContainerPbMsg(ns3penv::DataContainer* dataMsg) override;
+    bool UpdateFromDataContainerPbMsg(const ns3penv::DataContainer& dataContainer) override;
+
+    uint32_t GetFlatDataSize() const override;
+    void SerializeFlat(Ns3penvFlatStateHeader* header, uint8_t* payload) const override;
 
     void Print(std::ostream& where) const override;
 
@@ -156,13 +409,108 @@ class OpenGymBoxContainer : public OpenGymDataContainer
         return os;
     }
 
+    /**
+     * @brief append a value
+     * @returns false if the box is bound or already holds as many values as
+     * its shape
+     */
     bool AddValue(T value);
     T GetValue(uint32_t idx);
+    /** @brief get the value at a row-major multi-dimensional index, 0 if out of range */
+    T GetValue(const std::vector<uint32_t>& index);
 
-    bool SetData(std::vector<T> data);
-    std::vector<T> GetData();
+    /**
+     * @brief set a single value
+     * @returns false if idx is out of range
+     */
+    bool SetValue(uint32_t idx, T value);
+    /**
+     * @brief set the value at a row-major multi-dimensional index
+     * @returns false if the index does not fit the shape
+     */
+    bool SetValue(const std::vector<uint32_t>& index, T value);
+
+    /*
+     * A box with a shape always holds as many values as the shape, the
+     * SetData overloads fail for any other number. A box without a shape
+     * holds any number of values, sent as one dimension.
+     */
+
+    /** @brief replace the values, copying them */
+    bool SetData(const std::vector<T>& data);
+    /** @brief replace the values, taking over the vector unless the box is bound */
+    bool SetData(std::vector<T>&& data);
+    /** @brief replace the values with a copy of a contiguous range */
+    bool SetData(std::span<const T> data);
+
+    /** @brief get a copy of the values, prefer GetDataView */
+    std::vector<T> GetData() const;
+    /** @brief get the values without copying, valid until the box is resized */
+    std::span<const T> GetDataView() const;
+
+    /**
+     * @brief get the values for writing in place. Changes made through it
+     * are not tracked in delta mode, report them with MarkDirty.
+     */
+    std::vector<T>& MutableData();
+    /**
+     * @brief like MutableData, for bound boxes too, but the number of
+     * values cannot change
+     */
+    std::span<T> MutableView();
+
+    /** @brief reserve room for as many values as the shape holds */
+    void Reserve();
+
+    const std::vector<uint32_t>& GetShape() const;
 
-    std::vector<uint32_t> GetShape();
+    /**
+     * @brief change the shape, keeping the values in row-major order
+     * @returns false if the box is bound and the shape holds another number
+     * of values
+     */
+    bool Reshape(std::vector<uint32_t> shape);
+
+    /** @brief get the row-major strides of the shape, in values */
+    std::vector<uint32_t> GetStrides() const;
+
+    /**
+     * @brief get the values at index i of the first dimension, for instance
+     * one row of a matrix, without copying. Empty if i is out of range.
+     */
+    std::span<const T> GetSlice(uint32_t i) const;
+    /** @brief like GetSlice, for writing in place */
+    std::span<T> MutableSlice(uint32_t i);
+
+    /**
+     * @brief whether the number of values matches the shape. A container
+     * that does not is rejected when it is serialized.
+     */
+    bool MatchesShape() const;
+
+    /**
+     * @brief send only the spans changed since the previous message
+     *
+     * Every message then carries a sequence number, and a delta holds the
+     * offsets, lengths and values of the changed spans only. Changes made
+     * with SetValue and SetData are tracked, changes made otherwise must be
+     * reported with MarkDirty. The same container has to be returned as the
+     * observation every step. Delta mode disables the flat encoding.
+     */
+    void SetDeltaMode(bool deltaMode);
+    bool GetDeltaMode() const;
+
+    /** @brief mark the values in [begin, end) as changed */
+    void MarkDirty(uint32_t begin, uint32_t end);
+
+    void RequestFullResync() override;
+
+    /**
+     * @brief keep the values in length elements of the shared storage,
+     * starting at offset, instead of in the box. The box then has a fixed
+     * size: AddValue fails and SetData only accepts as many values.
+     */
+    void BindStorage(std::shared_ptr<OpenGymBoxStorage> storage, uint32_t offset, uint32_t length);
 
   protected:
     // Inherited
@@ -170,10 +518,45 @@ class OpenGymBoxContainer : public OpenGymDataContainer
     void DoDispose() override;
 
   private:
-    void SetDtype();
+    /** @brief number of values the shape holds, 1 without a shape */
+    uint64_t ShapeLength() const;
+    void CheckShape() const;
+    bool GetFlatIndex(const std::vector<uint32_t>& index, uint32_t& flat) const;
+    /** @brief record the runs of data that differ from the current values */
+    void MarkChanged(const T* data, std::size_t size);
+    template <typename F>
+    void AddSpans(F* field) const;
+    template <typename F>
+    void AddValues(F* field, uint32_t begin, uint32_t end) const;
+
+    /** @brief the values, in the box or in the shared storage */
+    T* Values()
+    {
+        return m_view ? m_view : m_data.data();
+    }
+
+    const T* Values() const
+    {
+        return m_view ? m_view : m_data.data();
+    }
+
+    uint32_t Size() const
+    {
+        return m_view ? m_viewSize : m_data.size();
+    }
+
     std::vector<uint32_t> m_shape;
     ns3penv::Dtype m_dtype;
     std::vector<T> m_data;
+
+    std::shared_ptr<OpenGymBoxStorage> m_storage; // set when bound
+    T* m_view;
+    uint32_t m_viewSize;
+
+    bool m_deltaMode;
+    bool m_needsResync; // next message carries the full data
+    uint64_t m_seq;
+    std::vector<std::pair<uint32_t, uint32_t>> m_dirty; // [begin, end) spans
 };
 
 /** @brief Represents a container of a tuple of data containers */
@@ -181,11 +564,20 @@ class OpenGymTupleContainer : public OpenGymDataContainer
 {
   public:
     OpenGymTupleContainer();
+    /**
+     * @brief build the elements of the space up front, keeping the values
+     * of all its boxes in one buffer per dtype. If they all share a dtype
+     * the tuple can be flat-encoded as the concatenation of its boxes.
+     */
+    OpenGymTupleContainer(Ptr<OpenGymTupleSpace> space);
     ~OpenGymTupleContainer() override;
 
     static TypeId GetTypeId();
 
-    ns3penv::DataContainer GetDataContainerPbMsg() override;
+    using OpenGymDataContainer::GetDataContainerPbMsg;
+    void GetDataContainerPbMsg(ns3penv::DataContainer* dataMsg) override;
+    bool UpdateFromDataContainerPbMsg(const ns3penv::DataContainer& dataContainer) override;
+    void RequestFullResync() override;
 
     void Print(std::ostream& where) const override;
 
@@ -195,8 +587,18 @@ class OpenGymTupleContainer : public OpenGymDataContainer
         return os;
     }
 
+    uint32_t GetFlatDataSize() const override;
+    void SerializeFlat(Ns3penvFlatStateHeader* header, uint8_t* payload) const override;
+
     bool Add(Ptr<OpenGymDataContainer> space);
     Ptr<OpenGymDataContainer> Get(uint32_t idx);
+    /** @brief get the elements, in order */
+    const std::vector<Ptr<OpenGymDataContainer>>& GetElements() const;
+
+    /** @brief add the elements of a tuple space bound to the storage */
+    void AddFromSpaceDescription(const ns3penv::TupleSpace& tupleSpace,
+                                 std::shared_ptr<OpenGymBoxStorage> storage,
+                                 OpenGymBoxStorage::Offsets& offsets);
 
   protected:
     // Inherited
@@ -204,6 +606,8 @@ class OpenGymTupleContainer : public OpenGymDataContainer
     void DoDispose() override;
 
     std::vector<Ptr<OpenGymDataContainer>> m_tuple;
+    std::shared_ptr<OpenGymBoxStorage> m_storage; // set if built from a space
+    ns3penv::Dtype m_flatDtype; // dtype of every value, NoDType if mixed
 };
 
 /** @brief Represents a container of a dictionary of data containers */
@@ -211,11 +615,20 @@ class OpenGymDictContainer : public OpenGymDataContainer
 {
   public:
     OpenGymDictContainer();
+    /**
+     * @brief build the entries of the space up front, see
+     * OpenGymTupleContainer(Ptr<OpenGymTupleSpace>). The entries are laid
+     * out in key order.
+     */
+    OpenGymDictContainer(Ptr<OpenGymDictSpace> space);
     ~OpenGymDictContainer() override;
 
     static TypeId GetTypeId();
 
-    ns3penv::DataContainer GetDataContainerPbMsg() override;
+    using OpenGymDataContainer::GetDataContainerPbMsg;
+    void GetDataContainerPbMsg(ns3penv::DataContainer* dataMsg) override;
+    bool UpdateFromDataContainerPbMsg(const ns3penv::DataContainer& dataContainer) override;
+    void RequestFullResync() override;
 
     void Print(std::ostream& where) const override;
 
@@ -225,8 +638,18 @@ class OpenGymDictContainer : public OpenGymDataContainer
         return os;
     }
 
+    uint32_t GetFlatDataSize() const override;
+    void SerializeFlat(Ns3penvFlatStateHeader* header, uint8_t* payload) const override;
+
     bool Add(std::string key, Ptr<OpenGymDataContainer> value);
     Ptr<OpenGymDataContainer> Get(std::string key);
+    /** @brief get the entries, in key order */
+    const std::map<std::string, Ptr<OpenGymDataContainer>>& GetEntries() const;
+
+    /** @brief add the entries of a dict space bound to the storage */
+    void AddFromSpaceDescription(const ns3penv::DictSpace& dictSpace,
+                                 std::shared_ptr<OpenGymBoxStorage> storage,
+                                 OpenGymBoxStorage::Offsets& offsets);
 
   protected:
     // Inherited
@@ -234,6 +657,8 @@ class OpenGymDictContainer : public OpenGymDataContainer
     void DoDispose() override;
 
     std::map<std::string, Ptr<OpenGymDataContainer>> m_dict;
+    std::shared_ptr<OpenGymBoxStorage> m_storage; // set if built from a space
+    ns3penv::Dtype m_flatDtype; // dtype of every value, NoDType if mixed
 };
 
 } // end of namespace ns3
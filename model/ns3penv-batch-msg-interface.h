@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#ifndef NS3PENV_BATCH_MSG_INTERFACE_H
+#define NS3PENV_BATCH_MSG_INTERFACE_H
+
+#include "ns3penv-msg-interface.h"
+
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief The Python side of a batched segment serving several simulations
+ *
+ * The segment holds one vector of messages per direction with an element
+ * per simulation, the slot array and a shared ready counter. Simulation i
+ * attaches to slot i with Ns3penvMsgInterface::SetBatchSlot and then uses
+ * the usual struct-based interface. This side waits for any number of
+ * states at once instead of blocking on every simulation in turn.
+ */
+template <typename Cpp2PyMsgType, typename Py2CppMsgType>
+class Ns3penvBatchMsgInterfaceImpl {
+public:
+  typedef typename Ns3penvMsgInterfaceImpl<Cpp2PyMsgType,
+                                           Py2CppMsgType>::Cpp2PyMsgAllocator
+      Cpp2PyMsgAllocator;
+  typedef typename Ns3penvMsgInterfaceImpl<Cpp2PyMsgType,
+                                           Py2CppMsgType>::Cpp2PyMsgVector
+      Cpp2PyMsgVector;
+  typedef typename Ns3penvMsgInterfaceImpl<Cpp2PyMsgType,
+                                           Py2CppMsgType>::Py2CppMsgAllocator
+      Py2CppMsgAllocator;
+  typedef typename Ns3penvMsgInterfaceImpl<Cpp2PyMsgType,
+                                           Py2CppMsgType>::Py2CppMsgVector
+      Py2CppMsgVector;
+
+  Ns3penvBatchMsgInterfaceImpl() = delete;
+
+  explicit Ns3penvBatchMsgInterfaceImpl(
+      uint32_t num_slots, uint32_t size = 64 * 1024 * 1024,
+      const char *segment_name = "My Batch Seg",
+      const char *cpp2py_msg_name = "My Cpp to Python Msg",
+      const char *py2cpp_msg_name = "My Python to Cpp Msg",
+      const char *lockable_name = "My Lockable",
+      Ns3penvWaitMode wait_mode = Ns3penvWaitMode::SPIN_FUTEX,
+      uint32_t spin_budget = 4096)
+      : m_segName(segment_name), m_waitMode(wait_mode),
+        m_spinBudget(spin_budget), m_nextSlot(0), m_acquired(0) {
+    using namespace boost::interprocess;
+    if (num_slots == 0) {
+      throw std::invalid_argument("ns3penv: a batched segment needs slots");
+    }
+    shared_memory_object::remove(m_segName.c_str());
+    m_segment = managed_shared_memory(create_only, m_segName.c_str(), size);
+    const Cpp2PyMsgAllocator alloc_env(m_segment.get_segment_manager());
+    const Py2CppMsgAllocator alloc_act(m_segment.get_segment_manager());
+    m_cpp2pyVector =
+        m_segment.construct<Cpp2PyMsgVector>(cpp2py_msg_name)(alloc_env);
+    m_py2cppVector =
+        m_segment.construct<Py2CppMsgVector>(py2cpp_msg_name)(alloc_act);
+    // the vectors never change size again, so slots keep their address
+    m_cpp2pyVector->resize(num_slots);
+    m_py2cppVector->resize(num_slots);
+    m_slots = m_segment.construct<Ns3penvBatchSlot>(
+        Ns3penvBatchSlotsName(lockable_name).c_str())[num_slots]();
+    // constructed last, simulations attach once they can find it
+    m_batch = m_segment.construct<Ns3penvBatchSync>(lockable_name)(num_slots);
+  };
+
+  ~Ns3penvBatchMsgInterfaceImpl() {
+    boost::interprocess::shared_memory_object::remove(m_segName.c_str());
+  };
+
+  /**
+   * Gets the number of simulations the segment serves
+   */
+  uint32_t GetNumSlots() const { return m_batch->m_numSlots; };
+
+  /**
+   * Sets how this side waits for the simulations
+   */
+  void SetWaitMode(Ns3penvWaitMode mode, uint32_t spinBudget) {
+    m_waitMode = mode;
+    m_spinBudget = spinBudget;
+  };
+
+  /**
+   * Get the struct used in C++ to Python transmission of a slot
+   */
+  Cpp2PyMsgType *GetCpp2PyStruct(uint32_t slot) {
+    return &m_cpp2pyVector->at(slot);
+  };
+
+  /**
+   * Get the struct used in Python to C++ transmission of a slot
+   */
+  Py2CppMsgType *GetPy2CppStruct(uint32_t slot) {
+    return &m_py2cppVector->at(slot);
+  };
+
+  /**
+   * See Ns3penvMsgInterfaceImpl::Reserve
+   */
+  template <typename MsgType> bool Reserve(MsgType *msg, uint32_t size) {
+    return Ns3penvReserveMsg(m_segment.get_segment_manager(), msg, size);
+  };
+
+  /**
+   * Gets the number of free bytes left in the segment
+   */
+  std::size_t GetFreeMemory() const { return m_segment.get_free_memory(); };
+
+  /**
+   * Gets the number of states posted and not collected yet. Only a hint,
+   * simulations may post more at any time.
+   */
+  uint32_t PyGetNumReady() const {
+    return m_batch->m_readyCount.m_count.load(std::memory_order_relaxed);
+  };
+
+  /**
+   * Python side waits until count states (at most one per slot) are
+   * posted and starts reading them. Returns the slots, each of which has
+   * to be released with PyRecvEnd. Slots are collected round robin, so
+   * that a fast simulation does not starve the others.
+   *
+   * With a timeout it returns no slots if no further state is posted
+   * within timeout_us microseconds; the states counted so far are kept
+   * for the next call.
+   */
+  std::vector<uint32_t>
+  PyRecvBeginAny(uint32_t count, uint64_t timeout_us = NS3PENV_WAIT_FOREVER) {
+    const uint32_t numSlots = m_batch->m_numSlots;
+    count = std::min(std::max(count, 1U), numSlots);
+    while (m_acquired < count) {
+      if (!Ns3penvSemaphore::sem_wait_for(&m_batch->m_readyCount, m_waitMode,
+                                          m_spinBudget, timeout_us)) {
+        return {};
+      }
+      ++m_acquired;
+    }
+    m_acquired -= count;
+    // every count taken above was posted after its slot flag, so count
+    // flags are visible now, though not necessarily the matching ones
+    std::vector<uint32_t> ready;
+    ready.reserve(count);
+    uint32_t slot = m_nextSlot;
+    while (ready.size() < count) {
+      if (m_slots[slot].m_ready.exchange(0, std::memory_order_acquire) != 0) {
+        Ns3penvSemaphore::sem_wait(&m_slots[slot].m_sync.m_cpp2py.m_fullCount,
+                                   m_waitMode, m_spinBudget);
+        ready.push_back(slot);
+      }
+      slot = (slot + 1) % numSlots;
+    }
+    m_nextSlot = slot;
+    return ready;
+  };
+
+  /**
+   * Python side stops reading the state of a slot
+   */
+  void PyRecvEnd(uint32_t slot) {
+    Ns3penvSemaphore::sem_post(&m_slots[slot].m_sync.m_cpp2py.m_emptyCount);
+  };
+
+  /**
+   * Python side starts writing the answer to a slot
+   */
+  void PySendBegin(uint32_t slot) {
+    PySendBeginFor(slot, NS3PENV_WAIT_FOREVER);
+  };
+
+  /**
+   * Like PySendBegin, but gives up after timeout_us microseconds. Returns
+   * whether writing may start.
+   */
+  bool PySendBeginFor(uint32_t slot, uint64_t timeout_us) {
+    return Ns3penvSemaphore::sem_wait_for(
+        &m_slots[slot].m_sync.m_py2cpp.m_emptyCount, m_waitMode,
+        m_spinBudget, timeout_us);
+  };
+
+  /**
+   * Python side stops writing the answer to a slot
+   */
+  void PySendEnd(uint32_t slot) {
+    Ns3penvSemaphore::sem_post(&m_slots[slot].m_sync.m_py2cpp.m_fullCount);
+  };
+
+  /**
+   * Python side gives up writing the answer to a slot after PySendBegin,
+   * nothing is sent
+   */
+  void PySendCancel(uint32_t slot) {
+    Ns3penvSemaphore::sem_post(&m_slots[slot].m_sync.m_py2cpp.m_emptyCount);
+  };
+
+  /**
+   * Python side gets whether the simulation of a slot is over. Only
+   * meaningful between PyRecvBeginAny and PyRecvEnd.
+   */
+  bool PyGetFinished(uint32_t slot) const {
+    return m_slots[slot].m_sync.m_isFinished.load(std::memory_order_relaxed);
+  };
+
+  void CleanSharedMemory() {
+    boost::interprocess::shared_memory_object::remove(m_segName.c_str());
+  };
+
+private:
+  boost::interprocess::managed_shared_memory m_segment;
+  Cpp2PyMsgVector *m_cpp2pyVector;
+  Py2CppMsgVector *m_py2cppVector;
+  Ns3penvBatchSync *m_batch;
+  Ns3penvBatchSlot *m_slots;
+  std::string m_segName;
+  Ns3penvWaitMode m_waitMode;
+  uint32_t m_spinBudget;
+  uint32_t m_nextSlot;
+  uint32_t m_acquired; //!< counts taken from m_readyCount, not collected
+};
+
+} // namespace ns3
+
+#endif // NS3PENV_BATCH_MSG_INTERFACE_H
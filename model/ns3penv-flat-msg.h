@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#ifndef NS3PENV_FLAT_MSG_H
+#define NS3PENV_FLAT_MSG_H
+
+#include <stdint.h>
+
+// "N3PF" in little endian. 'N' can never start a protobuf message (field 9
+// with the invalid wire type 6), so both encodings can share the buffer.
+#define NS3PENV_FLAT_MAGIC 0x4650334E
+#define NS3PENV_FLAT_VERSION 1
+#define NS3PENV_FLAT_MAX_NDIM 8
+#define NS3PENV_FLAT_ALIGN 64
+
+/**
+ * \brief Fixed header of a flat-encoded environment state
+ *
+ * The header is followed by infoSize bytes of extra info and, at
+ * dataOffset from the start of the buffer (aligned to NS3PENV_FLAT_ALIGN),
+ * by dataSize bytes of raw, row-major observation values of type dtype.
+ */
+struct Ns3penvFlatStateHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t dtype; // ns3penv::Dtype
+  uint32_t ndim;
+  uint32_t shape[NS3PENV_FLAT_MAX_NDIM];
+  float reward;
+  uint8_t isGameOver;
+  uint8_t reason; // ns3penv::EnvStateMsg::Reason
+  uint16_t reserved;
+  uint32_t infoSize;
+  uint32_t dataOffset;
+  uint32_t dataSize;
+};
+
+/**
+ * \brief Offset of the payload following a header and infoSize info bytes
+ */
+inline uint32_t Ns3penvFlatDataOffset(uint32_t infoSize) {
+  uint32_t end = sizeof(Ns3penvFlatStateHeader) + infoSize;
+  return (end + NS3PENV_FLAT_ALIGN - 1) & ~(uint32_t)(NS3PENV_FLAT_ALIGN - 1);
+}
+
+/**
+ * \brief Whether a buffer of size bytes holds a flat-encoded state
+ */
+inline bool Ns3penvIsFlatState(const uint8_t *buffer, uint32_t size) {
+  if (size < sizeof(Ns3penvFlatStateHeader)) {
+    return false;
+  }
+  const Ns3penvFlatStateHeader *header =
+      reinterpret_cast<const Ns3penvFlatStateHeader *>(buffer);
+  return header->magic == NS3PENV_FLAT_MAGIC;
+}
+
+#endif // NS3PENV_FLAT_MSG_H
@@ -25,8 +25,10 @@
 #include "ns3penv-gym-interface.h"
 #include "spaces.h" // implicitily needed for callbacks
 
+#include <ns3/abort.h>
 #include <ns3/log.h>
 #include <ns3/object.h>
+#include <ns3/simulator.h>
 
 namespace ns3
 {
@@ -76,6 +78,17 @@ OpenGymEnv::Notify()
     }
 }
 
+bool
+OpenGymEnv::Stream()
+{
+    NS_LOG_FUNCTION(this);
+    if (m_openGymInterface)
+    {
+        return m_openGymInterface->StreamCurrentState();
+    }
+    return false;
+}
+
 void
 OpenGymEnv::NotifySimulationEnd()
 {
@@ -86,6 +99,46 @@ OpenGymEnv::NotifySimulationEnd()
     }
 }
 
+void
+OpenGymEnv::Checkpoint()
+{
+    NS_LOG_FUNCTION(this);
+    if (m_openGymInterface)
+    {
+        m_openGymInterface->Checkpoint();
+    }
+}
+
+void
+OpenGymEnv::RunEpisodes()
+{
+    NS_LOG_FUNCTION(this);
+    NS_ABORT_MSG_IF(!m_openGymInterface, "Environment has no gym interface");
+    m_openGymInterface->SetWarmReset(true);
+    while (true)
+    {
+        Simulator::Run();
+        if (!m_openGymInterface->IsResetRequested())
+        {
+            // the agent is told, and may still answer with a reset
+            NotifySimulationEnd();
+            if (!m_openGymInterface->IsResetRequested())
+            {
+                return;
+            }
+        }
+        NS_LOG_DEBUG("Starting the next episode");
+        m_openGymInterface->Reinitialize();
+        ResetEpisode();
+    }
+}
+
+void
+OpenGymEnv::ResetEpisode()
+{
+    NS_LOG_FUNCTION(this);
+}
+
 void
 OpenGymEnv::DoInitialize()
 {
@@ -82,18 +82,48 @@ class OpenGymEnv : public Object
      * Sets the lower level gym interface (shared memory)
      * associated to the environment
      */
-    void SetOpenGymInterface(Ptr<OpenGymInterface> openGymInterface);
+    virtual void SetOpenGymInterface(Ptr<OpenGymInterface> openGymInterface);
 
     /**
      * Notify Python side about the states, and execute the actions
      */
     void Notify();
 
+    /**
+     * Stream the current state to Python side through the ring, without
+     * waiting for actions. Returns false if the ring is full or missing.
+     */
+    bool Stream();
+
     /**
      * Notify Python side that the simulation has ended.
      */
     void NotifySimulationEnd();
 
+    /**
+     * Mark the end of the warm-up all episodes share. With fork episodes on
+     * (OpenGymInterface::SetForkEpisodes) the process stays here as a
+     * template, and every episode goes on from this point in a child.
+     */
+    void Checkpoint();
+
+    /**
+     * Run the simulation episode after episode in this process, for as long
+     * as the agent resets by a message instead of restarting ns3, then
+     * notify the end of the simulation. Call it in place of Simulator::Run
+     * once the first episode is scheduled.
+     */
+    void RunEpisodes();
+
+    /**
+     * Rebuild what the next episode needs and schedule its first events.
+     * Called by RunEpisodes after a reset request has stopped the simulator.
+     * Events of the previous episode are still scheduled unless it cancels
+     * them or calls Simulator::Destroy, which also drops the nodes. Does
+     * nothing by default.
+     */
+    virtual void ResetEpisode();
+
   protected:
     // Inherited
     void DoInitialize() override;
@@ -27,44 +27,139 @@
 
 #include "ns3penv-gym-interface.h"
 
+#include "action-decoder.h"
 #include "container.h"
 #include "messages.pb.h"
+#include "ns3penv-flat-msg.h"
 #include "ns3penv-gym-env.h"
 #include "ns3penv-gym-msg.h"
 #include "ns3penv-msg-interface.h"
+#include "ns3penv-transport.h"
+#include "observation-normalizer.h"
+#include "observation-stack.h"
+#include "parallel-encoder.h"
+#include "quantize.h"
 #include "spaces.h"
+#include "trajectory-recorder.h"
 
 #include <ns3/config.h>
 #include <ns3/log.h>
 #include <ns3/simulator.h>
+#include <ns3/trace-source-accessor.h>
+
+#include <google/protobuf/arena.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/wait.h>
+#include <unistd.h>
 
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE("OpenGymInterface");
 NS_OBJECT_ENSURE_REGISTERED(OpenGymInterface);
 
+/**
+ * 64-bit FNV-1a, stable across processes and builds
+ */
+static uint64_t HashBytes(const std::string &bytes) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (unsigned char byte : bytes) {
+    hash = (hash ^ byte) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/**
+ * Wall-clock nanoseconds, for timing the phases of a step
+ */
+static uint64_t SteadyNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * Grows the C++ to Python message to hold size bytes. Must be called
+ * between CppSendBegin and CppSendEnd.
+ */
+static Ns3penvGymMsg *ReserveCpp2PyMsg(Ns3penvTransport *msgInterface,
+                                      size_t size) {
+  Ns3penvGymMsg *msg = msgInterface->GetCpp2PyStruct();
+  NS_ABORT_MSG_IF(size > UINT32_MAX,
+                  "Message of " << size << " bytes is too large");
+  NS_ABORT_MSG_IF(!msgInterface->Reserve(msg, size),
+                  "Shared memory segment has "
+                      << msgInterface->GetFreeMemory()
+                      << " bytes left, which is not enough for a message of "
+                      << size << " bytes. Increase shmSize on the Python side");
+  return msg;
+}
+
 Ptr<OpenGymInterface> OpenGymInterface::Get() {
   NS_LOG_FUNCTION_NOARGS();
-  return *DoGet();
+  return Get(0);
 }
 
-OpenGymInterface::OpenGymInterface(uint envId)
-    : m_simEnd(false), m_stopEnvRequested(false), m_initSimMsgSent(false),
-      m_envId(envId) {
-  auto interface = Ns3penvMsgInterface::Get();
-  interface->SetNames(
-      "seg" + std::to_string(m_envId), "cpp2py" + std::to_string(m_envId),
-      "py2cpp" + std::to_string(m_envId), "lockable" + std::to_string(m_envId));
-  interface->SetIsMemoryCreator(false);
-  interface->SetUseVector(false);
-  interface->SetHandleFinish(false);
+Ptr<OpenGymInterface> OpenGymInterface::Get(uint envId) {
+  NS_LOG_FUNCTION(envId);
+  std::map<uint, Ptr<OpenGymInterface>> *interfaces = DoGet();
+  auto it = interfaces->find(envId);
+  if (it == interfaces->end()) {
+    it = interfaces->emplace(envId, CreateObject<OpenGymInterface>(envId))
+             .first;
+  }
+  return it->second;
 }
 
+OpenGymInterface::OpenGymInterface(uint envId)
+    : m_simEnd(false), m_stopEnvRequested(false), m_peerLost(false),
+      m_resetRequested(false),
+      m_warmReset(false), m_forkEpisodes(false), m_forkEpisode(0),
+      m_initSimMsgSent(false),
+      m_useFlatObs(false), m_resyncRequested(false), m_repeatAction(true),
+      m_asyncActions(false), m_actionPending(false), m_actionExpired(false),
+      m_recordStats(false), m_clipActions(false), m_unclippedLogged(false),
+      m_guardObservation(false),
+      m_guardReplacement(0), m_halfNormalized(false), m_normalizerClip(10),
+      m_envId(envId), m_spaceHash(0), m_decisionInterval(1),
+      m_pendingSteps(0), m_pendingReward(0), m_rewardReduction(REWARD_SUM),
+      m_obsStackDepth(1), m_encoderThreads(0), m_encoderThreshold(0),
+      m_stateSize(0), m_stats(nullptr), m_phaseStart(0),
+      m_peerTimeoutUs(NS3PENV_WAIT_FOREVER), m_peerTimeoutSet(false),
+      m_trajectoryChunkSteps(1024) {}
+
 OpenGymInterface::~OpenGymInterface() {}
 
 TypeId OpenGymInterface::GetTypeId() {
   static TypeId tid =
-      TypeId("OpenGymInterface").SetParent<Object>().SetGroupName("OpenGym");
+      TypeId("OpenGymInterface")
+          .SetParent<Object>()
+          .SetGroupName("OpenGym")
+          .AddTraceSource(
+              "StepPhase",
+              "Wall-clock nanoseconds a phase of a step took, when step "
+              "statistics are recorded",
+              MakeTraceSourceAccessor(&OpenGymInterface::m_phaseTrace),
+              "ns3::OpenGymInterface::StepPhaseTracedCallback")
+          .AddTraceSource(
+              "MessageSize",
+              "Bytes of a state sent or an action received, when step "
+              "statistics are recorded",
+              MakeTraceSourceAccessor(&OpenGymInterface::m_sizeTrace),
+              "ns3::OpenGymInterface::MessageSizeTracedCallback")
+          .AddTraceSource(
+              "OutOfRange",
+              "Number of action values clipped or observation values "
+              "replaced in a step, when there are any",
+              MakeTraceSourceAccessor(&OpenGymInterface::m_outOfRangeTrace),
+              "ns3::OpenGymInterface::OutOfRangeTracedCallback");
   return tid;
 }
 
@@ -75,37 +170,57 @@ void OpenGymInterface::Init() {
   }
   m_initSimMsgSent = true;
 
-  Ptr<OpenGymSpace> obsSpace = GetObservationSpace();
-  Ptr<OpenGymSpace> actionSpace = GetActionSpace();
-
-  ns3penv::SimInitMsg simInitMsg;
-  if (obsSpace) {
-    ns3penv::SpaceDescription spaceDesc;
-    spaceDesc = obsSpace->GetSpaceDescription();
-    simInitMsg.mutable_obsspace()->CopyFrom(spaceDesc);
+  // the spaces are asked for once, later inits replay the same bytes
+  if (m_simInitMsg.empty()) {
+    BuildSimInitMsg();
   }
-  if (actionSpace) {
-    ns3penv::SpaceDescription spaceDesc;
-    spaceDesc = actionSpace->GetSpaceDescription();
-    simInitMsg.mutable_actspace()->CopyFrom(spaceDesc);
+
+  if (m_recordStats) {
+    AttachStats();
   }
+  ExchangeSimInitMsg(false);
+}
 
+void OpenGymInterface::ExchangeSimInitMsg(bool forkTemplate) {
   // get the interface
-  Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg> *msgInterface =
-      Ns3penvMsgInterface::Get()->GetInterface<Ns3penvGymMsg, Ns3penvGymMsg>();
-
-  // send init msg to python
-  msgInterface->CppSendBegin();
-  msgInterface->GetCpp2PyStruct()->size = simInitMsg.ByteSizeLong();
-  assert(msgInterface->GetCpp2PyStruct()->size <= MSG_BUFFER_SIZE);
-  simInitMsg.SerializeToArray(msgInterface->GetCpp2PyStruct()->buffer,
-                              msgInterface->GetCpp2PyStruct()->size);
+  Ns3penvTransport *msgInterface = GetTransport();
+
+  // python records the hash of the spaces it has in the segment, which
+  // outlives this process, so a rerun of the same scenario skips them
+  std::string init = msgInterface->GetSpaceHash() == m_spaceHash
+                         ? m_cachedSimInitMsg
+                         : m_simInitMsg;
+  if (m_normalizer) {
+    // the statistics change with every step, so they are appended fresh,
+    // which protobuf merges into the cached message
+    ns3penv::SimInitMsg statsMsg;
+    *statsMsg.mutable_obsnormalizer() = m_normalizer->GetStatistics();
+    statsMsg.AppendToString(&init);
+  }
+  if (forkTemplate) {
+    ns3penv::SimInitMsg templateMsg;
+    templateMsg.set_forktemplate(true);
+    templateMsg.AppendToString(&init);
+  }
+
+  // send init msg to python, sizing the state buffer for the largest
+  // observation up front, so that it only has to grow for unusually long
+  // extra info
+  if (!BeginExchange(true, m_peerTimeoutUs)) {
+    return;
+  }
+  Ns3penvGymMsg *initMsg =
+      ReserveCpp2PyMsg(msgInterface, std::max(init.size(), m_stateSize));
+  initMsg->size = init.size();
+  std::memcpy(initMsg->buffer.get(), init.data(), init.size());
   msgInterface->CppSendEnd();
 
   // receive init ack msg from python
   ns3penv::SimInitAck simInitAck;
-  msgInterface->CppRecvBegin();
-  simInitAck.ParseFromArray(msgInterface->GetPy2CppStruct()->buffer,
+  if (!BeginExchange(false, m_peerTimeoutUs)) {
+    return;
+  }
+  simInitAck.ParseFromArray(msgInterface->GetPy2CppStruct()->buffer.get(),
                             msgInterface->GetPy2CppStruct()->size);
   msgInterface->CppRecvEnd();
 
@@ -115,88 +230,933 @@ void OpenGymInterface::Init() {
   if (stopSim) {
     NS_LOG_DEBUG("---Stop requested: " << stopSim);
     m_stopEnvRequested = true;
+    if (m_recorder) {
+      m_recorder->Close();
+    }
     Simulator::Stop();
     Simulator::Destroy();
     std::exit(0);
   }
 }
 
+void OpenGymInterface::BuildSimInitMsg() {
+  Ptr<OpenGymSpace> obsSpace = GetObservationSpace();
+  Ptr<OpenGymSpace> actionSpace = GetActionSpace();
+
+  if (obsSpace && m_normalizer) {
+    NS_ABORT_MSG_IF(
+        !m_normalizer->Configure(obsSpace, m_halfNormalized, m_normalizerClip),
+        "Only Box observations can be normalized");
+    obsSpace = m_normalizer->GetNormalizedSpace();
+  }
+
+  m_obsStack = nullptr;
+  if (obsSpace && m_obsStackDepth > 1) {
+    m_obsStack = CreateObject<OpenGymObservationStack>();
+    NS_ABORT_MSG_IF(!m_obsStack->Configure(obsSpace, m_obsStackDepth),
+                    "Only Box observations can be stacked");
+    obsSpace = m_obsStack->GetStackedSpace();
+  }
+
+  ns3penv::SimInitMsg simInitMsg;
+  if (obsSpace) {
+    *simInitMsg.mutable_obsspace() = obsSpace->GetCachedSpaceDescription();
+    m_stateSize =
+        size_t(Ns3penvFlatDataOffset(0)) + obsSpace->GetMaxDataSize();
+  }
+  if (actionSpace) {
+    *simInitMsg.mutable_actspace() = actionSpace->GetCachedSpaceDescription();
+    // the action space is fixed from now on, plan the decoding once
+    m_actionDecoder = CreateObject<OpenGymActionDecoder>();
+    if (!m_actionDecoder->Compile(simInitMsg.actspace())) {
+      NS_LOG_WARN("Action space cannot be compiled, decoding generically");
+      m_actionDecoder = nullptr;
+    }
+  }
+  simInitMsg.MergeFromString(m_structLayouts);
+  m_recorder = nullptr;
+  if (!m_trajectoryPath.empty()) {
+    m_recorder = CreateObject<OpenGymTrajectoryRecorder>();
+    m_recorder->SetStructLayouts(simInitMsg.obsstruct(), simInitMsg.actstruct());
+    NS_ABORT_MSG_IF(!m_recorder->Configure(simInitMsg.obsspace(),
+                                           simInitMsg.actspace(),
+                                           m_trajectoryChunkSteps),
+                    "The spaces cannot be recorded");
+  }
+  // only the spaces are hashed, 0 is left for python knowing none
+  m_spaceHash = HashBytes(simInitMsg.SerializeAsString());
+  if (m_spaceHash == 0) {
+    m_spaceHash = 1;
+  }
+
+  simInitMsg.set_flatobs(m_useFlatObs);
+  simInitMsg.set_spacehash(m_spaceHash);
+  simInitMsg.set_warmreset(m_warmReset);
+  m_simInitMsg = simInitMsg.SerializeAsString();
+
+  ns3penv::SimInitMsg cachedMsg;
+  cachedMsg.set_flatobs(m_useFlatObs);
+  cachedMsg.set_warmreset(m_warmReset);
+  cachedMsg.set_spacehash(m_spaceHash);
+  cachedMsg.set_spacescached(true);
+  m_cachedSimInitMsg = cachedMsg.SerializeAsString();
+}
+
 void OpenGymInterface::NotifyCurrentState() {
   if (!m_initSimMsgSent) {
     Init();
   }
-  if (m_stopEnvRequested) {
+  if (m_stopEnvRequested || m_resetRequested) {
     return;
   }
-  // collect current env state
-  Ptr<OpenGymDataContainer> obsDataContainer = GetObservation();
-  float reward = GetReward();
-  bool isGameOver = IsGameOver();
-  std::string extraInfo = GetExtraInfo();
-  ns3penv::EnvStateMsg envStateMsg;
-  // observation
-  ns3penv::DataContainer obsDataContainerPbMsg;
-  if (obsDataContainer) {
-    obsDataContainerPbMsg = obsDataContainer->GetDataContainerPbMsg();
-    envStateMsg.mutable_obsdata()->CopyFrom(obsDataContainerPbMsg);
-  }
-  // reward
-  envStateMsg.set_reward(reward);
-  // game over
-  envStateMsg.set_isgameover(false);
-  if (isGameOver) {
-    envStateMsg.set_isgameover(true);
-    if (m_simEnd) {
-      envStateMsg.set_reason(ns3penv::EnvStateMsg::SimulationEnd);
-    } else {
-      envStateMsg.set_reason(ns3penv::EnvStateMsg::GameOver);
+  PollActions();
+  StartPhase();
+  float reward;
+  bool isGameOver;
+  Ptr<OpenGymDataContainer> obsDataContainer;
+  if (m_decisionInterval > 1) {
+    // the observation is only collected when the agent decides, which the
+    // end of the simulation always makes it do
+    float stepReward = GetReward();
+    isGameOver = IsGameOver();
+    ++m_pendingSteps;
+    m_pendingReward = m_rewardReduction == REWARD_LAST
+                          ? stepReward
+                          : m_pendingReward + stepReward;
+    if (m_pendingSteps < m_decisionInterval && !isGameOver && m_lastAction) {
+      if (m_repeatAction) {
+        ExecuteActions(m_lastAction);
+      }
+      return;
+    }
+    reward = m_rewardReduction == REWARD_MEAN ? m_pendingReward / m_pendingSteps
+                                              : m_pendingReward;
+    m_pendingSteps = 0;
+    m_pendingReward = 0;
+    WaitForActions();
+    if (m_stopEnvRequested) {
+      // the agent was lost while this step waited for its last reply
+      return;
     }
+    obsDataContainer = GetObservation();
+  } else {
+    WaitForActions();
+    if (m_stopEnvRequested) {
+      return;
+    }
+    obsDataContainer = GetObservation();
+    reward = GetReward();
+    isGameOver = IsGameOver();
+  }
+  obsDataContainer = PrepareObservation(obsDataContainer);
+  if (m_resyncRequested && obsDataContainer) {
+    // python lost track of the delta-mode boxes
+    obsDataContainer->RequestFullResync();
+  }
+  m_resyncRequested = false;
+  std::string extraInfo = GetExtraInfo();
+  RecordPhase(NS3PENV_PHASE_OBSERVE);
+  bool flat = m_useFlatObs && obsDataContainer &&
+              obsDataContainer->GetFlatDataSize() > 0;
+  ns3penv::EnvStateMsg *envStateMsg = nullptr;
+  if (!flat) {
+    envStateMsg = NewEnvStateMsg();
+    BuildEnvStateMsg(*envStateMsg, obsDataContainer, reward, isGameOver,
+                     extraInfo);
+    RecordPhase(NS3PENV_PHASE_BUILD);
   }
-  // extra info
-  envStateMsg.set_info(extraInfo);
 
   // get the interface
-  Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg> *msgInterface =
-      Ns3penvMsgInterface::Get()->GetInterface<Ns3penvGymMsg, Ns3penvGymMsg>();
+  Ns3penvTransport *msgInterface = GetTransport();
 
   // send env state msg to python
-  msgInterface->CppSendBegin();
-  msgInterface->GetCpp2PyStruct()->size = envStateMsg.ByteSizeLong();
-  assert(msgInterface->GetCpp2PyStruct()->size <= MSG_BUFFER_SIZE);
-  envStateMsg.SerializeToArray(msgInterface->GetCpp2PyStruct()->buffer,
-                               msgInterface->GetCpp2PyStruct()->size);
+  if (!BeginExchange(true, m_peerTimeoutUs)) {
+    return;
+  }
+  RecordPhase(NS3PENV_PHASE_WAIT_EMPTY);
+  if (flat) {
+    // the box writes its data straight into the shared buffer
+    size_t size = size_t(Ns3penvFlatDataOffset(extraInfo.size())) +
+                  obsDataContainer->GetFlatDataSize();
+    WriteFlatEnvState(ReserveCpp2PyMsg(msgInterface, size), obsDataContainer,
+                      reward, isGameOver, extraInfo);
+  } else {
+    size_t size = m_encoder ? m_encoder->ByteSize(envStateMsg)
+                            : envStateMsg->ByteSizeLong();
+    Ns3penvGymMsg *stateMsg = ReserveCpp2PyMsg(msgInterface, size);
+    stateMsg->size = size;
+    if (m_encoder) {
+      m_encoder->Serialize(envStateMsg, stateMsg->buffer.get());
+    } else {
+      envStateMsg->SerializeToArray(stateMsg->buffer.get(), stateMsg->size);
+    }
+  }
+  RecordPhase(NS3PENV_PHASE_SERIALIZE);
+  RecordSize(true, msgInterface->GetCpp2PyStruct()->size);
 
   msgInterface->CppSendEnd();
 
-  // receive act msg from python
-  ns3penv::EnvActMsg envActMsg;
-  msgInterface->CppRecvBegin();
+  if (m_recorder) {
+    if (!m_recorder->IsOpen()) {
+      // a fork child records its episode apart
+      m_recorder->Open(m_forkEpisode > 0 ? m_trajectoryPath + "-" +
+                                               std::to_string(m_forkEpisode)
+                                         : m_trajectoryPath);
+    }
+    m_recorder->RecordState(obsDataContainer, reward, isGameOver && !m_simEnd,
+                            isGameOver && m_simEnd);
+  }
+
+  if (isGameOver) {
+    // the next episode starts from its own first observation and decision
+    m_lastAction = nullptr;
+    if (m_obsStack) {
+      m_obsStack->Clear();
+    }
+  }
+
+  if (m_asyncActions && !m_simEnd) {
+    // let the simulation run while the agent decides
+    m_actionPending = true;
+    m_actionExpired = false;
+    if (m_actionDeadline.IsStrictlyPositive()) {
+      m_deadlineEvent = Simulator::Schedule(
+          m_actionDeadline, &OpenGymInterface::ExpireActions, this);
+    }
+    return;
+  }
+
+  if (!BeginExchange(false, m_peerTimeoutUs)) {
+    return;
+  }
+  RecordPhase(NS3PENV_PHASE_WAIT_ACTION);
+  ReceiveActions();
+}
 
-  envActMsg.ParseFromArray(msgInterface->GetPy2CppStruct()->buffer,
+void OpenGymInterface::ReceiveActions() {
+  // between CppRecvBegin and CppRecvEnd
+  Ns3penvTransport *msgInterface = GetTransport();
+  // receive act msg from python, reusing the message and its fields
+  if (!m_envActMsg) {
+    m_envActMsg = std::make_unique<ns3penv::EnvActMsg>();
+  }
+  ns3penv::EnvActMsg &envActMsg = *m_envActMsg;
+  envActMsg.ParseFromArray(msgInterface->GetPy2CppStruct()->buffer.get(),
                            msgInterface->GetPy2CppStruct()->size);
+  RecordSize(false, msgInterface->GetPy2CppStruct()->size);
   msgInterface->CppRecvEnd();
+  RecordPhase(NS3PENV_PHASE_PARSE);
+
+  bool expired = m_actionExpired;
+  m_actionPending = false;
+  m_actionExpired = false;
+  m_deadlineEvent.Cancel();
+
+  if (envActMsg.resetreq()) {
+    // the episode ends here, the simulation returns to RunEpisodes
+    NS_LOG_DEBUG("---Reset requested");
+    m_resetRequested = true;
+    if (m_recorder) {
+      m_recorder->Truncate();
+    }
+    if (!m_simEnd) {
+      Simulator::Stop();
+    }
+    return;
+  }
 
   if (m_simEnd) {
     // if sim end only rx msg and quit
     return;
   }
 
+  m_resyncRequested = envActMsg.resyncreq();
   bool stopSim = envActMsg.stopsimreq();
   if (stopSim) {
     NS_LOG_DEBUG("---Stop requested: " << stopSim);
     m_stopEnvRequested = true;
+    if (m_recorder) {
+      m_recorder->Close();
+    }
     Simulator::Stop();
     Simulator::Destroy();
     std::exit(0);
   }
 
+  if (expired) {
+    // the fallback took its place at the deadline
+    NS_LOG_DEBUG("Dropping action received after its deadline");
+    return;
+  }
+
+  if (m_structAction && !envActMsg.actstruct().empty()) {
+    // the struct of a typed env, copied as it is
+    const std::string &act = envActMsg.actstruct();
+    if (m_structAction->DeserializeFlat(
+            reinterpret_cast<const uint8_t *>(act.data()), act.size())) {
+      m_lastAction = m_structAction;
+      RecordPhase(NS3PENV_PHASE_DECODE);
+      if (m_recorder) {
+        m_recorder->RecordAction(m_lastAction);
+      }
+      ExecuteActions(m_lastAction);
+      RecordPhase(NS3PENV_PHASE_EXECUTE);
+      return;
+    }
+    NS_LOG_WARN("Action struct of " << act.size() << " bytes does not match");
+    return;
+  }
+
   // first step after reset is called without actions, just to get current state
-  ns3penv::DataContainer actDataContainerPbMsg = envActMsg.actdata();
-  Ptr<OpenGymDataContainer> actDataContainer =
-      OpenGymDataContainer::CreateFromDataContainerPbMsg(actDataContainerPbMsg);
-  ExecuteActions(actDataContainer);
+  const ns3penv::DataContainer &actData = envActMsg.actdata();
+  if (m_actionDecoder && m_actionDecoder->Decode(actData)) {
+    if (m_clipActions) {
+      RecordOutOfRange(true, m_actionDecoder->Clip());
+    }
+    m_lastAction = m_actionDecoder->GetContainer();
+    RecordPhase(NS3PENV_PHASE_DECODE);
+    if (m_recorder) {
+      m_recorder->RecordAction(m_lastAction);
+    }
+    ExecuteActions(m_lastAction);
+    RecordPhase(NS3PENV_PHASE_EXECUTE);
+    return;
+  }
+  // actions that do not follow the declared space are decoded generically,
+  // the action containers are still filled in place step after step
+  NS_LOG_DEBUG("Action does not match the action space");
+  if (m_clipActions && !m_unclippedLogged) {
+    NS_LOG_WARN("Actions that do not match the action space are not clipped");
+    m_unclippedLogged = true;
+  }
+  m_actDataContainer =
+      OpenGymDataContainer::UpdateOrCreateFromDataContainerPbMsg(
+          m_actDataContainer, actData);
+  m_lastAction = m_actDataContainer;
+  RecordPhase(NS3PENV_PHASE_DECODE);
+  if (m_recorder) {
+    m_recorder->RecordAction(m_lastAction);
+  }
+  ExecuteActions(m_lastAction);
+  RecordPhase(NS3PENV_PHASE_EXECUTE);
 }
 
+bool OpenGymInterface::PollActions() {
+  if (!m_actionPending || m_stopEnvRequested) {
+    return false;
+  }
+  Ns3penvTransport *msgInterface = GetTransport();
+  if (!msgInterface->CppTryRecvBegin()) {
+    return false;
+  }
+  StartPhase();
+  ReceiveActions();
+  return true;
+}
+
+void OpenGymInterface::WaitForActions() {
+  if (!m_actionPending) {
+    return;
+  }
+  // the next state must not overtake the reply to the previous one
+  StartPhase();
+  if (!BeginExchange(false, m_peerTimeoutUs)) {
+    return;
+  }
+  RecordPhase(NS3PENV_PHASE_WAIT_ACTION);
+  ReceiveActions();
+}
+
+void OpenGymInterface::ExpireActions() {
+  NS_LOG_FUNCTION(this);
+  if (m_stopEnvRequested || PollActions() || !m_actionPending) {
+    return;
+  }
+  m_actionExpired = true;
+  if (m_fallbackAction) {
+    NS_LOG_DEBUG("No action by the deadline, executing the fallback");
+    m_lastAction = m_fallbackAction;
+    if (m_recorder) {
+      m_recorder->RecordAction(m_lastAction);
+    }
+    ExecuteActions(m_lastAction);
+  }
+}
+
+bool OpenGymInterface::StreamCurrentState() {
+  if (!m_initSimMsgSent) {
+    Init();
+  }
+  if (m_stopEnvRequested || m_resetRequested) {
+    return false;
+  }
+
+  Ns3penvTransport *msgInterface = GetTransport();
+  if (!msgInterface->HasRing()) {
+    NS_LOG_WARN("Streaming requested but the segment has no ring");
+    return false;
+  }
+
+  Ptr<OpenGymDataContainer> obsDataContainer = GetObservation();
+  // a streamed state leaves what the next decision sends as it is
+  obsDataContainer = PrepareObservation(obsDataContainer, false);
+  if (obsDataContainer) {
+    // python keeps the delta bases of each channel apart, while a box has
+    // one sequence: a streamed state is sent in full, and so is the state
+    // after it
+    obsDataContainer->RequestFullResync();
+  }
+  ns3penv::EnvStateMsg *envStateMsg = NewEnvStateMsg();
+  BuildEnvStateMsg(*envStateMsg, obsDataContainer, GetReward(), IsGameOver(),
+                   GetExtraInfo());
+  if (obsDataContainer) {
+    obsDataContainer->RequestFullResync();
+  }
+
+  // push the state without waiting for an action
+  if (m_encoder) {
+    m_streamBuffer.resize(m_encoder->ByteSize(envStateMsg));
+    m_encoder->Serialize(envStateMsg, m_streamBuffer.data());
+  } else {
+    m_streamBuffer.resize(envStateMsg->ByteSizeLong());
+    envStateMsg->SerializeToArray(m_streamBuffer.data(), m_streamBuffer.size());
+  }
+  bool sent =
+      msgInterface->CppTrySend(m_streamBuffer.data(), m_streamBuffer.size());
+  if (!sent) {
+    NS_LOG_DEBUG("Ring full, dropping streamed state");
+  }
+  return sent;
+}
+
+ns3penv::EnvStateMsg *OpenGymInterface::NewEnvStateMsg() {
+  // the state of the previous step is no longer needed. Reset frees every
+  // block but the initial one, so that one grows until a whole step fits
+  // in it and the steps after that do not allocate
+  uint64_t used = m_arena ? m_arena->Reset() : 0;
+  if (!m_arena || used > m_arenaBlock.size()) {
+    m_arena.reset();
+    m_arenaBlock.resize(std::max<uint64_t>(std::bit_ceil(used), 4096));
+    google::protobuf::ArenaOptions options;
+    options.initial_block = m_arenaBlock.data();
+    options.initial_block_size = m_arenaBlock.size();
+    m_arena = std::make_unique<google::protobuf::Arena>(options);
+  }
+  return google::protobuf::Arena::CreateMessage<ns3penv::EnvStateMsg>(
+      m_arena.get());
+}
+
+void OpenGymInterface::BuildEnvStateMsg(
+    ns3penv::EnvStateMsg &envStateMsg,
+    Ptr<OpenGymDataContainer> obsDataContainer, float reward, bool isGameOver,
+    const std::string &extraInfo) {
+  // observation, written straight into the state message
+  if (obsDataContainer &&
+      !(m_encoder &&
+        m_encoder->Fill(obsDataContainer, envStateMsg.mutable_obsdata()))) {
+    obsDataContainer->GetDataContainerPbMsg(envStateMsg.mutable_obsdata());
+  }
+  // reward
+  envStateMsg.set_reward(reward);
+  // game over
+  envStateMsg.set_isgameover(false);
+  if (isGameOver) {
+    envStateMsg.set_isgameover(true);
+    if (m_simEnd) {
+      envStateMsg.set_reason(ns3penv::EnvStateMsg::SimulationEnd);
+    } else {
+      envStateMsg.set_reason(ns3penv::EnvStateMsg::GameOver);
+    }
+  }
+  // extra info
+  envStateMsg.set_info(extraInfo);
+}
+
+void OpenGymInterface::WriteFlatEnvState(
+    Ns3penvGymMsg *msg, Ptr<OpenGymDataContainer> obsDataContainer,
+    float reward, bool isGameOver, const std::string &extraInfo) {
+  uint32_t dataOffset = Ns3penvFlatDataOffset(extraInfo.size());
+  uint32_t dataSize = obsDataContainer->GetFlatDataSize();
+  NS_ABORT_MSG_IF(uint64_t(dataOffset) + dataSize > msg->capacity,
+                  "Flat observation of " << dataSize
+                                         << " bytes does not fit the buffer");
+
+  uint8_t *buffer = msg->buffer.get();
+  Ns3penvFlatStateHeader *header =
+      reinterpret_cast<Ns3penvFlatStateHeader *>(buffer);
+  header->magic = NS3PENV_FLAT_MAGIC;
+  header->version = NS3PENV_FLAT_VERSION;
+  header->reward = reward;
+  header->isGameOver = isGameOver;
+  header->reason = m_simEnd ? ns3penv::EnvStateMsg::SimulationEnd
+                            : ns3penv::EnvStateMsg::GameOver;
+  header->reserved = 0;
+  header->infoSize = extraInfo.size();
+  header->dataOffset = dataOffset;
+  std::memcpy(buffer + sizeof(Ns3penvFlatStateHeader), extraInfo.data(),
+              extraInfo.size());
+  // fills dtype, shape and dataSize
+  obsDataContainer->SerializeFlat(header, buffer + dataOffset);
+  msg->size = dataOffset + header->dataSize;
+}
+
+void OpenGymInterface::SetUseFlatObservation(bool useFlatObs) {
+  m_useFlatObs = useFlatObs;
+  // the flag is part of the cached init message
+  m_simInitMsg.clear();
+}
+
+void OpenGymInterface::SetAsyncActions(bool asyncActions) {
+  m_asyncActions = asyncActions;
+}
+
+void OpenGymInterface::SetActionDeadline(
+    Time deadline, Ptr<OpenGymDataContainer> fallbackAction) {
+  m_actionDeadline = deadline;
+  m_fallbackAction = fallbackAction;
+}
+
+void OpenGymInterface::SetRecordStepStats(bool recordStats) {
+  m_recordStats = recordStats;
+  if (m_recordStats && m_initSimMsgSent) {
+    AttachStats();
+  }
+}
+
+void OpenGymInterface::SetParallelEncoding(uint32_t threads,
+                                           uint32_t threshold) {
+  m_encoderThreads = threads;
+  m_encoderThreshold = threshold;
+  if (m_encoder) {
+    m_encoder->Dispose();
+    m_encoder = nullptr;
+  }
+  if (threads > 0) {
+    m_encoder = CreateObject<OpenGymParallelEncoder>();
+    m_encoder->Start(threads, threshold);
+  }
+}
+
+void OpenGymInterface::AttachStats() {
+  if (m_stats) {
+    return;
+  }
+  m_stats = GetTransport()->GetStats(true);
+  if (!m_stats) {
+    NS_LOG_WARN("No room for the step statistics in the segment, or no "
+                "segment with this transport");
+    m_recordStats = false;
+  }
+}
+
+void OpenGymInterface::StartPhase() {
+  if (m_recordStats) {
+    m_phaseStart = SteadyNanoseconds();
+  }
+}
+
+void OpenGymInterface::RecordPhase(Ns3penvStepPhase phase) {
+  if (!m_recordStats || !m_stats) {
+    return;
+  }
+  uint64_t now = SteadyNanoseconds();
+  uint64_t duration = now - m_phaseStart;
+  m_phaseStart = now;
+  Ns3penvHistogram::record(&m_stats->m_phases[phase], duration);
+  m_phaseTrace(phase, duration);
+}
+
+void OpenGymInterface::RecordSize(bool sent, uint32_t size) {
+  if (!m_recordStats || !m_stats) {
+    return;
+  }
+  Ns3penvHistogram::record(sent ? &m_stats->m_stateSize
+                                : &m_stats->m_actionSize,
+                           size);
+  m_sizeTrace(sent, size);
+}
+
+void OpenGymInterface::SetClipActions(bool clipActions) {
+  m_clipActions = clipActions;
+}
+
+void OpenGymInterface::SetObservationGuard(bool guard, float replacement) {
+  m_guardObservation = guard;
+  m_guardReplacement = replacement;
+}
+
+/**
+ * Replaces the non-finite values of the float boxes of data, returns how
+ * many there were
+ */
+static uint32_t ReplaceNonFinite(OpenGymDataContainer *data,
+                                 float replacement) {
+  if (auto *box = dynamic_cast<OpenGymBoxContainer<float> *>(data)) {
+    return OpenGymReplaceNonFinite(box->MutableView(), replacement);
+  }
+  if (auto *box = dynamic_cast<OpenGymBoxContainer<double> *>(data)) {
+    return OpenGymReplaceNonFinite(box->MutableView(), replacement);
+  }
+  if (auto *box = dynamic_cast<OpenGymBoxContainer<OpenGymFloat16> *>(data)) {
+    return OpenGymReplaceNonFinite(box->MutableView(), replacement);
+  }
+  uint32_t replaced = 0;
+  if (auto *tuple = dynamic_cast<OpenGymTupleContainer *>(data)) {
+    for (const auto &element : tuple->GetElements()) {
+      replaced += ReplaceNonFinite(PeekPointer(element), replacement);
+    }
+  } else if (auto *dict = dynamic_cast<OpenGymDictContainer *>(data)) {
+    for (const auto &[name, entry] : dict->GetEntries()) {
+      replaced += ReplaceNonFinite(PeekPointer(entry), replacement);
+    }
+  }
+  return replaced;
+}
+
+void OpenGymInterface::GuardObservation(
+    Ptr<OpenGymDataContainer> obsDataContainer) {
+  if (!m_guardObservation || !obsDataContainer) {
+    return;
+  }
+  // a replaced value was written since the last step, so a delta box
+  // already sends it
+  RecordOutOfRange(false, ReplaceNonFinite(PeekPointer(obsDataContainer),
+                                           m_guardReplacement));
+}
+
+Ptr<OpenGymDataContainer> OpenGymInterface::PrepareObservation(
+    Ptr<OpenGymDataContainer> obsDataContainer, bool decision) {
+  GuardObservation(obsDataContainer);
+  if (!obsDataContainer) {
+    return obsDataContainer;
+  }
+  if (m_normalizer) {
+    obsDataContainer = m_normalizer->Normalize(obsDataContainer, decision);
+  }
+  if (m_obsStack) {
+    obsDataContainer = m_obsStack->Push(obsDataContainer, decision);
+  }
+  return obsDataContainer;
+}
+
+void OpenGymInterface::RecordOutOfRange(bool action, uint32_t count) {
+  if (count == 0) {
+    return;
+  }
+  NS_LOG_DEBUG(count << (action ? " action values clipped"
+                                : " observation values replaced"));
+  if (m_recordStats && m_stats) {
+    (action ? m_stats->m_actionsClipped : m_stats->m_observationsReplaced)
+        .fetch_add(count, std::memory_order_relaxed);
+  }
+  m_outOfRangeTrace(action, count);
+}
+
+void OpenGymInterface::SetDecisionInterval(uint32_t steps) {
+  NS_ABORT_MSG_IF(steps == 0, "Decision interval must be at least one step");
+  m_decisionInterval = steps;
+  m_pendingSteps = 0;
+  m_pendingReward = 0;
+}
+
+void OpenGymInterface::SetRepeatAction(bool repeatAction) {
+  m_repeatAction = repeatAction;
+}
+
+void OpenGymInterface::SetRewardReduction(RewardReduction reduction) {
+  m_rewardReduction = reduction;
+}
+
+void OpenGymInterface::SetObservationStack(uint32_t depth) {
+  NS_ABORT_MSG_IF(depth == 0, "Observation stack must hold at least one step");
+  m_obsStackDepth = depth;
+  // the stacked space is part of the cached init message
+  m_simInitMsg.clear();
+}
+
+void OpenGymInterface::SetStructLayouts(const ns3penv::StructLayout &obs,
+                                        const ns3penv::StructLayout &act,
+                                        Ptr<OpenGymDataContainer> action) {
+  NS_LOG_FUNCTION(this);
+  ns3penv::SimInitMsg layouts;
+  *layouts.mutable_obsstruct() = obs;
+  *layouts.mutable_actstruct() = act;
+  m_structLayouts = layouts.SerializeAsString();
+  m_structAction = action;
+  m_useFlatObs = true;
+  // the layouts are part of the cached init message
+  m_simInitMsg.clear();
+}
+
+void OpenGymInterface::SetTrajectoryRecording(const std::string &path,
+                                              uint32_t chunkSteps) {
+  NS_LOG_FUNCTION(this << path << chunkSteps);
+  NS_ABORT_MSG_IF(chunkSteps == 0, "Trajectory chunks must hold a step");
+  m_trajectoryPath = path;
+  m_trajectoryChunkSteps = chunkSteps;
+  // the recorder is laid out with the init message
+  m_simInitMsg.clear();
+}
+
+void OpenGymInterface::SetObservationNormalization(bool normalize, bool half,
+                                                   float clip) {
+  NS_ABORT_MSG_IF(!(clip > 0),
+                  "Normalized observations must be clipped above 0");
+  if (!normalize) {
+    m_normalizer = nullptr;
+  } else if (!m_normalizer) {
+    m_normalizer = CreateObject<OpenGymObservationNormalizer>();
+  }
+  m_halfNormalized = half;
+  m_normalizerClip = clip;
+  // the normalized space is part of the cached init message
+  m_simInitMsg.clear();
+}
+
+Ptr<OpenGymObservationNormalizer>
+OpenGymInterface::GetObservationNormalizer() const {
+  return m_normalizer;
+}
+
+bool OpenGymInterface::SetObservationStatistics(
+    const ns3penv::NormalizerStats &stats) {
+  NS_LOG_FUNCTION(this << stats.count());
+  NS_ABORT_MSG_IF(!m_normalizer, "Observations are not normalized");
+  // the normalizer keeps its clip until the next init message configures it
+  ns3penv::NormalizerStats restored = stats;
+  restored.set_clip(m_normalizer->GetClip());
+  if (!(stats.clip() > 0) || !m_normalizer->SetStatistics(restored)) {
+    return false;
+  }
+  if (stats.clip() != m_normalizerClip) {
+    m_normalizerClip = stats.clip();
+    // the normalized space is part of the cached init message
+    m_simInitMsg.clear();
+  }
+  return true;
+}
+
+void OpenGymInterface::SetWarmReset(bool warmReset) {
+  m_warmReset = warmReset;
+  // the flag is part of the cached init message
+  m_simInitMsg.clear();
+}
+
+bool OpenGymInterface::IsResetRequested() const { return m_resetRequested; }
+
+void OpenGymInterface::Reinitialize() {
+  NS_LOG_FUNCTION(this);
+  m_resetRequested = false;
+  m_simEnd = false;
+  m_initSimMsgSent = false;
+  // python dropped its delta-mode bases with the episode
+  m_resyncRequested = true;
+  m_actionPending = false;
+  m_actionExpired = false;
+  m_deadlineEvent.Cancel();
+  m_lastAction = nullptr;
+  m_pendingSteps = 0;
+  m_pendingReward = 0;
+  if (m_obsStack) {
+    m_obsStack->Clear();
+  }
+}
+
+void OpenGymInterface::SetForkEpisodes(bool forkEpisodes) {
+  m_forkEpisodes = forkEpisodes;
+}
+
+void OpenGymInterface::Checkpoint() {
+  NS_LOG_FUNCTION(this);
+  if (!m_forkEpisodes || m_forkEpisode > 0) {
+    return;
+  }
+  NS_ABORT_MSG_IF(m_initSimMsgSent,
+                  "Checkpoint after the first notification cannot be forked");
+  if (m_simInitMsg.empty()) {
+    BuildSimInitMsg();
+  }
+  ExchangeSimInitMsg(true);
+  if (m_stopEnvRequested) {
+    return;
+  }
+
+  // worker threads do not survive fork, every child starts its own
+  uint32_t threads = m_encoderThreads;
+  uint32_t threshold = m_encoderThreshold;
+  SetParallelEncoding(0);
+  ServeForks();
+  SetParallelEncoding(threads, threshold);
+}
+
+void OpenGymInterface::ServeForks() {
+  Ns3penvTransport *msgInterface = GetTransport();
+  ns3penv::ForkRequest request;
+  while (true) {
+    // episodes take as long as they take, only a gone agent ends the wait
+    if (!BeginExchange(false, NS3PENV_WAIT_FOREVER)) {
+      return;
+    }
+    request.ParseFromArray(msgInterface->GetPy2CppStruct()->buffer.get(),
+                           msgInterface->GetPy2CppStruct()->size);
+    msgInterface->CppRecvEnd();
+    if (request.stop()) {
+      NS_LOG_DEBUG("---Stop requested for the fork template");
+      m_stopEnvRequested = true;
+      Simulator::Stop();
+      Simulator::Destroy();
+      std::exit(0);
+    }
+    // the children of earlier episodes that have exited
+    while (waitpid(-1, nullptr, WNOHANG) > 0) {
+    }
+
+    // output still buffered would be written by both processes
+    std::fflush(nullptr);
+    pid_t pid = fork();
+    if (pid == 0) {
+      // the mapping of the template segment is only dropped, python owns it
+      m_forkEpisode = request.episode();
+      m_transport.reset();
+      m_msgInterface.reset();
+      m_stats = nullptr;
+      return;
+    }
+    if (pid < 0) {
+      NS_LOG_WARN("Cannot fork episode " << request.episode() << ": "
+                                         << std::strerror(errno));
+      pid = 0;
+    } else {
+      NS_LOG_DEBUG("Forked episode " << request.episode() << " as " << pid);
+    }
+    ns3penv::ForkReply reply;
+    reply.set_pid(pid);
+    if (!BeginExchange(true, NS3PENV_WAIT_FOREVER)) {
+      return;
+    }
+    Ns3penvGymMsg *replyMsg =
+        ReserveCpp2PyMsg(msgInterface, reply.ByteSizeLong());
+    replyMsg->size = reply.ByteSizeLong();
+    reply.SerializeToArray(replyMsg->buffer.get(), replyMsg->size);
+    msgInterface->CppSendEnd();
+  }
+}
+
+Ns3penvMsgInterface *OpenGymInterface::GetMsgInterface() {
+  if (!m_msgInterface) {
+    std::string id = GetSegmentId();
+    m_msgInterface = std::make_unique<Ns3penvMsgInterface>();
+    m_msgInterface->CopySettings(*Ns3penvMsgInterface::Get());
+    m_msgInterface->SetNames("seg" + id, "cpp2py" + id, "py2cpp" + id,
+                             "lockable" + id);
+    m_msgInterface->SetIsMemoryCreator(false);
+    m_msgInterface->SetUseVector(false);
+    m_msgInterface->SetHandleFinish(false);
+  }
+  return m_msgInterface.get();
+}
+
+std::string OpenGymInterface::GetSegmentId() const {
+  // a fork child plays its episode over segments of its own
+  std::string suffix =
+      m_forkEpisode > 0 ? "-" + std::to_string(m_forkEpisode) : "";
+  return std::to_string(m_envId) + suffix;
+}
+
+void OpenGymInterface::SetTransport(const std::string &address) {
+  NS_LOG_FUNCTION(this << address);
+  NS_ABORT_MSG_IF(m_transport, "SetTransport after the first message");
+  m_transportAddress = address;
+}
+
+void OpenGymInterface::SetPeerTimeout(Time timeout) {
+  NS_LOG_FUNCTION(this << timeout);
+  NS_ABORT_MSG_IF(timeout.IsStrictlyNegative(), "Negative peer timeout");
+  m_peerTimeoutUs = timeout.IsZero() ? NS3PENV_WAIT_FOREVER
+                                     : uint64_t(timeout.GetMicroSeconds());
+  m_peerTimeoutSet = true;
+}
+
+bool OpenGymInterface::IsPeerLost() const { return m_peerLost; }
+
+bool OpenGymInterface::BeginExchange(bool send, uint64_t timeoutUs) {
+  if (m_peerLost) {
+    // a gone agent is forgotten by the wait that found it, a second wait
+    // would take it for one not attached yet
+    return false;
+  }
+  Ns3penvTransport *msgInterface = GetTransport();
+  Ns3penvWaitStatus status = send ? msgInterface->CppSendBeginFor(timeoutUs)
+                                  : msgInterface->CppRecvBeginFor(timeoutUs);
+  if (status == Ns3penvWaitStatus::OK) {
+    return true;
+  }
+  AbandonPeer(status);
+  return false;
+}
+
+void OpenGymInterface::AbandonPeer(Ns3penvWaitStatus status) {
+  NS_LOG_FUNCTION(this);
+  if (status == Ns3penvWaitStatus::TIMEOUT) {
+    NS_LOG_WARN("The agent of env " << m_envId << " did not answer within "
+                                    << m_peerTimeoutUs / 1000
+                                    << " ms, stopping the simulation");
+  } else {
+    NS_LOG_WARN("The agent of env " << m_envId
+                                    << " is gone, stopping the simulation");
+  }
+  m_stopEnvRequested = true;
+  m_peerLost = true;
+  m_actionPending = false;
+  m_deadlineEvent.Cancel();
+  if (m_recorder) {
+    m_recorder->Close();
+  }
+  if (status == Ns3penvWaitStatus::PEER_GONE && m_transportAddress.empty()) {
+    // python created the segment and would have removed it; a timed out
+    // agent may still be using it, so that one is left alone
+    boost::interprocess::shared_memory_object::remove(
+        ("seg" + GetSegmentId()).c_str());
+  }
+  // the simulation ends as it would have, the events are only cut short
+  Simulator::Stop();
+}
+
+Ns3penvTransport *OpenGymInterface::GetTransport() {
+  if (!m_transport) {
+    if (!m_peerTimeoutSet) {
+      const char *timeout = std::getenv("NS3PENV_PEER_TIMEOUT");
+      double seconds = timeout ? std::strtod(timeout, nullptr) : 0;
+      if (seconds > 0) {
+        m_peerTimeoutUs = uint64_t(seconds * 1e6);
+      }
+    }
+    if (m_transportAddress.empty()) {
+      const char *address = std::getenv("NS3PENV_TRANSPORT");
+      m_transportAddress = address ? address : "";
+    }
+    if (m_transportAddress.empty()) {
+      m_transport = std::make_unique<Ns3penvShmTransport>(
+          GetMsgInterface()->GetInterface<Ns3penvGymMsg, Ns3penvGymMsg>());
+    } else {
+      NS_ABORT_MSG_IF(m_forkEpisodes,
+                      "Fork episodes need the shared memory transport");
+      // every env listens on a port of its own, as it has a segment
+      std::size_t colon = m_transportAddress.rfind(':');
+      NS_ABORT_MSG_IF(colon == std::string::npos,
+                      "Transport address " << m_transportAddress
+                                           << " has no port");
+      uint32_t port = std::stoul(m_transportAddress.substr(colon + 1));
+      m_transport = std::make_unique<Ns3penvSocketTransport>(
+          m_transportAddress.substr(0, colon + 1) +
+          std::to_string(port + m_envId));
+    }
+  }
+  return m_transport.get();
+}
+
+uint OpenGymInterface::GetEnvId() const { return m_envId; }
+
 void OpenGymInterface::WaitForStop() {
   NS_LOG_FUNCTION(this);
   //    NS_LOG_UNCOND("Wait for stop message");
@@ -209,6 +1169,9 @@ void OpenGymInterface::NotifySimulationEnd() {
   if (m_initSimMsgSent) {
     WaitForStop();
   }
+  if (m_recorder) {
+    m_recorder->Flush();
+  }
 }
 
 Ptr<OpenGymSpace> OpenGymInterface::GetActionSpace() {
@@ -305,7 +1268,27 @@ void OpenGymInterface::SetExecuteActionsCb(
 
 void OpenGymInterface::DoInitialize() { NS_LOG_FUNCTION(this); }
 
-void OpenGymInterface::DoDispose() { NS_LOG_FUNCTION(this); }
+void OpenGymInterface::DoDispose() {
+  NS_LOG_FUNCTION(this);
+  m_actionDecoder = nullptr;
+  m_actDataContainer = nullptr;
+  m_lastAction = nullptr;
+  m_normalizer = nullptr;
+  m_obsStack = nullptr;
+  if (m_encoder) {
+    m_encoder->Dispose();
+    m_encoder = nullptr;
+  }
+  if (m_recorder) {
+    m_recorder->Dispose();
+    m_recorder = nullptr;
+  }
+  m_fallbackAction = nullptr;
+  m_structAction = nullptr;
+  m_deadlineEvent.Cancel();
+  m_arena.reset();
+  m_arenaBlock = std::vector<char>();
+}
 
 void OpenGymInterface::Notify(Ptr<OpenGymEnv> entity) {
   NS_LOG_FUNCTION(this);
@@ -319,9 +1302,9 @@ void OpenGymInterface::Notify(Ptr<OpenGymEnv> entity) {
   NotifyCurrentState();
 }
 
-Ptr<OpenGymInterface> *OpenGymInterface::DoGet() {
-  static Ptr<OpenGymInterface> ptr = CreateObject<OpenGymInterface>(0U);
-  return &ptr;
+std::map<uint, Ptr<OpenGymInterface>> *OpenGymInterface::DoGet() {
+  static std::map<uint, Ptr<OpenGymInterface>> interfaces;
+  return &interfaces;
 }
 
 } // namespace ns3
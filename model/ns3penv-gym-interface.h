@@ -23,26 +23,258 @@
 #ifndef NS3PENV_GYM_INTERFACE_H
 #define NS3PENV_GYM_INTERFACE_H
 
+#include "ns3penv-stats.h"
+
 #include <ns3/callback.h>
+#include <ns3/event-id.h>
+#include <ns3/nstime.h>
 #include <ns3/object.h>
 #include <ns3/ptr.h>
+#include <ns3/traced-callback.h>
 #include <ns3/type-id.h>
 
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Ns3penvGymMsg;
+
+namespace google::protobuf {
+class Arena;
+}
+
+namespace ns3penv {
+class EnvStateMsg;
+class EnvActMsg;
+class StructLayout;
+class NormalizerStats;
+}
+
 namespace ns3 {
 
 class OpenGymSpace;
 class OpenGymDataContainer;
+class OpenGymActionDecoder;
+class OpenGymObservationNormalizer;
+class OpenGymObservationStack;
+class OpenGymParallelEncoder;
+class OpenGymTrajectoryRecorder;
 class OpenGymEnv;
+class Ns3penvMsgInterface;
+class Ns3penvTransport;
+enum class Ns3penvWaitStatus : uint8_t;
 
 class OpenGymInterface : public Object {
 public:
+  /** How the rewards of the steps between two decisions are combined */
+  enum RewardReduction { REWARD_SUM, REWARD_MEAN, REWARD_LAST };
+
   static Ptr<OpenGymInterface> Get();
+  /**
+   * Gets the interface of the given env id, creating it on first use.
+   * Each env id talks to its own agent through segment "seg<envId>".
+   */
+  static Ptr<OpenGymInterface> Get(uint envId);
   OpenGymInterface(uint envId);
   ~OpenGymInterface() override;
   static TypeId GetTypeId();
 
   void Init();
   void NotifyCurrentState();
+  bool StreamCurrentState();
+  /**
+   * Applies the reply to the last state if it has arrived, in async mode.
+   * Returns whether an action message was received.
+   */
+  bool PollActions();
+
+  /**
+   * Sends Box observations as a fixed header followed by the raw values
+   * instead of an EnvStateMsg. Other observations still use protobuf.
+   */
+  void SetUseFlatObservation(bool useFlatObs);
+  /**
+   * Announces the structs of a TypedOpenGymEnv to the agent, which turns
+   * flat observations on. An action struct the agent sends is copied into
+   * action, which is then executed.
+   */
+  void SetStructLayouts(const ns3penv::StructLayout &obs,
+                        const ns3penv::StructLayout &act,
+                        Ptr<OpenGymDataContainer> action);
+
+  /**
+   * Asks the agent for an action only on every steps-th call of
+   * NotifyCurrentState. The calls in between execute the last action again
+   * and reduce their rewards into the reward of the next state. A game over
+   * or the end of the simulation is sent right away. Above 1, GetReward and
+   * GetGameOver run before GetObservation on every step, rather than after.
+   */
+  void SetDecisionInterval(uint32_t steps);
+  /**
+   * Whether the calls between two decisions execute the last action again
+   * (the default) or leave the simulation running on the previous one.
+   */
+  void SetRepeatAction(bool repeatAction);
+  void SetRewardReduction(RewardReduction reduction);
+  /**
+   * Sends the last depth observations as one Box of shape {depth, ...},
+   * oldest first, and advertises that space to the agent. Only Box
+   * observation spaces can be stacked.
+   */
+  void SetObservationStack(uint32_t depth);
+  /**
+   * Records every state sent to the agent, with the action it answered,
+   * into the directory path (see OpenGymTrajectoryRecorder), for offline
+   * training or a replay with python/src/ns3env/trajectory.py. The spaces
+   * are those advertised, i.e. normalized and stacked. A fork episode
+   * records into path-<episode>, an empty path records nothing.
+   */
+  void SetTrajectoryRecording(const std::string &path,
+                              uint32_t chunkSteps = 1024);
+
+  /**
+   * Lets NotifyCurrentState return right after sending the state instead of
+   * waiting for the action. The action is applied when it has arrived by
+   * a later NotifyCurrentState or PollActions, and at the latest by the
+   * next decision, which waits for it before collecting the observation.
+   */
+  void SetAsyncActions(bool asyncActions);
+
+  /**
+   * Times every phase of a step (Ns3penvStepPhase) and records the message
+   * sizes, in the Ns3penvStats of the segment, which the Python side can
+   * read, and through the StepPhase and MessageSize trace sources
+   */
+  void SetRecordStepStats(bool recordStats);
+
+  /**
+   * Encodes the elements of dict and tuple observations on threads extra
+   * worker threads, once a state has reached threshold bytes. The message
+   * is the same as encoded on one thread. Zero threads turns it off.
+   */
+  void SetParallelEncoding(uint32_t threads, uint32_t threshold = 256 * 1024);
+
+  /**
+   * Clamps the Box values of every action that matches the action space to
+   * the bounds of their space before ExecuteActions. NaN becomes the low
+   * bound. Actions decoded generically, because they do not match the space
+   * or the space cannot be compiled, are executed unclipped, with a warning
+   * the first time.
+   */
+  void SetClipActions(bool clipActions);
+  /**
+   * Replaces NaN and infinite values of float Box observations, in the
+   * observation container itself, before they are sent
+   */
+  void SetObservationGuard(bool guard, float replacement = 0);
+  /**
+   * Normalizes Box observations by their running mean and variance per
+   * value, clipped to [-clip, clip], and advertises the float (or float16,
+   * if half) space of the normalized values. The statistics are sent to the
+   * agent with every init message; they are kept across reruns of the same
+   * interface and can be frozen through GetObservationNormalizer.
+   */
+  void SetObservationNormalization(bool normalize, bool half = false,
+                                   float clip = 10);
+  Ptr<OpenGymObservationNormalizer> GetObservationNormalizer() const;
+  /**
+   * Restores stored normalizer statistics. A clip other than the current
+   * one becomes the clip of normalization, and with it of the space in the
+   * next init message.
+   * \returns false, keeping the statistics, if they do not fit
+   */
+  bool SetObservationStatistics(const ns3penv::NormalizerStats &stats);
+
+  /**
+   * TracedCallback signature of the StepPhase trace source
+   * \param [in] phase the Ns3penvStepPhase
+   * \param [in] nanoseconds the wall-clock time it took
+   */
+  typedef void (*StepPhaseTracedCallback)(uint32_t phase,
+                                          uint64_t nanoseconds);
+  /**
+   * TracedCallback signature of the MessageSize trace source
+   * \param [in] sent whether it is a state sent rather than an action
+   * \param [in] size its bytes
+   */
+  typedef void (*MessageSizeTracedCallback)(bool sent, uint32_t size);
+  /**
+   * TracedCallback signature of the OutOfRange trace source
+   * \param [in] action whether action values were clipped rather than
+   * observation values replaced
+   * \param [in] count how many values of the step
+   */
+  typedef void (*OutOfRangeTracedCallback)(bool action, uint32_t count);
+  /**
+   * In async mode, executes fallbackAction (if any) when no action has
+   * arrived deadline after the state was sent. The late action is then
+   * dropped, but the next decision still waits for it before it sends its
+   * state, so the deadline moves a stall rather than avoiding it (see
+   * SetPeerTimeout to give up on a slow agent). A zero deadline waits for
+   * the next decision.
+   */
+  void SetActionDeadline(Time deadline,
+                         Ptr<OpenGymDataContainer> fallbackAction = nullptr);
+
+  /**
+   * Advertises that the agent may reset by a message rather than by
+   * restarting ns3 (see OpenGymEnv::RunEpisodes). A reset request stops the
+   * simulator; Reinitialize then prepares the next episode, whose first
+   * notification replays the init message over the same segment.
+   */
+  void SetWarmReset(bool warmReset);
+  bool IsResetRequested() const;
+  /**
+   * Forgets the episode after a reset request: the init message is sent
+   * again (without the spaces, which the agent has), the next observation
+   * in full, and pending actions, decision steps and stacked frames are
+   * dropped. The settings and normalization statistics are kept.
+   */
+  void Reinitialize();
+
+  /**
+   * Turns Checkpoint into a fork point for the rest of the process: it
+   * announces itself to the agent as a template and forks a copy-on-write
+   * child for every episode, which goes on from the checkpoint over a
+   * segment of its own, named like this env's with "-<episode>" appended.
+   */
+  void SetForkEpisodes(bool forkEpisodes);
+  /**
+   * Marks the end of the warm-up every episode shares. Without fork
+   * episodes, or in a child, it does nothing. Must come before the first
+   * notification, from within a simulation event.
+   */
+  void Checkpoint();
+
+  /**
+   * Gets the msg interface of this env, to change its settings (e.g. the
+   * wait mode) before the first message is exchanged. It starts from the
+   * settings the process-wide Ns3penvMsgInterface has on the first call.
+   */
+  Ns3penvMsgInterface *GetMsgInterface();
+  /**
+   * Exchanges the messages over a connection to address, "tcp://host:port"
+   * (see Ns3penvSocketTransport), instead of the shared memory segment.
+   * The port is offset by the env id. Empty, the default unless the
+   * NS3PENV_TRANSPORT environment variable is set, means shared memory.
+   * Must come before the first message is exchanged; fork episodes and the
+   * step statistics of the segment need shared memory.
+   */
+  void SetTransport(const std::string &address);
+  /**
+   * Sets how long, in wall-clock time, the simulation waits for the agent
+   * to take a state or to answer it. Past that, or as soon as the agent
+   * process is found gone, the simulation stops as if the agent had asked
+   * for it, and the segment of a gone agent is removed. Zero, the default
+   * unless the NS3PENV_PEER_TIMEOUT environment variable gives seconds,
+   * waits as long as the agent runs. A fork template waits for its agent
+   * regardless.
+   */
+  void SetPeerTimeout(Time timeout);
+  /** Whether the simulation stopped because the agent was lost */
+  bool IsPeerLost() const;
+  uint GetEnvId() const;
   void WaitForStop();
   void NotifySimulationEnd();
 
@@ -70,13 +302,111 @@ protected:
   void DoDispose() override;
 
 private:
-  static Ptr<OpenGymInterface> *DoGet();
+  static std::map<uint, Ptr<OpenGymInterface>> *DoGet();
+  void BuildSimInitMsg();
+  void ExchangeSimInitMsg(bool forkTemplate);
+  /** serves ForkRequests until one for a child comes, returns in it */
+  void ServeForks();
+  Ns3penvTransport *GetTransport();
+  /** seg<id> and the other names of this env, id being the env id */
+  std::string GetSegmentId() const;
+  /**
+   * Waits for the agent to free the state buffer (send) or to answer
+   * (!send), at most timeoutUs microseconds. Returns false, having given
+   * up on the agent, if it did not.
+   */
+  bool BeginExchange(bool send, uint64_t timeoutUs);
+  /** Stops the simulation for good after a failed wait for the agent */
+  void AbandonPeer(Ns3penvWaitStatus status);
   //    static void Delete();
+  ns3penv::EnvStateMsg *NewEnvStateMsg();
+  void BuildEnvStateMsg(ns3penv::EnvStateMsg &envStateMsg,
+                        Ptr<OpenGymDataContainer> obsDataContainer,
+                        float reward, bool isGameOver,
+                        const std::string &extraInfo);
+  void ReceiveActions();
+  void WaitForActions();
+  void ExpireActions();
+  void AttachStats();
+  void StartPhase();
+  void RecordPhase(Ns3penvStepPhase phase);
+  void RecordSize(bool sent, uint32_t size);
+  void GuardObservation(Ptr<OpenGymDataContainer> obsDataContainer);
+  /**
+   * guards, normalizes and stacks an observation, in that order. Unless
+   * decision, as for a streamed state, it neither updates the normalizer
+   * statistics nor stays in the stack.
+   */
+  Ptr<OpenGymDataContainer>
+  PrepareObservation(Ptr<OpenGymDataContainer> obsDataContainer,
+                     bool decision = true);
+  void RecordOutOfRange(bool action, uint32_t count);
+  void WriteFlatEnvState(Ns3penvGymMsg *msg,
+                         Ptr<OpenGymDataContainer> obsDataContainer,
+                         float reward, bool isGameOver,
+                         const std::string &extraInfo);
 
   bool m_simEnd;
   bool m_stopEnvRequested;
+  bool m_peerLost; //!< stopped by AbandonPeer
+  bool m_resetRequested;
+  bool m_warmReset;
+  bool m_forkEpisodes;
+  uint32_t m_forkEpisode; //!< of this child, 0 in the first process
   bool m_initSimMsgSent;
+  bool m_useFlatObs;
+  bool m_resyncRequested;
+  bool m_repeatAction;
+  bool m_asyncActions;
+  bool m_actionPending; //!< the last state has not been answered yet
+  bool m_actionExpired; //!< its deadline has passed
+  bool m_recordStats;
+  bool m_clipActions;
+  bool m_unclippedLogged; //!< a generic action was warned about
+  bool m_guardObservation;
+  float m_guardReplacement;
+  bool m_halfNormalized;
+  float m_normalizerClip;
   uint m_envId;
+  std::string m_simInitMsg;       //!< serialized, replayed by later inits
+  std::string m_cachedSimInitMsg; //!< the same without the spaces
+  uint64_t m_spaceHash;
+  uint32_t m_decisionInterval;
+  uint32_t m_pendingSteps; //!< steps since the last decision
+  float m_pendingReward;   //!< their rewards, reduced so far
+  RewardReduction m_rewardReduction;
+  uint32_t m_obsStackDepth;
+  uint32_t m_encoderThreads; //!< restarted in every fork child
+  uint32_t m_encoderThreshold;
+  size_t m_stateSize; //!< initial size of the state buffer
+  Ns3penvStats *m_stats; //!< in the segment, null unless recording
+  uint64_t m_phaseStart; //!< when the phase being timed started
+  TracedCallback<uint32_t, uint64_t> m_phaseTrace;
+  TracedCallback<bool, uint32_t> m_sizeTrace;
+  TracedCallback<bool, uint32_t> m_outOfRangeTrace;
+  std::unique_ptr<Ns3penvMsgInterface> m_msgInterface;
+  std::string m_transportAddress; //!< empty for shared memory
+  uint64_t m_peerTimeoutUs; //!< NS3PENV_WAIT_FOREVER for none
+  bool m_peerTimeoutSet;    //!< by SetPeerTimeout, over the environment
+  std::unique_ptr<Ns3penvTransport> m_transport;
+  std::vector<uint8_t> m_streamBuffer;
+  std::vector<char> m_arenaBlock; //!< grown to the most a step needed
+  std::unique_ptr<google::protobuf::Arena> m_arena; //!< the state of a step
+  std::unique_ptr<ns3penv::EnvActMsg> m_envActMsg;
+  Ptr<OpenGymActionDecoder> m_actionDecoder;
+  Ptr<OpenGymDataContainer> m_actDataContainer; //!< reused across steps
+  Ptr<OpenGymDataContainer> m_lastAction; //!< repeated between decisions
+  Ptr<OpenGymObservationNormalizer> m_normalizer;
+  Ptr<OpenGymObservationStack> m_obsStack;
+  Ptr<OpenGymParallelEncoder> m_encoder;
+  std::string m_trajectoryPath;
+  uint32_t m_trajectoryChunkSteps;
+  Ptr<OpenGymTrajectoryRecorder> m_recorder; //!< opened by the first state
+  std::string m_structLayouts; //!< a SimInitMsg with only the structs
+  Ptr<OpenGymDataContainer> m_structAction;
+  Time m_actionDeadline;
+  Ptr<OpenGymDataContainer> m_fallbackAction;
+  EventId m_deadlineEvent;
 
   Callback<Ptr<OpenGymSpace>> m_actionSpaceCb;
   Callback<Ptr<OpenGymSpace>> m_observationSpaceCb;
@@ -21,13 +21,26 @@
 #ifndef NS3_NS3_AI_GYM_MSG_H
 #define NS3_NS3_AI_GYM_MSG_H
 
+#include <boost/interprocess/offset_ptr.hpp>
 #include <stdint.h>
 
+// initial capacity of a message buffer, it grows on demand
 #define MSG_BUFFER_SIZE 32768
 
+/**
+ * \brief A message of the Gym interface
+ *
+ * The payload is allocated separately inside the shared memory segment, so
+ * that it can grow past MSG_BUFFER_SIZE at runtime (see
+ * Ns3penvMsgInterfaceImpl::Reserve). The offset pointer stays valid in both
+ * processes even if the segment is mapped at different addresses.
+ */
 struct Ns3penvGymMsg {
-  uint8_t buffer[MSG_BUFFER_SIZE];
-  uint32_t size;
+  static constexpr uint32_t DEFAULT_CAPACITY = MSG_BUFFER_SIZE;
+
+  boost::interprocess::offset_ptr<uint8_t> buffer;
+  uint32_t capacity{0};
+  uint32_t size{0};
 };
 
 #endif // NS3PENV_GYM_MSG_H
@@ -21,29 +21,226 @@
 #ifndef NS3PENV_MSG_INTERFACE_H
 #define NS3PENV_MSG_INTERFACE_H
 
+#include "ns3penv-ring.h"
 #include "ns3penv-semaphore.h"
+#include "ns3penv-stats.h"
 
 #include <ns3/singleton.h>
 
+#include <algorithm>
+#include <atomic>
 #include <boost/interprocess/allocators/allocator.hpp>
 #include <boost/interprocess/containers/vector.hpp>
 #include <boost/interprocess/managed_shared_memory.hpp>
 #include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
 #include <string>
+#include <typeinfo>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <csignal>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace ns3 {
 
+/**
+ * Layout version of Ns3penvMsgSync and the message structs, bumped whenever
+ * one of them changes so that both sides can check they were built against
+ * the same layout
+ */
+#define NS3PENV_MSG_SYNC_VERSION 5
+
+/**
+ * Longest a wait goes without checking that the other side still lives,
+ * in microseconds
+ */
+#define NS3PENV_LIVENESS_INTERVAL_US 100000
+
+/**
+ * \brief How a bounded wait for the other side ended
+ */
+enum class Ns3penvWaitStatus : uint8_t {
+  OK = 0,        //!< the semaphore was acquired
+  TIMEOUT = 1,   //!< the other side did not answer in time
+  PEER_GONE = 2, //!< the process of the other side has exited
+};
+
+/**
+ * \brief The process on one side of a segment
+ *
+ * m_pid is 0 until the side first waits on the segment, and again once
+ * the other side found it gone. m_heartbeat counts the messages it has
+ * handed over, so that a monitor can tell a slow side from a stuck one.
+ * Each side owns a cache line, the other one only reads it while waiting.
+ */
+struct alignas(NS3PENV_CACHE_LINE_SIZE) Ns3penvMsgPeer {
+  std::atomic<int32_t> m_pid{0};
+  // pid namespace of m_pid: pids of another namespace cannot be checked
+  std::atomic<uint64_t> m_pidNamespace{0};
+  std::atomic<uint64_t> m_heartbeat{0};
+};
+
+/**
+ * Identifies the pid namespace of this process, 0 if unknown
+ */
+inline uint64_t Ns3penvPidNamespace() {
+#if defined(__linux__)
+  static const uint64_t ns = []() -> uint64_t {
+    struct stat st;
+    return stat("/proc/self/ns/pid", &st) == 0 ? uint64_t(st.st_ino) : 0;
+  }();
+  return ns;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Gets whether the process pid of the pid namespace pidNamespace may still
+ * be running. An unknown pid, or one of another namespace, is taken as
+ * alive.
+ */
+inline bool Ns3penvProcessAlive(int32_t pid, uint64_t pidNamespace) {
+#if defined(__unix__) || defined(__APPLE__)
+  if (pid <= 0 || pidNamespace != Ns3penvPidNamespace()) {
+    return true;
+  }
+  // EPERM: it exists, but belongs to someone else
+  return kill(pid, 0) == 0 || errno == EPERM;
+#else
+  (void)pid;
+  (void)pidNamespace;
+  return true;
+#endif
+}
+
+/**
+ * Bytes a message of MsgType needs in a ring record. Messages with a
+ * separately allocated buffer announce their usual size as
+ * DEFAULT_CAPACITY, plain structs are copied as they are.
+ */
+template <typename MsgType> constexpr uint32_t Ns3penvMsgSlotSize() {
+  if constexpr (requires { MsgType::DEFAULT_CAPACITY; }) {
+    return MsgType::DEFAULT_CAPACITY;
+  } else {
+    return sizeof(MsgType);
+  }
+}
+
+/**
+ * \brief The empty/full semaphore pair of one transmission direction
+ *
+ * Each direction owns a whole cache line, so that C++ and Python polling
+ * different directions from different cores do not bounce the same line.
+ */
+struct alignas(NS3PENV_CACHE_LINE_SIZE) Ns3penvMsgChannel {
+  Ns3penvSemaphoreWord m_emptyCount{1};
+  Ns3penvSemaphoreWord m_fullCount{0};
+};
+
 /**
  * \brief Structure containing semaphores used in msg interface
  */
 struct Ns3penvMsgSync {
-  volatile uint8_t m_cpp2pyEmptyCount{1};
-  volatile uint8_t m_cpp2pyFullCount{0};
-  volatile uint8_t m_py2cppEmptyCount{1};
-  volatile uint8_t m_py2cppFullCount{0};
-  bool m_isFinished{false};
+  alignas(NS3PENV_CACHE_LINE_SIZE) uint32_t m_version{
+      NS3PENV_MSG_SYNC_VERSION};
+  std::atomic<bool> m_isFinished{false};
+  // hash of the spaces Python already knows, 0 if none; it outlives the
+  // simulations, so a restarted one need not send its spaces again
+  std::atomic<uint64_t> m_spaceHash{0};
+  // bumped whenever a process attaches to either side, so that a monitor
+  // notices a restarted simulation
+  std::atomic<uint32_t> m_epoch{0};
+  Ns3penvMsgPeer m_cppPeer;
+  Ns3penvMsgPeer m_pyPeer;
+  Ns3penvMsgChannel m_cpp2py;
+  Ns3penvMsgChannel m_py2cpp;
+};
+
+/**
+ * \brief Synchronization of one simulation in a batched segment
+ *
+ * m_ready is set by the simulation after posting a state and cleared by
+ * the Python side when it collects that state.
+ */
+struct Ns3penvBatchSlot {
+  Ns3penvMsgSync m_sync;
+  alignas(NS3PENV_CACHE_LINE_SIZE) std::atomic<uint32_t> m_ready{0};
+};
+
+/**
+ * \brief Header of a batched segment, where several simulations use the
+ * slots of one segment and the Python side waits for any of them
+ *
+ * m_readyCount counts the states posted to all slots and not collected
+ * yet, so that Python sleeps on a single word instead of polling every
+ * slot.
+ */
+struct Ns3penvBatchSync {
+  alignas(NS3PENV_CACHE_LINE_SIZE) uint32_t m_version{
+      NS3PENV_MSG_SYNC_VERSION};
+  uint32_t m_numSlots;
+  alignas(NS3PENV_CACHE_LINE_SIZE) Ns3penvSemaphoreWord m_readyCount{0};
+
+  explicit Ns3penvBatchSync(uint32_t numSlots) : m_numSlots(numSlots) {}
 };
 
+/**
+ * Name of the slot array of a batched segment
+ */
+inline std::string Ns3penvBatchSlotsName(const char *lockable_name) {
+  return std::string(lockable_name) + " Slots";
+}
+
+/**
+ * Name of the step statistics of a segment, or of one slot of a batched
+ * segment when slot is not negative
+ */
+inline std::string Ns3penvStatsName(const char *lockable_name,
+                                    int32_t slot = -1) {
+  std::string name = std::string(lockable_name) + " Stats";
+  return slot < 0 ? name : name + " " + std::to_string(slot);
+}
+
+/**
+ * Makes sure the buffer of msg holds at least size bytes, growing it inside
+ * the segment of segmentManager if needed. See
+ * Ns3penvMsgInterfaceImpl::Reserve.
+ */
+template <typename MsgType>
+bool Ns3penvReserveMsg(
+    boost::interprocess::managed_shared_memory::segment_manager
+        *segmentManager,
+    MsgType *msg, uint32_t size) {
+  if (size <= msg->capacity) {
+    return true;
+  }
+  // grow geometrically so that slowly growing messages reallocate rarely
+  uint64_t capacity = std::max<uint64_t>(
+      {size, uint64_t(msg->capacity) * 2, MsgType::DEFAULT_CAPACITY});
+  capacity = std::min<uint64_t>(capacity, UINT32_MAX);
+  void *buffer = segmentManager->allocate(capacity, std::nothrow);
+  if (buffer == nullptr && capacity > size) {
+    capacity = size;
+    buffer = segmentManager->allocate(capacity, std::nothrow);
+  }
+  if (buffer == nullptr) {
+    return false;
+  }
+  if (msg->buffer) {
+    segmentManager->deallocate(msg->buffer.get());
+  }
+  msg->buffer = static_cast<uint8_t *>(buffer);
+  msg->capacity = static_cast<uint32_t>(capacity);
+  return true;
+}
+
 /**
  * \brief A template class implementation of the message interface
  */
@@ -57,20 +254,27 @@ public:
       uint32_t size = 131072, const char *segment_name = "My Seg",
       const char *cpp2py_msg_name = "My Cpp to Python Msg",
       const char *py2cpp_msg_name = "My Python to Cpp Msg",
-      const char *lockable_name = "My Lockable")
+      const char *lockable_name = "My Lockable",
+      Ns3penvWaitMode wait_mode = Ns3penvWaitMode::SPIN,
+      uint32_t spin_budget = 4096, uint32_t ring_slots = 0,
+      int32_t batch_slot = -1)
       : m_isCreator(is_memory_creator), m_useVector(use_vector),
         m_handleFinish(handle_finish), m_segName(segment_name),
-        m_isFinished(false) {
+        m_statsName(Ns3penvStatsName(lockable_name, batch_slot)),
+        m_isFinished(false), m_waitMode(wait_mode),
+        m_spinBudget(spin_budget), m_self(nullptr), m_segmentManager(nullptr),
+        m_slotReady(nullptr), m_batchReady(nullptr), m_cpp2pyRing(nullptr),
+        m_cpp2pyRingData(nullptr), m_py2cppRing(nullptr),
+        m_py2cppRingData(nullptr) {
     using namespace boost::interprocess;
     if (m_isCreator) {
       shared_memory_object::remove(m_segName.c_str());
-      static managed_shared_memory segment(create_only, m_segName.c_str(),
-                                           size);
+      m_segment = managed_shared_memory(create_only, m_segName.c_str(), size);
+      managed_shared_memory &segment = m_segment;
+      m_segmentManager = segment.get_segment_manager();
       if (m_useVector) {
-        static const Cpp2PyMsgAllocator alloc_env(
-            segment.get_segment_manager());
-        static const Cpp2PyMsgAllocator alloc_act(
-            segment.get_segment_manager());
+        const Cpp2PyMsgAllocator alloc_env(segment.get_segment_manager());
+        const Py2CppMsgAllocator alloc_act(segment.get_segment_manager());
         m_cpp2pyVector =
             segment.construct<Cpp2PyMsgVector>(cpp2py_msg_name)(alloc_env);
         m_py2cppVector =
@@ -84,8 +288,29 @@ public:
         m_py2CppStruct = segment.construct<Py2CppMsgType>(py2cpp_msg_name)();
       }
       m_sync = segment.construct<Ns3penvMsgSync>(lockable_name)();
+      if (ring_slots > 0) {
+        uint32_t cpp2pyCapacity = Ns3penvRing::capacity_for(
+            ring_slots, Ns3penvMsgSlotSize<Cpp2PyMsgType>());
+        uint32_t py2cppCapacity = Ns3penvRing::capacity_for(
+            ring_slots, Ns3penvMsgSlotSize<Py2CppMsgType>());
+        m_cpp2pyRing = segment.construct<Ns3penvRingHeader>(
+            RingName(cpp2py_msg_name).c_str())(cpp2pyCapacity);
+        m_cpp2pyRingData = segment.construct<uint8_t>(
+            RingDataName(cpp2py_msg_name).c_str())[cpp2pyCapacity](0);
+        m_py2cppRing = segment.construct<Ns3penvRingHeader>(
+            RingName(py2cpp_msg_name).c_str())(py2cppCapacity);
+        m_py2cppRingData = segment.construct<uint8_t>(
+            RingDataName(py2cpp_msg_name).c_str())[py2cppCapacity](0);
+      }
     } else {
-      static managed_shared_memory segment(open_only, segment_name);
+      m_segment = managed_shared_memory(open_only, segment_name);
+      managed_shared_memory &segment = m_segment;
+      m_segmentManager = segment.get_segment_manager();
+      if (batch_slot >= 0) {
+        OpenBatchSlot(batch_slot, cpp2py_msg_name, py2cpp_msg_name,
+                      lockable_name);
+        return;
+      }
       if (m_useVector) {
         m_cpp2pyVector = segment.find<Cpp2PyMsgVector>(cpp2py_msg_name).first;
         m_py2cppVector = segment.find<Py2CppMsgVector>(py2cpp_msg_name).first;
@@ -98,10 +323,32 @@ public:
         m_py2CppStruct = segment.find<Py2CppMsgType>(py2cpp_msg_name).first;
       }
       m_sync = segment.find<Ns3penvMsgSync>(lockable_name).first;
+      if (m_sync == nullptr) {
+        throw std::runtime_error("ns3penv: sync object not found in segment " +
+                                 m_segName);
+      }
+      if (m_sync->m_version != NS3PENV_MSG_SYNC_VERSION) {
+        throw std::runtime_error(
+            "ns3penv: sync layout version mismatch in segment " + m_segName +
+            " (found " + std::to_string(m_sync->m_version) + ", expected " +
+            std::to_string(NS3PENV_MSG_SYNC_VERSION) + ")");
+      }
+      // the rings are optional, the creator decides whether they exist
+      m_cpp2pyRing =
+          segment.find<Ns3penvRingHeader>(RingName(cpp2py_msg_name).c_str())
+              .first;
+      m_cpp2pyRingData =
+          segment.find<uint8_t>(RingDataName(cpp2py_msg_name).c_str()).first;
+      m_py2cppRing =
+          segment.find<Ns3penvRingHeader>(RingName(py2cpp_msg_name).c_str())
+              .first;
+      m_py2cppRingData =
+          segment.find<uint8_t>(RingDataName(py2cpp_msg_name).c_str()).first;
     }
   };
 
   ~Ns3penvMsgInterfaceImpl() {
+    Detach();
     if (m_isCreator) {
       boost::interprocess::shared_memory_object::remove(m_segName.c_str());
     } else {
@@ -124,6 +371,19 @@ public:
   typedef boost::interprocess::vector<Py2CppMsgType, Py2CppMsgAllocator>
       Py2CppMsgVector;
 
+  /**
+   * Sets how this side waits for the other one. The policy is local to
+   * each side, posters always wake a parked waiter.
+   */
+  void SetWaitMode(Ns3penvWaitMode mode, uint32_t spinBudget) {
+    m_waitMode = mode;
+    m_spinBudget = spinBudget;
+  };
+
+  Ns3penvWaitMode GetWaitMode() const { return m_waitMode; };
+
+  uint32_t GetSpinBudget() const { return m_spinBudget; };
+
   // use structure for the simple case:
 
   /**
@@ -164,6 +424,88 @@ public:
     return m_py2cppVector;
   };
 
+  /**
+   * Makes sure the buffer of msg holds at least size bytes, growing it
+   * inside the segment if needed. The old contents are not kept. Only the
+   * side currently writing msg, between its SendBegin and SendEnd, may call
+   * this. Returns false if the segment has no room left, in which case msg
+   * is unchanged.
+   */
+  template <typename MsgType> bool Reserve(MsgType *msg, uint32_t size) {
+    return Ns3penvReserveMsg(m_segmentManager, msg, size);
+  };
+
+  /**
+   * Gets the number of free bytes left in the segment
+   */
+  std::size_t GetFreeMemory() const {
+    return m_segmentManager->get_free_memory();
+  };
+
+  /**
+   * Gets the step statistics of the segment, creating them if create is
+   * true. Returns nullptr if they do not exist (yet), if the segment has no
+   * room for them, or if they have another layout version.
+   */
+  Ns3penvStats *GetStats(bool create) {
+    Ns3penvStats *stats =
+        create ? m_segment.find_or_construct<Ns3penvStats>(
+                     m_statsName.c_str(), std::nothrow)()
+               : m_segment.find<Ns3penvStats>(m_statsName.c_str()).first;
+    if (stats != nullptr && stats->m_version != NS3PENV_STATS_VERSION) {
+      return nullptr;
+    }
+    return stats;
+  };
+
+  // use rings for pipelined, non-blocking records:
+
+  /**
+   * Gets whether the segment has the ring buffers of the ring-based
+   * message interface
+   */
+  bool HasRing() const {
+    return m_cpp2pyRing != nullptr && m_py2cppRing != nullptr;
+  };
+
+  /**
+   * C++ side appends a record to the C++ to Python ring. Returns false
+   * without blocking if the ring is full.
+   */
+  bool CppTrySend(const void *data, uint32_t size) {
+    assert(HasRing());
+    return Ns3penvRing::try_push(m_cpp2pyRing, m_cpp2pyRingData, data, size);
+  };
+
+  /**
+   * C++ side hands the oldest record of the Python to C++ ring to
+   * consume(const uint8_t *, uint32_t). Returns false if it is empty.
+   */
+  template <typename F> bool CppTryRecv(F &&consume) {
+    assert(HasRing());
+    return Ns3penvRing::try_pop(m_py2cppRing, m_py2cppRingData,
+                                std::forward<F>(consume));
+  };
+
+  /**
+   * Python side appends a record to the Python to C++ ring. Returns false
+   * without blocking if the ring is full.
+   */
+  bool PyTrySend(const void *data, uint32_t size) {
+    assert(HasRing());
+    return Ns3penvRing::try_push(m_py2cppRing, m_py2cppRingData, data, size);
+  };
+
+  /**
+   * Python side hands the oldest record of the C++ to Python ring to
+   * consume(const uint8_t *, uint32_t). Returns false if it is empty.
+   */
+  template <typename F> bool PyTryRecv(F &&consume) {
+    assert(HasRing());
+    return Ns3penvRing::try_pop(m_cpp2pyRing, m_cpp2pyRingData,
+                                std::forward<F>(consume));
+  };
+
   // for C++ side:
 
   /**
@@ -171,21 +513,62 @@ public:
    * or vector-based
    */
   void CppSendBegin() {
-    Ns3penvSemaphore::sem_wait(&m_sync->m_cpp2pyEmptyCount);
+    CppAttach();
+    Ns3penvSemaphore::sem_wait(&m_sync->m_cpp2py.m_emptyCount, m_waitMode,
+                               m_spinBudget);
+  };
+
+  /**
+   * Like CppSendBegin, but gives up after timeout_us microseconds, or as
+   * soon as the Python process is found gone
+   */
+  Ns3penvWaitStatus CppSendBeginFor(uint64_t timeout_us) {
+    CppAttach();
+    return WaitPeer(&m_sync->m_cpp2py.m_emptyCount, m_sync->m_pyPeer,
+                    timeout_us);
   };
 
   /**
    * C++ side stops writing into shared memory, struct-based
    * or vector-based
    */
-  void CppSendEnd() { Ns3penvSemaphore::sem_post(&m_sync->m_cpp2pyFullCount); };
+  void CppSendEnd() {
+    Beat(m_sync->m_cppPeer);
+    Ns3penvSemaphore::sem_post(&m_sync->m_cpp2py.m_fullCount);
+    if (m_batchReady != nullptr) {
+      // ring the doorbell of the batched segment
+      m_slotReady->store(1, std::memory_order_release);
+      Ns3penvSemaphore::sem_post(m_batchReady);
+    }
+  };
 
   /**
    * C++ side starts reading from shared memory, struct-based
    * or vector-based
    */
   void CppRecvBegin() {
-    Ns3penvSemaphore::sem_wait(&m_sync->m_py2cppFullCount);
+    CppAttach();
+    Ns3penvSemaphore::sem_wait(&m_sync->m_py2cpp.m_fullCount, m_waitMode,
+                               m_spinBudget);
+  };
+
+  /**
+   * Like CppRecvBegin, but gives up after timeout_us microseconds, or as
+   * soon as the Python process is found gone
+   */
+  Ns3penvWaitStatus CppRecvBeginFor(uint64_t timeout_us) {
+    CppAttach();
+    return WaitPeer(&m_sync->m_py2cpp.m_fullCount, m_sync->m_pyPeer,
+                    timeout_us);
+  };
+
+  /**
+   * Like CppRecvBegin, but returns false right away if Python has not
+   * replied yet
+   */
+  bool CppTryRecvBegin() {
+    CppAttach();
+    return Ns3penvSemaphore::sem_try_wait(&m_sync->m_py2cpp.m_fullCount);
   };
 
   /**
@@ -193,18 +576,21 @@ public:
    * or vector-based
    */
   void CppRecvEnd() {
-    Ns3penvSemaphore::sem_post(&m_sync->m_py2cppEmptyCount);
+    Beat(m_sync->m_cppPeer);
+    Ns3penvSemaphore::sem_post(&m_sync->m_py2cpp.m_emptyCount);
   };
 
   /**
    * C++ side sets the overall status to finished when
-   * the simulation is over
+   * the simulation is over, unless Python is already gone
    */
   void CppSetFinished() {
     assert(m_handleFinish);
     m_isFinished = true;
-    CppSendBegin();
-    m_sync->m_isFinished = true;
+    if (CppSendBeginFor(NS3PENV_WAIT_FOREVER) != Ns3penvWaitStatus::OK) {
+      return;
+    }
+    m_sync->m_isFinished.store(true, std::memory_order_relaxed);
     CppSendEnd();
   };
 
@@ -215,31 +601,138 @@ public:
    * or vector-based
    */
   void PyRecvBegin() {
-    Ns3penvSemaphore::sem_wait(&m_sync->m_cpp2pyFullCount);
+    PyAttach();
+    Ns3penvSemaphore::sem_wait(&m_sync->m_cpp2py.m_fullCount, m_waitMode,
+                               m_spinBudget);
     if (m_handleFinish) {
-      m_isFinished = m_sync->m_isFinished;
+      m_isFinished = m_sync->m_isFinished.load(std::memory_order_relaxed);
+    }
+  };
+
+  /**
+   * Like PyRecvBegin, but gives up after timeout_us microseconds, or as
+   * soon as the simulation process is found gone. Reading may start only
+   * on OK.
+   */
+  Ns3penvWaitStatus PyRecvBeginFor(uint64_t timeout_us) {
+    PyAttach();
+    Ns3penvWaitStatus status = WaitPeer(&m_sync->m_cpp2py.m_fullCount,
+                                        m_sync->m_cppPeer, timeout_us);
+    if (status == Ns3penvWaitStatus::OK && m_handleFinish) {
+      m_isFinished = m_sync->m_isFinished.load(std::memory_order_relaxed);
     }
+    return status;
   };
 
   /**
    * Python side stops reading from shared memory, struct-based
    * or vector-based
    */
-  void PyRecvEnd() { Ns3penvSemaphore::sem_post(&m_sync->m_cpp2pyEmptyCount); };
+  void PyRecvEnd() {
+    Beat(m_sync->m_pyPeer);
+    Ns3penvSemaphore::sem_post(&m_sync->m_cpp2py.m_emptyCount);
+  };
 
   /**
    * Python side starts writing into shared memory, struct-based
    * or vector-based
    */
   void PySendBegin() {
-    Ns3penvSemaphore::sem_wait(&m_sync->m_py2cppEmptyCount);
+    PyAttach();
+    Ns3penvSemaphore::sem_wait(&m_sync->m_py2cpp.m_emptyCount, m_waitMode,
+                               m_spinBudget);
+  };
+
+  /**
+   * Like PySendBegin, but gives up after timeout_us microseconds, or as
+   * soon as the simulation process is found gone. Writing may start only
+   * on OK.
+   */
+  Ns3penvWaitStatus PySendBeginFor(uint64_t timeout_us) {
+    PyAttach();
+    return WaitPeer(&m_sync->m_py2cpp.m_emptyCount, m_sync->m_cppPeer,
+                    timeout_us);
   };
 
   /**
    * Python side stops writing into shared memory, struct-based
    * or vector-based
    */
-  void PySendEnd() { Ns3penvSemaphore::sem_post(&m_sync->m_py2cppFullCount); };
+  void PySendEnd() {
+    Beat(m_sync->m_pyPeer);
+    Ns3penvSemaphore::sem_post(&m_sync->m_py2cpp.m_fullCount);
+  };
+
+  /**
+   * Python side gives up writing after PySendBegin, e.g. when the message
+   * does not fit, so that the next PySendBegin does not wait forever.
+   * Nothing is sent.
+   */
+  void PySendCancel() {
+    Ns3penvSemaphore::sem_post(&m_sync->m_py2cpp.m_emptyCount);
+  };
+
+  /**
+   * Gets the hash of the spaces the Python side already knows, 0 if none
+   */
+  uint64_t GetSpaceHash() const {
+    return m_sync->m_spaceHash.load(std::memory_order_relaxed);
+  };
+
+  /**
+   * Python side records the hash of the spaces it has received
+   */
+  void PySetSpaceHash(uint64_t hash) {
+    m_sync->m_spaceHash.store(hash, std::memory_order_relaxed);
+  };
+
+  /**
+   * Gets how often a process attached to either side of the segment
+   */
+  uint32_t GetEpoch() const {
+    return m_sync->m_epoch.load(std::memory_order_relaxed);
+  };
+
+  /**
+   * Gets the number of messages the C++ side has handed over
+   */
+  uint64_t GetCppHeartbeat() const {
+    return m_sync->m_cppPeer.m_heartbeat.load(std::memory_order_relaxed);
+  };
+
+  /**
+   * Gets the number of messages the Python side has handed over
+   */
+  uint64_t GetPyHeartbeat() const {
+    return m_sync->m_pyPeer.m_heartbeat.load(std::memory_order_relaxed);
+  };
+
+  /**
+   * C++ side gets whether the Python process may still be running
+   */
+  bool CppIsPeerAlive() const {
+    return Ns3penvProcessAlive(
+        m_sync->m_pyPeer.m_pid.load(std::memory_order_relaxed),
+        m_sync->m_pyPeer.m_pidNamespace.load(std::memory_order_relaxed));
+  };
+
+  /**
+   * Python side gets whether the simulation process may still be running
+   */
+  bool PyIsPeerAlive() const {
+    return Ns3penvProcessAlive(
+        m_sync->m_cppPeer.m_pid.load(std::memory_order_relaxed),
+        m_sync->m_cppPeer.m_pidNamespace.load(std::memory_order_relaxed));
+  };
+
+  /**
+   * Python side forgets the simulation process it talked to, before
+   * starting another one on the same segment, so that the bounded waits
+   * do not take the exited one for a crash
+   */
+  void PyForgetPeer() {
+    m_sync->m_cppPeer.m_pid.store(0, std::memory_order_relaxed);
+  };
 
   /**
    * Python side gets whether the simulation is over
@@ -253,7 +746,145 @@ public:
     boost::interprocess::shared_memory_object::remove(m_segName.c_str());
   };
 
+  /**
+   * Gets whether this interface is a slot of a batched segment
+   */
+  bool IsBatchSlot() const { return m_batchReady != nullptr; };
+
 private:
+  /**
+   * Records this process as the C++ side on the first wait. The side of an
+   * instance is only known once it uses the Cpp or Py calls.
+   */
+  void CppAttach() {
+    if (m_self == nullptr) {
+      Attach(&m_sync->m_cppPeer);
+    }
+  };
+
+  /**
+   * Records this process as the Python side on the first wait
+   */
+  void PyAttach() {
+    if (m_self == nullptr) {
+      Attach(&m_sync->m_pyPeer);
+    }
+  };
+
+  void Attach(Ns3penvMsgPeer *self) {
+    m_self = self;
+#if defined(__unix__) || defined(__APPLE__)
+    self->m_pidNamespace.store(Ns3penvPidNamespace(),
+                               std::memory_order_relaxed);
+    self->m_pid.store(getpid(), std::memory_order_relaxed);
+#endif
+    m_sync->m_epoch.fetch_add(1, std::memory_order_relaxed);
+  };
+
+  /**
+   * Clears the record of this process, unless another one took its place,
+   * e.g. the parent of a forked process that drops its mapping
+   */
+  void Detach() {
+#if defined(__unix__) || defined(__APPLE__)
+    if (m_self != nullptr) {
+      int32_t pid = getpid();
+      m_self->m_pid.compare_exchange_strong(pid, 0,
+                                            std::memory_order_relaxed);
+    }
+#endif
+    m_self = nullptr;
+  };
+
+  static void Beat(Ns3penvMsgPeer &self) {
+    // only this side writes it
+    self.m_heartbeat.store(
+        self.m_heartbeat.load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+  };
+
+  /**
+   * Waits on sem for at most timeout_us microseconds, checking between
+   * slices of NS3PENV_LIVENESS_INTERVAL_US that the process of peer still
+   * runs. A peer found gone is forgotten, so that the next process to
+   * attach on its side starts afresh.
+   */
+  Ns3penvWaitStatus WaitPeer(Ns3penvSemaphoreWord *sem, Ns3penvMsgPeer &peer,
+                             uint64_t timeout_us) {
+    if (Ns3penvSemaphore::sem_try_wait(sem)) {
+      return Ns3penvWaitStatus::OK;
+    }
+    uint64_t left_us = timeout_us;
+    while (true) {
+      uint64_t slice_us =
+          std::min<uint64_t>(left_us, NS3PENV_LIVENESS_INTERVAL_US);
+      if (Ns3penvSemaphore::sem_wait_for(sem, m_waitMode, m_spinBudget,
+                                         slice_us)) {
+        return Ns3penvWaitStatus::OK;
+      }
+      int32_t pid = peer.m_pid.load(std::memory_order_relaxed);
+      if (!Ns3penvProcessAlive(
+              pid, peer.m_pidNamespace.load(std::memory_order_relaxed))) {
+        peer.m_pid.compare_exchange_strong(pid, 0, std::memory_order_relaxed);
+        // what it posted right before exiting still counts
+        return Ns3penvSemaphore::sem_try_wait(sem)
+                   ? Ns3penvWaitStatus::OK
+                   : Ns3penvWaitStatus::PEER_GONE;
+      }
+      if (timeout_us != NS3PENV_WAIT_FOREVER) {
+        left_us -= slice_us;
+        if (left_us == 0) {
+          return Ns3penvWaitStatus::TIMEOUT;
+        }
+      }
+    }
+  };
+
+  /**
+   * Attaches to one slot of a batched segment created by
+   * Ns3penvBatchMsgInterfaceImpl, where the messages of this side are the
+   * elements at index slot of the message vectors
+   */
+  void OpenBatchSlot(int32_t slot, const char *cpp2py_msg_name,
+                     const char *py2cpp_msg_name, const char *lockable_name) {
+    Ns3penvBatchSync *batch =
+        m_segment.find<Ns3penvBatchSync>(lockable_name).first;
+    if (batch == nullptr || batch->m_version != NS3PENV_MSG_SYNC_VERSION) {
+      throw std::runtime_error(
+          "ns3penv: no batched segment of this version named " + m_segName);
+    }
+    if (uint32_t(slot) >= batch->m_numSlots) {
+      throw std::runtime_error("ns3penv: slot " + std::to_string(slot) +
+                               " out of range in batched segment " +
+                               m_segName + " of " +
+                               std::to_string(batch->m_numSlots) + " slots");
+    }
+    std::string slotsName = Ns3penvBatchSlotsName(lockable_name);
+    Ns3penvBatchSlot *slots =
+        m_segment.find<Ns3penvBatchSlot>(slotsName.c_str()).first;
+    Cpp2PyMsgVector *cpp2py =
+        m_segment.find<Cpp2PyMsgVector>(cpp2py_msg_name).first;
+    Py2CppMsgVector *py2cpp =
+        m_segment.find<Py2CppMsgVector>(py2cpp_msg_name).first;
+    m_cpp2pyVector = nullptr;
+    m_py2cppVector = nullptr;
+    m_cpp2pyStruct = &(*cpp2py)[slot];
+    m_py2CppStruct = &(*py2cpp)[slot];
+    m_sync = &slots[slot].m_sync;
+    m_slotReady = &slots[slot].m_ready;
+    m_batchReady = &batch->m_readyCount;
+  };
+
+  static std::string RingName(const char *msg_name) {
+    return std::string(msg_name) + " Ring";
+  };
+
+  static std::string RingDataName(const char *msg_name) {
+    return std::string(msg_name) + " Ring Data";
+  };
+
+  // owned per instance, so that one process can map several segments
+  boost::interprocess::managed_shared_memory m_segment;
   Cpp2PyMsgType *m_cpp2pyStruct;
   Py2CppMsgType *m_py2CppStruct;
   Cpp2PyMsgVector *m_cpp2pyVector;
@@ -264,15 +895,49 @@ private:
   const bool m_useVector;
   const bool m_handleFinish;
   std::string m_segName;
+  std::string m_statsName;
   bool m_isFinished;
+  Ns3penvWaitMode m_waitMode;
+  uint32_t m_spinBudget;
+  Ns3penvMsgPeer *m_self; // the side of this process, once it waited
+  boost::interprocess::managed_shared_memory::segment_manager
+      *m_segmentManager;
+  std::atomic<uint32_t> *m_slotReady;
+  Ns3penvSemaphoreWord *m_batchReady;
+  Ns3penvRingHeader *m_cpp2pyRing;
+  uint8_t *m_cpp2pyRingData;
+  Ns3penvRingHeader *m_py2cppRing;
+  uint8_t *m_py2cppRingData;
 };
 
 /**
  * \brief The message interface, a singleton class
+ *
+ * Get() returns the process-wide instance. Further instances can be created
+ * directly, each holding the settings and the impl of its own segment.
  */
 
 class Ns3penvMsgInterface : public Singleton<Ns3penvMsgInterface> {
 public:
+  /**
+   * Copies the settings (not the impl) of another instance, e.g. to start
+   * from what was configured on the process-wide one
+   */
+  void CopySettings(const Ns3penvMsgInterface &other) {
+    this->m_isMemoryCreator = other.m_isMemoryCreator;
+    this->m_useVector = other.m_useVector;
+    this->m_handleFinish = other.m_handleFinish;
+    this->m_size = other.m_size;
+    this->m_segmentName = other.m_segmentName;
+    this->m_cpp2pyMsgName = other.m_cpp2pyMsgName;
+    this->m_py2cppMsgName = other.m_py2cppMsgName;
+    this->m_lockableName = other.m_lockableName;
+    this->m_waitMode = other.m_waitMode;
+    this->m_spinBudget = other.m_spinBudget;
+    this->m_ringSlots = other.m_ringSlots;
+    this->m_batchSlot = other.m_batchSlot;
+  };
+
   /**
    * Sets if this side (C++ or Python) is the memory creator.
    * Configuration on two sides must be different
@@ -287,6 +952,25 @@ public:
    */
   void SetUseVector(bool useVector) { this->m_useVector = useVector; };
 
+  /**
+   * Sets if the memory creator also sets up a ring of ringSlots records
+   * per direction, for non-blocking TrySend/TryRecv next to the struct or
+   * vector interface. Only valid for the shared memory creator, the other
+   * side finds the rings in the segment.
+   */
+  void SetUseRing(bool useRing, uint32_t ringSlots = 8) {
+    this->m_ringSlots = useRing ? ringSlots : 0;
+  };
+
+  /**
+   * Sets the slot of a batched segment this side uses, or -1 (the default)
+   * for a segment of its own. The batched segment, with its message
+   * vectors and slot array, is created on the Python side by
+   * Ns3penvBatchMsgInterfaceImpl under the names set with SetNames. Only
+   * valid for the side that is not the memory creator.
+   */
+  void SetBatchSlot(int32_t batchSlot) { this->m_batchSlot = batchSlot; };
+
   /**
    * Sets if both C++ and Python sides handle finish. Configuration on
    * two sides must be same
@@ -302,6 +986,17 @@ public:
    */
   void SetMemorySize(uint32_t size) { this->m_size = size; };
 
+  /**
+   * Sets how this side waits for the other one: pure spinning (the
+   * default), spinning then yielding, or spinning then sleeping on a
+   * futex. The spin budget is the number of attempts before giving up
+   * the core. Must be set before the first GetInterface call.
+   */
+  void SetWaitMode(Ns3penvWaitMode waitMode, uint32_t spinBudget = 4096) {
+    this->m_waitMode = waitMode;
+    this->m_spinBudget = spinBudget;
+  };
+
   /**
    * Sets the names of the named objects. See Boost's
    * documentation for details. Normally the default
@@ -317,19 +1012,31 @@ public:
 
   /**
    * Gets the impl which has semaphore (synchronization)
-   * methods
+   * methods. It is created with the current settings on the first call,
+   * and every call on the same instance must use the same message types.
    */
   template <typename Cpp2PyMsgType, typename Py2CppMsgType>
   Ns3penvMsgInterfaceImpl<Cpp2PyMsgType, Py2CppMsgType> *GetInterface() {
-    static Ns3penvMsgInterfaceImpl<Cpp2PyMsgType, Py2CppMsgType> interface(
-        this->m_isMemoryCreator, this->m_useVector, this->m_handleFinish,
-        this->m_size, this->m_segmentName.c_str(),
-        this->m_cpp2pyMsgName.c_str(), this->m_py2cppMsgName.c_str(),
-        this->m_lockableName.c_str());
-    return &interface;
+    typedef Ns3penvMsgInterfaceImpl<Cpp2PyMsgType, Py2CppMsgType> Impl;
+    if (!m_impl) {
+      m_impl = std::make_shared<Impl>(
+          this->m_isMemoryCreator, this->m_useVector, this->m_handleFinish,
+          this->m_size, this->m_segmentName.c_str(),
+          this->m_cpp2pyMsgName.c_str(), this->m_py2cppMsgName.c_str(),
+          this->m_lockableName.c_str(), this->m_waitMode, this->m_spinBudget,
+          this->m_ringSlots, this->m_batchSlot);
+      m_implType = &typeid(Impl);
+    } else if (*m_implType != typeid(Impl)) {
+      throw std::logic_error("ns3penv: interface of segment " +
+                             m_segmentName +
+                             " requested with different message types");
+    }
+    return static_cast<Impl *>(m_impl.get());
   };
 
 private:
+  std::shared_ptr<void> m_impl;
+  const std::type_info *m_implType = nullptr;
   bool m_isMemoryCreator;
   bool m_useVector;
   bool m_handleFinish;
@@ -338,6 +1045,10 @@ private:
   std::string m_cpp2pyMsgName = "My Cpp to Python Msg";
   std::string m_py2cppMsgName = "My Python to Cpp Msg";
   std::string m_lockableName = "My Lockable";
+  Ns3penvWaitMode m_waitMode = Ns3penvWaitMode::SPIN;
+  uint32_t m_spinBudget = 4096;
+  uint32_t m_ringSlots = 0;
+  int32_t m_batchSlot = -1;
 };
 
 } // namespace ns3
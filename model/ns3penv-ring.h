@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#ifndef NS3PENV_RING_H
+#define NS3PENV_RING_H
+
+#include "ns3penv-semaphore.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * \brief Header of a single-producer single-consumer byte ring living in
+ * shared memory
+ *
+ * Head and tail are monotonic byte counters owned by the producer and the
+ * consumer respectively, each on its own cache line. The data area is a
+ * separate named array of m_capacity bytes. The producer also moves the
+ * tail of an empty ring, which the consumer is not using then.
+ */
+struct Ns3penvRingHeader {
+  alignas(NS3PENV_CACHE_LINE_SIZE) std::atomic<uint64_t> m_head{0};
+  alignas(NS3PENV_CACHE_LINE_SIZE) std::atomic<uint64_t> m_tail{0};
+  alignas(NS3PENV_CACHE_LINE_SIZE) uint32_t m_capacity;
+
+  explicit Ns3penvRingHeader(uint32_t capacity) : m_capacity(capacity) {}
+};
+
+/**
+ * \brief Structure providing ring operations
+ *
+ * Records are a 32-bit length followed by the payload, padded to 8 bytes.
+ * A record never straddles the end of the data area: when it does not
+ * fit, the producer writes a wrap marker and starts over at offset 0. An
+ * empty ring starts over at offset 0 without a marker, so it takes any
+ * record that fits the capacity.
+ */
+struct Ns3penvRing {
+  static constexpr uint32_t RECORD_ALIGN = 8;
+  static constexpr uint32_t WRAP_MARKER = 0xFFFFFFFF;
+
+  static inline uint32_t record_size(uint32_t size) {
+    return (sizeof(uint32_t) + size + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1);
+  }
+
+  /**
+   * Capacity of a ring holding at least slots records of slot_size bytes
+   */
+  static inline uint32_t capacity_for(uint32_t slots, uint32_t slot_size) {
+    return slots * record_size(slot_size);
+  }
+
+  /**
+   * Appends one record. Returns false without blocking if the ring does
+   * not have room for it right now.
+   */
+  static inline bool try_push(Ns3penvRingHeader *hdr, uint8_t *data,
+                              const void *src, uint32_t size) {
+    const uint64_t cap = hdr->m_capacity;
+    if (size >= cap) {
+      return false;
+    }
+    const uint64_t rec = record_size(size);
+    if (rec > cap) {
+      return false;
+    }
+    uint64_t head = hdr->m_head.load(std::memory_order_relaxed);
+    uint64_t tail = hdr->m_tail.load(std::memory_order_acquire);
+    uint64_t pos = head % cap;
+    uint64_t contiguous = cap - pos;
+    if (contiguous < rec && head == tail) {
+      // the consumer waits for the head to move, which publishes the tail
+      head += contiguous;
+      tail = head;
+      hdr->m_tail.store(tail, std::memory_order_relaxed);
+      pos = 0;
+      contiguous = cap;
+    }
+    uint64_t need = contiguous < rec ? contiguous + rec : rec;
+    if (head - tail + need > cap) {
+      return false;
+    }
+    if (contiguous < rec) {
+      uint32_t marker = WRAP_MARKER;
+      std::memcpy(data + pos, &marker, sizeof(marker));
+      head += contiguous;
+      pos = 0;
+    }
+    std::memcpy(data + pos, &size, sizeof(size));
+    std::memcpy(data + pos + sizeof(size), src, size);
+    hdr->m_head.store(head + rec, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Hands the oldest record to consume(const uint8_t *, uint32_t) and
+   * releases it afterwards. Returns false if the ring is empty.
+   */
+  template <typename F>
+  static inline bool try_pop(Ns3penvRingHeader *hdr, const uint8_t *data,
+                             F &&consume) {
+    const uint64_t cap = hdr->m_capacity;
+    // the head first: a moved head comes with the tail the producer set
+    uint64_t head = hdr->m_head.load(std::memory_order_acquire);
+    uint64_t tail = hdr->m_tail.load(std::memory_order_relaxed);
+    if (tail == head) {
+      return false;
+    }
+    uint64_t pos = tail % cap;
+    uint32_t size;
+    std::memcpy(&size, data + pos, sizeof(size));
+    if (size == WRAP_MARKER) {
+      tail += cap - pos;
+      pos = 0;
+      std::memcpy(&size, data, sizeof(size));
+    }
+    consume(data + pos + sizeof(size), size);
+    hdr->m_tail.store(tail + record_size(size), std::memory_order_release);
+    return true;
+  }
+};
+
+#endif // NS3PENV_RING_H
@@ -20,7 +20,64 @@
 #ifndef NS3PENV_SEMAPHORE_H
 #define NS3PENV_SEMAPHORE_H
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Size of the cache line used to keep the two directions of the message
+ * interface apart (Apple silicon uses 128-byte lines)
+ */
+#if defined(__APPLE__) && defined(__aarch64__)
+#define NS3PENV_CACHE_LINE_SIZE 128
+#else
+#define NS3PENV_CACHE_LINE_SIZE 64
+#endif
+
+/**
+ * Timeout of the timed waits meaning no timeout at all
+ */
+#define NS3PENV_WAIT_FOREVER UINT64_MAX
+
+/**
+ * \brief Policy used by a side that has to wait on a semaphore
+ *
+ * SPIN burns the core until the other side posts. SPIN_YIELD spins for
+ * the spin budget and then yields the core to the scheduler between
+ * attempts. SPIN_FUTEX spins for the spin budget and then parks the
+ * thread in the kernel until the poster wakes it up (Linux only, falls
+ * back to SPIN_YIELD elsewhere).
+ */
+enum class Ns3penvWaitMode : uint8_t {
+  SPIN = 0,
+  SPIN_YIELD = 1,
+  SPIN_FUTEX = 2,
+};
+
+/**
+ * \brief A counting semaphore living in shared memory
+ *
+ * The counter doubles as the futex word. m_waiters counts the parked
+ * waiters so that a poster only enters the kernel when somebody is
+ * actually sleeping.
+ */
+struct Ns3penvSemaphoreWord {
+  std::atomic<uint32_t> m_count;
+  std::atomic<uint32_t> m_waiters{0};
+
+  explicit Ns3penvSemaphoreWord(uint32_t count) : m_count(count) {}
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "shared memory semaphores need lock-free 32-bit atomics");
 
 /**
  * \brief Structure providing semaphore operations
@@ -28,47 +85,146 @@
 struct Ns3penvSemaphore {
   explicit Ns3penvSemaphore() = default;
 
-  static inline uint8_t atomic_read8(const volatile uint8_t *mem) {
-    uint8_t old_val = *mem;
-    __sync_synchronize();
-    return old_val;
-  }
-
-  static inline uint8_t atomic_cas8(volatile uint8_t *mem, uint8_t with,
-                                    uint8_t cmp) {
-    return __sync_val_compare_and_swap(const_cast<uint8_t *>(mem), cmp, with);
+  /**
+   * Sleeps while *addr equals expected, at most timeout_us microseconds
+   * unless it is NS3PENV_WAIT_FOREVER
+   */
+  static inline void futex_wait(std::atomic<uint32_t> *addr, uint32_t expected,
+                                uint64_t timeout_us = NS3PENV_WAIT_FOREVER) {
+#if defined(__linux__)
+    struct timespec timeout;
+    struct timespec *timeout_ptr = nullptr;
+    if (timeout_us != NS3PENV_WAIT_FOREVER) {
+      timeout.tv_sec = timeout_us / 1000000;
+      timeout.tv_nsec = (timeout_us % 1000000) * 1000;
+      timeout_ptr = &timeout;
+    }
+    // not FUTEX_PRIVATE: the word is shared between processes
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAIT,
+            expected, timeout_ptr, nullptr, 0);
+#else
+    (void)addr;
+    (void)expected;
+    (void)timeout_us;
+    std::this_thread::yield();
+#endif
   }
 
-  static inline uint8_t atomic_add8(volatile uint8_t *mem, uint8_t val) {
-    return __sync_fetch_and_add(const_cast<uint8_t *>(mem), val);
+  static inline void futex_wake(std::atomic<uint32_t> *addr) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAKE,
+            INT32_MAX, nullptr, nullptr, 0);
+#else
+    (void)addr;
+#endif
   }
 
-  static inline bool atomic_add_unless8(volatile uint8_t *mem, uint8_t value,
-                                        uint8_t unless_this) {
-    uint8_t old;
-    uint8_t c(atomic_read8(mem));
-    while (c != unless_this && (old = atomic_cas8(mem, c + value, c)) != c) {
-      c = old;
+  /**
+   * Decrements the counter unless it is zero. Acquire on success, so the
+   * data published before the matching post is visible.
+   */
+  static inline bool sem_try_wait(Ns3penvSemaphoreWord *sem) {
+    uint32_t c = sem->m_count.load(std::memory_order_relaxed);
+    while (c != 0) {
+      if (sem->m_count.compare_exchange_weak(c, c - 1,
+                                             std::memory_order_acquire,
+                                             std::memory_order_relaxed)) {
+        return true;
+      }
     }
-    return c != unless_this;
+    return false;
   }
 
-  static inline bool sem_try_wait(volatile uint8_t *mem) {
-    return atomic_add_unless8(mem, -1, 0);
+  /**
+   * Waits according to the given policy. The first attempt is a single
+   * CAS; the slow path spins for spin_budget attempts before yielding
+   * or parking on the counter.
+   */
+  static inline void sem_wait(Ns3penvSemaphoreWord *sem,
+                              Ns3penvWaitMode mode = Ns3penvWaitMode::SPIN,
+                              uint32_t spin_budget = 0) {
+    sem_wait_for(sem, mode, spin_budget, NS3PENV_WAIT_FOREVER);
   }
 
-  static inline void sem_wait(volatile uint8_t *mem) {
-    if (!sem_try_wait(mem)) {
-      do {
-        if (sem_try_wait(mem)) {
-          break;
+  /**
+   * Like sem_wait, but gives up after timeout_us microseconds. Returns
+   * whether the semaphore was acquired. The clock is only read on the slow
+   * path, and every few hundred attempts while spinning.
+   */
+  static inline bool sem_wait_for(Ns3penvSemaphoreWord *sem,
+                                  Ns3penvWaitMode mode, uint32_t spin_budget,
+                                  uint64_t timeout_us) {
+    if (sem_try_wait(sem)) {
+      return true;
+    }
+    typedef std::chrono::steady_clock Clock;
+    const bool timed = timeout_us != NS3PENV_WAIT_FOREVER;
+    const Clock::time_point deadline =
+        timed ? Clock::now() + std::chrono::microseconds(timeout_us)
+              : Clock::time_point::max();
+    auto expired = [&]() { return timed && Clock::now() >= deadline; };
+    if (mode == Ns3penvWaitMode::SPIN) {
+      for (uint32_t i = 1;; ++i) {
+        if (sem_try_wait(sem)) {
+          return true;
         }
-      } while (true);
+        if (i % 256 == 0 && expired()) {
+          return false;
+        }
+      }
+    }
+    for (uint32_t i = 0; i < spin_budget; ++i) {
+      if (sem_try_wait(sem)) {
+        return true;
+      }
+    }
+    while (true) {
+      if (mode == Ns3penvWaitMode::SPIN_YIELD) {
+        std::this_thread::yield();
+        if (sem_try_wait(sem)) {
+          return true;
+        }
+        if (expired()) {
+          return false;
+        }
+        continue;
+      }
+      uint64_t left_us = NS3PENV_WAIT_FOREVER;
+      if (timed) {
+        Clock::time_point now = Clock::now();
+        if (now >= deadline) {
+          return false;
+        }
+        left_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                      deadline - now)
+                      .count() +
+                  1;
+      }
+      // announce ourselves before the last check; together with the fence
+      // in sem_post either the poster sees the waiter or we see its post
+      sem->m_waiters.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (sem->m_count.load(std::memory_order_relaxed) == 0) {
+        futex_wait(&sem->m_count, 0, left_us);
+      }
+      sem->m_waiters.fetch_sub(1, std::memory_order_relaxed);
+      if (sem_try_wait(sem)) {
+        return true;
+      }
     }
   }
 
-  static inline uint8_t sem_post(volatile uint8_t *mem) {
-    return atomic_add8(mem, 1);
+  /**
+   * Increments the counter with release semantics and wakes the other
+   * side only if it is parked
+   */
+  static inline uint32_t sem_post(Ns3penvSemaphoreWord *sem) {
+    uint32_t old_val = sem->m_count.fetch_add(1, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sem->m_waiters.load(std::memory_order_relaxed) != 0) {
+      futex_wake(&sem->m_count);
+    }
+    return old_val;
   }
 };
 
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#ifndef NS3PENV_STATS_H
+#define NS3PENV_STATS_H
+
+#include "ns3penv-semaphore.h"
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+
+/**
+ * Layout version of Ns3penvStats, bumped whenever it changes
+ */
+#define NS3PENV_STATS_VERSION 2
+
+/**
+ * Each power of two is split into 2^NS3PENV_HISTOGRAM_SUB_BITS buckets, so
+ * a recorded value is known to within about 6%
+ */
+#define NS3PENV_HISTOGRAM_SUB_BITS 4
+#define NS3PENV_HISTOGRAM_BUCKETS                                              \
+  ((64 - NS3PENV_HISTOGRAM_SUB_BITS + 1) << NS3PENV_HISTOGRAM_SUB_BITS)
+
+/**
+ * \brief Phases of a step of the gym interface, timed in nanoseconds
+ */
+enum Ns3penvStepPhase : uint32_t {
+  NS3PENV_PHASE_OBSERVE = 0,     //!< observation, reward, game over, info
+  NS3PENV_PHASE_BUILD = 1,       //!< filling the EnvStateMsg
+  NS3PENV_PHASE_WAIT_EMPTY = 2,  //!< waiting for Python to free the buffer
+  NS3PENV_PHASE_SERIALIZE = 3,   //!< writing the state into the buffer
+  NS3PENV_PHASE_WAIT_ACTION = 4, //!< waiting for the action
+  NS3PENV_PHASE_PARSE = 5,       //!< parsing the EnvActMsg
+  NS3PENV_PHASE_DECODE = 6,      //!< filling the action containers
+  NS3PENV_PHASE_EXECUTE = 7,     //!< the ExecuteActions callback
+  NS3PENV_NUM_PHASES = 8,
+};
+
+/**
+ * \brief Counts of a log-linear histogram living in shared memory
+ *
+ * Written by one side and read by any number of others, all through
+ * relaxed atomics, so readers may see the fields of a value being recorded
+ * partly updated.
+ */
+struct Ns3penvHistogramCounts {
+  std::atomic<uint64_t> m_count{0};
+  std::atomic<uint64_t> m_sum{0};
+  std::atomic<uint64_t> m_min{UINT64_MAX};
+  std::atomic<uint64_t> m_max{0};
+  std::atomic<uint64_t> m_buckets[NS3PENV_HISTOGRAM_BUCKETS]{};
+};
+
+/**
+ * \brief Structure providing histogram operations
+ */
+struct Ns3penvHistogram {
+  static constexpr uint32_t SUB_BUCKETS = 1U << NS3PENV_HISTOGRAM_SUB_BITS;
+
+  /**
+   * Values below SUB_BUCKETS have a bucket each, larger ones share a
+   * bucket with the values of the same leading SUB_BITS + 1 bits
+   */
+  static inline uint32_t bucket_of(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+      return value;
+    }
+    uint32_t exponent = 63 - std::countl_zero(value);
+    uint32_t shift = exponent - NS3PENV_HISTOGRAM_SUB_BITS;
+    uint32_t sub = (value >> shift) & (SUB_BUCKETS - 1);
+    return (shift + 1) * SUB_BUCKETS + sub;
+  }
+
+  /**
+   * Gets the smallest value of a bucket
+   */
+  static inline uint64_t bucket_low(uint32_t bucket) {
+    if (bucket < SUB_BUCKETS) {
+      return bucket;
+    }
+    uint32_t shift = bucket / SUB_BUCKETS - 1;
+    return uint64_t(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+  }
+
+  /**
+   * Gets the largest value of a bucket
+   */
+  static inline uint64_t bucket_high(uint32_t bucket) {
+    if (bucket + 1 >= NS3PENV_HISTOGRAM_BUCKETS) {
+      return UINT64_MAX;
+    }
+    return bucket_low(bucket + 1) - 1;
+  }
+
+  /**
+   * Adds a value, only from the side owning the histogram
+   */
+  static inline void record(Ns3penvHistogramCounts *h, uint64_t value) {
+    h->m_buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+    h->m_sum.fetch_add(value, std::memory_order_relaxed);
+    if (value < h->m_min.load(std::memory_order_relaxed)) {
+      h->m_min.store(value, std::memory_order_relaxed);
+    }
+    if (value > h->m_max.load(std::memory_order_relaxed)) {
+      h->m_max.store(value, std::memory_order_relaxed);
+    }
+    h->m_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Gets the value below which the fraction q of the recorded values lie,
+   * as the largest value of its bucket but at most the maximum, or 0 if
+   * nothing was recorded
+   */
+  static inline uint64_t percentile(const Ns3penvHistogramCounts *h,
+                                    double q) {
+    uint64_t total = 0;
+    for (const auto &bucket : h->m_buckets) {
+      total += bucket.load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+      return 0;
+    }
+    uint64_t rank = q <= 0 ? 1 : q >= 1 ? total : uint64_t(q * total + 0.5);
+    rank = rank == 0 ? 1 : rank;
+    uint64_t seen = 0;
+    uint64_t max = h->m_max.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < NS3PENV_HISTOGRAM_BUCKETS; ++i) {
+      seen += h->m_buckets[i].load(std::memory_order_relaxed);
+      if (seen >= rank) {
+        return bucket_high(i) < max ? bucket_high(i) : max;
+      }
+    }
+    return max;
+  }
+
+  static inline void clear(Ns3penvHistogramCounts *h) {
+    for (auto &bucket : h->m_buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+    h->m_count.store(0, std::memory_order_relaxed);
+    h->m_sum.store(0, std::memory_order_relaxed);
+    h->m_min.store(UINT64_MAX, std::memory_order_relaxed);
+    h->m_max.store(0, std::memory_order_relaxed);
+  }
+};
+
+/**
+ * \brief Step statistics of one simulation, a named object of its segment
+ *
+ * The C++ side creates and fills it when step statistics are enabled, the
+ * Python side only reads it.
+ */
+struct Ns3penvStats {
+  alignas(NS3PENV_CACHE_LINE_SIZE) uint32_t m_version{NS3PENV_STATS_VERSION};
+  uint32_t m_numPhases{NS3PENV_NUM_PHASES};
+  Ns3penvHistogramCounts m_phases[NS3PENV_NUM_PHASES];
+  Ns3penvHistogramCounts m_stateSize;  //!< bytes sent to Python per step
+  Ns3penvHistogramCounts m_actionSize; //!< bytes received per step
+  std::atomic<uint64_t> m_actionsClipped{0}; //!< action values clamped
+  std::atomic<uint64_t> m_observationsReplaced{0}; //!< non-finite obs values
+};
+
+#endif // NS3PENV_STATS_H
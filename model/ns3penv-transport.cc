@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#include "ns3penv-transport.h"
+
+#include <ns3/abort.h>
+#include <ns3/log.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <thread>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("Ns3penvSocketTransport");
+
+/** Bytes asked of recv at least, so small frames come in together */
+static constexpr std::size_t RECV_CHUNK = 64 * 1024;
+
+/** Writes all of iov, aborting if the connection is lost */
+static void WriteVectors(int fd, iovec *iov, int count) {
+  while (count > 0) {
+    msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    ssize_t written = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    if (written < 0) {
+      NS_ABORT_MSG_IF(errno != EINTR,
+                      "Lost the agent connection: " << std::strerror(errno));
+      continue;
+    }
+    // skip what was written, resuming inside a partly written vector
+    while (count > 0 && std::size_t(written) >= iov->iov_len) {
+      written -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    if (count > 0) {
+      iov->iov_base = static_cast<uint8_t *>(iov->iov_base) + written;
+      iov->iov_len -= written;
+    }
+  }
+}
+
+Ns3penvSocketTransport::Ns3penvSocketTransport(const std::string &address,
+                                               uint32_t batchBytes,
+                                               uint32_t timeoutMs)
+    : m_fd(-1), m_closed(false), m_batchBytes(batchBytes), m_spaceHash(0), m_inStart(0),
+      m_consumed(0) {
+  NS_LOG_FUNCTION(this << address);
+  const std::string scheme = "tcp://";
+  std::size_t colon = address.rfind(':');
+  NS_ABORT_MSG_IF(address.compare(0, scheme.size(), scheme) != 0 ||
+                      colon == std::string::npos || colon < scheme.size(),
+                  "Transport address " << address
+                                       << " is not of the form tcp://host:port");
+  std::string host = address.substr(scheme.size(), colon - scheme.size());
+  std::string port = address.substr(colon + 1);
+  if (host.size() > 1 && host.front() == '[' && host.back() == ']') {
+    host = host.substr(1, host.size() - 2);
+  }
+
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *addresses = nullptr;
+  int error = getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses);
+  NS_ABORT_MSG_IF(error != 0,
+                  "Cannot resolve " << address << ": " << gai_strerror(error));
+
+  // the agent may still be starting up
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+  while (m_fd < 0) {
+    for (addrinfo *ai = addresses; ai != nullptr && m_fd < 0;
+         ai = ai->ai_next) {
+      int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+      if (fd < 0) {
+        continue;
+      }
+      if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+        m_fd = fd;
+      } else {
+        close(fd);
+      }
+    }
+    if (m_fd < 0) {
+      NS_ABORT_MSG_IF(std::chrono::steady_clock::now() > deadline,
+                      "No agent accepted a connection at " << address);
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+  }
+  freeaddrinfo(addresses);
+
+  // every message is a round trip, waiting for more to coalesce only adds
+  // latency
+  int one = 1;
+  setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  m_sendBuffer.resize(Ns3penvGymMsg::DEFAULT_CAPACITY);
+  m_cpp2py.buffer = m_sendBuffer.data();
+  m_cpp2py.capacity = m_sendBuffer.size();
+
+  // the agent greets every connection with the hash of its spaces
+  while (true) {
+    Ns3penvFrameHeader header;
+    std::size_t available = m_in.size() - m_inStart;
+    if (available >= sizeof(header)) {
+      std::memcpy(&header, m_in.data() + m_inStart, sizeof(header));
+      NS_ABORT_MSG_IF(header.channel != NS3PENV_FRAME_HELLO ||
+                          header.size != sizeof(m_spaceHash),
+                      "The agent at " << address << " sent no hello frame");
+      if (available >= sizeof(header) + header.size) {
+        std::memcpy(&m_spaceHash, m_in.data() + m_inStart + sizeof(header),
+                    sizeof(m_spaceHash));
+        m_inStart += sizeof(header) + header.size;
+        break;
+      }
+    }
+    NS_ABORT_MSG_IF(!Fill(true), "The agent closed the connection");
+  }
+  NS_LOG_DEBUG("Connected to the agent at " << address);
+}
+
+Ns3penvSocketTransport::~Ns3penvSocketTransport() {
+  NS_LOG_FUNCTION(this);
+  if (m_fd >= 0) {
+    close(m_fd);
+  }
+}
+
+void Ns3penvSocketTransport::CppSendBegin() {}
+
+Ns3penvWaitStatus Ns3penvSocketTransport::CppSendBeginFor(uint64_t) {
+  // sending never waits for the agent
+  return Ns3penvWaitStatus::OK;
+}
+
+Ns3penvGymMsg *Ns3penvSocketTransport::GetCpp2PyStruct() { return &m_cpp2py; }
+
+bool Ns3penvSocketTransport::Reserve(Ns3penvGymMsg *msg, uint32_t size) {
+  if (size > m_sendBuffer.size()) {
+    m_sendBuffer.resize(size);
+  }
+  msg->buffer = m_sendBuffer.data();
+  msg->capacity = m_sendBuffer.size();
+  return true;
+}
+
+void Ns3penvSocketTransport::CppSendEnd() {
+  // batched records first, so Python sees them in the order they were sent
+  Ns3penvFrameHeader header{m_cpp2py.size, NS3PENV_FRAME_MESSAGE};
+  iovec iov[3];
+  int count = 0;
+  if (!m_records.empty()) {
+    iov[count++] = {m_records.data(), m_records.size()};
+  }
+  iov[count++] = {&header, sizeof(header)};
+  iov[count++] = {m_cpp2py.buffer.get(), m_cpp2py.size};
+  WriteVectors(m_fd, iov, count);
+  m_records.clear();
+}
+
+void Ns3penvSocketTransport::CppRecvBegin() {
+  Flush();
+  while (!NextMessage()) {
+    NS_ABORT_MSG_IF(!Fill(true), "The agent closed the connection");
+  }
+}
+
+Ns3penvWaitStatus
+Ns3penvSocketTransport::CppRecvBeginFor(uint64_t timeout_us) {
+  Flush();
+  typedef std::chrono::steady_clock Clock;
+  const bool timed = timeout_us != NS3PENV_WAIT_FOREVER;
+  const Clock::time_point deadline =
+      timed ? Clock::now() + std::chrono::microseconds(timeout_us)
+            : Clock::time_point::max();
+  while (!NextMessage()) {
+    if (m_closed) {
+      return Ns3penvWaitStatus::PEER_GONE;
+    }
+    int timeoutMs = -1;
+    if (timed) {
+      Clock::duration left = deadline - Clock::now();
+      if (left <= Clock::duration::zero()) {
+        return Ns3penvWaitStatus::TIMEOUT;
+      }
+      timeoutMs = std::min<int64_t>(
+          std::chrono::ceil<std::chrono::milliseconds>(left).count(),
+          INT_MAX);
+    }
+    pollfd pfd{m_fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, timeoutMs);
+    NS_ABORT_MSG_IF(ready < 0 && errno != EINTR,
+                    "Lost the agent connection: " << std::strerror(errno));
+    if (ready > 0) {
+      Fill(false);
+    }
+  }
+  return Ns3penvWaitStatus::OK;
+}
+
+bool Ns3penvSocketTransport::CppTryRecvBegin() {
+  Flush();
+  if (NextMessage()) {
+    return true;
+  }
+  while (Fill(false)) {
+    if (NextMessage()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Ns3penvGymMsg *Ns3penvSocketTransport::GetPy2CppStruct() { return &m_py2cpp; }
+
+void Ns3penvSocketTransport::CppRecvEnd() {
+  m_inStart += m_consumed;
+  m_consumed = 0;
+  m_py2cpp.size = 0;
+}
+
+bool Ns3penvSocketTransport::HasRing() const { return true; }
+
+bool Ns3penvSocketTransport::CppTrySend(const void *data, uint32_t size) {
+  Ns3penvFrameHeader header{size, NS3PENV_FRAME_RECORD};
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&header);
+  m_records.insert(m_records.end(), bytes, bytes + sizeof(header));
+  bytes = static_cast<const uint8_t *>(data);
+  m_records.insert(m_records.end(), bytes, bytes + size);
+  if (m_records.size() >= m_batchBytes) {
+    Flush();
+  }
+  return true;
+}
+
+uint64_t Ns3penvSocketTransport::GetSpaceHash() const { return m_spaceHash; }
+
+Ns3penvStats *Ns3penvSocketTransport::GetStats(bool) {
+  // they live in the shared memory segment
+  return nullptr;
+}
+
+std::size_t Ns3penvSocketTransport::GetFreeMemory() const {
+  return UINT32_MAX - m_sendBuffer.size();
+}
+
+void Ns3penvSocketTransport::Flush() {
+  if (m_records.empty()) {
+    return;
+  }
+  iovec iov{m_records.data(), m_records.size()};
+  WriteVectors(m_fd, &iov, 1);
+  m_records.clear();
+}
+
+bool Ns3penvSocketTransport::Fill(bool wait) {
+  // drop what has been read, unless a message still points into it
+  if (m_consumed == 0 && m_inStart > 0) {
+    m_in.erase(m_in.begin(), m_in.begin() + m_inStart);
+    m_inStart = 0;
+  }
+  std::size_t room = RECV_CHUNK;
+  Ns3penvFrameHeader header;
+  if (m_in.size() - m_inStart >= sizeof(header)) {
+    // the rest of a large frame in one go
+    std::memcpy(&header, m_in.data() + m_inStart, sizeof(header));
+    room = std::max<std::size_t>(room, sizeof(header) + header.size);
+  }
+  std::size_t size = m_in.size();
+  m_in.resize(size + room);
+  while (true) {
+    ssize_t received =
+        recv(m_fd, m_in.data() + size, room, wait ? 0 : MSG_DONTWAIT);
+    if (received > 0) {
+      m_in.resize(size + received);
+      return true;
+    }
+    if (received == 0) {
+      m_in.resize(size);
+      m_closed = true;
+      return false;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    m_in.resize(size);
+    NS_ABORT_MSG_IF(errno != EAGAIN && errno != EWOULDBLOCK,
+                    "Lost the agent connection: " << std::strerror(errno));
+    return false;
+  }
+}
+
+bool Ns3penvSocketTransport::NextMessage() {
+  while (true) {
+    Ns3penvFrameHeader header;
+    std::size_t available = m_in.size() - m_inStart;
+    if (available < sizeof(header)) {
+      return false;
+    }
+    std::memcpy(&header, m_in.data() + m_inStart, sizeof(header));
+    if (available < sizeof(header) + header.size) {
+      return false;
+    }
+    uint8_t *payload = m_in.data() + m_inStart + sizeof(header);
+    if (header.channel == NS3PENV_FRAME_HELLO) {
+      // python learned new spaces
+      NS_ABORT_MSG_IF(header.size != sizeof(m_spaceHash),
+                      "Malformed hello frame of " << header.size << " bytes");
+      std::memcpy(&m_spaceHash, payload, sizeof(m_spaceHash));
+      m_inStart += sizeof(header) + header.size;
+      continue;
+    }
+    NS_ABORT_MSG_IF(header.channel != NS3PENV_FRAME_MESSAGE,
+                    "Unexpected frame on channel " << header.channel);
+    m_py2cpp.buffer = payload;
+    m_py2cpp.capacity = header.size;
+    m_py2cpp.size = header.size;
+    m_consumed = sizeof(header) + header.size;
+    return true;
+  }
+}
+
+} // namespace ns3
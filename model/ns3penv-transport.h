@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#ifndef NS3PENV_TRANSPORT_H
+#define NS3PENV_TRANSPORT_H
+
+#include "ns3penv-gym-msg.h"
+#include "ns3penv-msg-interface.h"
+#include "ns3penv-stats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief How the C++ side of the Gym interface exchanges its messages
+ *
+ * The calls are those of Ns3penvMsgInterfaceImpl: a state is written into
+ * GetCpp2PyStruct between CppSendBegin and CppSendEnd, an action is read
+ * from GetPy2CppStruct between CppRecvBegin and CppRecvEnd. The payloads,
+ * EnvStateMsg, flat states and EnvActMsg, are the same on every transport.
+ */
+class Ns3penvTransport {
+public:
+  virtual ~Ns3penvTransport() = default;
+
+  virtual void CppSendBegin() = 0;
+  /**
+   * Like CppSendBegin, but gives up after timeout_us microseconds, or once
+   * the agent is known to be gone
+   */
+  virtual Ns3penvWaitStatus CppSendBeginFor(uint64_t timeout_us) = 0;
+  virtual Ns3penvGymMsg *GetCpp2PyStruct() = 0;
+  /**
+   * Makes sure the buffer of the C++ to Python message holds at least size
+   * bytes, between CppSendBegin and CppSendEnd. The old contents are not
+   * kept. Returns false if there is no room.
+   */
+  virtual bool Reserve(Ns3penvGymMsg *msg, uint32_t size) = 0;
+  virtual void CppSendEnd() = 0;
+
+  virtual void CppRecvBegin() = 0;
+  /** Like CppSendBeginFor, for CppRecvBegin */
+  virtual Ns3penvWaitStatus CppRecvBeginFor(uint64_t timeout_us) = 0;
+  /** Like CppRecvBegin, but returns false right away if nothing arrived */
+  virtual bool CppTryRecvBegin() = 0;
+  virtual Ns3penvGymMsg *GetPy2CppStruct() = 0;
+  virtual void CppRecvEnd() = 0;
+
+  /** Whether records can be streamed with CppTrySend */
+  virtual bool HasRing() const = 0;
+  /** Sends a record without waiting, false if it cannot be taken now */
+  virtual bool CppTrySend(const void *data, uint32_t size) = 0;
+
+  /** The hash of the spaces Python has, 0 for none */
+  virtual uint64_t GetSpaceHash() const = 0;
+  /** See Ns3penvMsgInterfaceImpl::GetStats, nullptr where unsupported */
+  virtual Ns3penvStats *GetStats(bool create) = 0;
+  /** Bytes left for messages, reported when Reserve fails */
+  virtual std::size_t GetFreeMemory() const = 0;
+};
+
+/**
+ * \brief The shared memory segment of Ns3penvMsgInterfaceImpl as a transport
+ */
+class Ns3penvShmTransport : public Ns3penvTransport {
+public:
+  typedef Ns3penvMsgInterfaceImpl<Ns3penvGymMsg, Ns3penvGymMsg> Impl;
+
+  explicit Ns3penvShmTransport(Impl *impl) : m_impl(impl) {}
+
+  void CppSendBegin() override { m_impl->CppSendBegin(); }
+  Ns3penvWaitStatus CppSendBeginFor(uint64_t timeout_us) override {
+    return m_impl->CppSendBeginFor(timeout_us);
+  }
+  Ns3penvGymMsg *GetCpp2PyStruct() override {
+    return m_impl->GetCpp2PyStruct();
+  }
+  bool Reserve(Ns3penvGymMsg *msg, uint32_t size) override {
+    return m_impl->Reserve(msg, size);
+  }
+  void CppSendEnd() override { m_impl->CppSendEnd(); }
+
+  void CppRecvBegin() override { m_impl->CppRecvBegin(); }
+  Ns3penvWaitStatus CppRecvBeginFor(uint64_t timeout_us) override {
+    return m_impl->CppRecvBeginFor(timeout_us);
+  }
+  bool CppTryRecvBegin() override { return m_impl->CppTryRecvBegin(); }
+  Ns3penvGymMsg *GetPy2CppStruct() override {
+    return m_impl->GetPy2CppStruct();
+  }
+  void CppRecvEnd() override { m_impl->CppRecvEnd(); }
+
+  bool HasRing() const override { return m_impl->HasRing(); }
+  bool CppTrySend(const void *data, uint32_t size) override {
+    return m_impl->CppTrySend(data, size);
+  }
+
+  uint64_t GetSpaceHash() const override { return m_impl->GetSpaceHash(); }
+  Ns3penvStats *GetStats(bool create) override {
+    return m_impl->GetStats(create);
+  }
+  std::size_t GetFreeMemory() const override {
+    return m_impl->GetFreeMemory();
+  }
+
+private:
+  Impl *m_impl; //!< owned by the Ns3penvMsgInterface it came from
+};
+
+/**
+ * Header of a frame of the socket transport, in little endian, followed by
+ * size bytes of payload
+ */
+struct Ns3penvFrameHeader {
+  uint32_t size;
+  uint32_t channel; // Ns3penvFrameChannel
+};
+
+enum Ns3penvFrameChannel : uint32_t {
+  NS3PENV_FRAME_MESSAGE = 0, //!< a state, init message, action or ack
+  NS3PENV_FRAME_RECORD = 1,  //!< a streamed state, see CppTrySend
+  NS3PENV_FRAME_HELLO = 2,   //!< from Python: the uint64 hash of its spaces
+};
+
+/**
+ * \brief Exchanges the messages as length-prefixed frames over TCP
+ *
+ * For a simulation and an agent on different hosts. The agent listens
+ * (see python/src/ns3env/transport.py) and greets every connection with a
+ * hello frame; the simulation connects, retrying for a while, with Nagle's
+ * algorithm disabled. Messages are sent right away, header and payload in
+ * one writev. Streamed records are batched until batchBytes have gathered
+ * or the next message goes out. The socket stays blocking, so CppTrySend
+ * never fails; a lost connection aborts the simulation, except in
+ * CppRecvBeginFor, which reports it as PEER_GONE.
+ */
+class Ns3penvSocketTransport : public Ns3penvTransport {
+public:
+  /**
+   * Connects to address, "tcp://host:port", aborting if no agent accepts
+   * within timeoutMs
+   */
+  explicit Ns3penvSocketTransport(const std::string &address,
+                                  uint32_t batchBytes = 64 * 1024,
+                                  uint32_t timeoutMs = 30000);
+  ~Ns3penvSocketTransport() override;
+
+  void CppSendBegin() override;
+  Ns3penvWaitStatus CppSendBeginFor(uint64_t timeout_us) override;
+  Ns3penvGymMsg *GetCpp2PyStruct() override;
+  bool Reserve(Ns3penvGymMsg *msg, uint32_t size) override;
+  void CppSendEnd() override;
+
+  void CppRecvBegin() override;
+  Ns3penvWaitStatus CppRecvBeginFor(uint64_t timeout_us) override;
+  bool CppTryRecvBegin() override;
+  Ns3penvGymMsg *GetPy2CppStruct() override;
+  void CppRecvEnd() override;
+
+  bool HasRing() const override;
+  bool CppTrySend(const void *data, uint32_t size) override;
+
+  uint64_t GetSpaceHash() const override;
+  Ns3penvStats *GetStats(bool create) override;
+  std::size_t GetFreeMemory() const override;
+
+  /** Writes the batched records out */
+  void Flush();
+
+private:
+  /**
+   * Takes in what has arrived, waiting for it if wait. Returns false if
+   * nothing has, or the agent closed the connection (see m_closed).
+   */
+  bool Fill(bool wait);
+  /**
+   * Points m_py2cpp at the next buffered message, handling the frames
+   * around it. Returns false if none is complete yet.
+   */
+  bool NextMessage();
+
+  int m_fd;
+  bool m_closed; //!< the agent closed the connection
+  uint32_t m_batchBytes;
+  uint64_t m_spaceHash;
+  Ns3penvGymMsg m_cpp2py;
+  Ns3penvGymMsg m_py2cpp;
+  std::vector<uint8_t> m_sendBuffer;
+  std::vector<uint8_t> m_records; //!< batched record frames
+  std::vector<uint8_t> m_in;      //!< received bytes from m_inStart on
+  std::size_t m_inStart;
+  std::size_t m_consumed; //!< bytes of the message being read
+};
+
+} // namespace ns3
+
+#endif // NS3PENV_TRANSPORT_H
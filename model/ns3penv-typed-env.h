@@ -0,0 +1,464 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#ifndef OPENGYM_TYPED_ENV_H
+#define OPENGYM_TYPED_ENV_H
+
+#include "container.h"
+#include "messages.pb.h"
+#include "ns3penv-flat-msg.h"
+#include "ns3penv-gym-env.h"
+#include "ns3penv-gym-interface.h"
+#include "spaces.h"
+
+#include <array>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @brief The Box element type and shape of a field type: a scalar of a Box
+ * dtype, or std::arrays of one nested to any depth
+ */
+template <typename T>
+struct OpenGymTypedValue
+{
+    typedef T Element;
+    static constexpr uint32_t count = 1;
+
+    static void AppendShape(std::vector<uint32_t>&)
+    {
+    }
+};
+
+template <typename T, std::size_t N>
+struct OpenGymTypedValue<std::array<T, N>>
+{
+    typedef typename OpenGymTypedValue<T>::Element Element;
+    static constexpr uint32_t count = N * OpenGymTypedValue<T>::count;
+
+    static void AppendShape(std::vector<uint32_t>& shape)
+    {
+        shape.push_back(N);
+        OpenGymTypedValue<T>::AppendShape(shape);
+    }
+};
+
+/** @brief the Box dtype of a value type, NoDType for any other */
+template <typename T>
+constexpr ns3penv::Dtype
+OpenGymTypedDtype()
+{
+    if constexpr (std::is_same_v<T, int32_t>)
+    {
+        return ns3penv::INT;
+    }
+    else if constexpr (std::is_same_v<T, uint32_t>)
+    {
+        return ns3penv::UINT;
+    }
+    else if constexpr (std::is_same_v<T, float>)
+    {
+        return ns3penv::FLOAT;
+    }
+    else if constexpr (std::is_same_v<T, double>)
+    {
+        return ns3penv::DOUBLE;
+    }
+    else if constexpr (std::is_same_v<T, int8_t>)
+    {
+        return ns3penv::INT8;
+    }
+    else if constexpr (std::is_same_v<T, uint8_t>)
+    {
+        return ns3penv::UINT8;
+    }
+    else if constexpr (std::is_same_v<T, int64_t>)
+    {
+        return ns3penv::INT64;
+    }
+    else if constexpr (std::is_same_v<T, OpenGymFloat16>)
+    {
+        return ns3penv::FLOAT16;
+    }
+    else
+    {
+        return ns3penv::NoDType;
+    }
+}
+
+/** @brief the name OpenGymBoxSpace takes for a Box dtype */
+inline const char*
+OpenGymTypedDtypeName(ns3penv::Dtype dtype)
+{
+    switch (dtype)
+    {
+    case ns3penv::INT:
+        return "int32_t";
+    case ns3penv::UINT:
+        return "uint32_t";
+    case ns3penv::FLOAT:
+        return "float";
+    case ns3penv::DOUBLE:
+        return "double";
+    case ns3penv::INT8:
+        return "int8_t";
+    case ns3penv::UINT8:
+        return "uint8_t";
+    case ns3penv::INT64:
+        return "int64_t";
+    case ns3penv::FLOAT16:
+        return "float16";
+    default:
+        return "";
+    }
+}
+
+/** @brief a field of a typed struct, a Box named name with bounds low and high */
+template <typename S, typename T>
+struct OpenGymTypedField
+{
+    const char* name;
+    T S::*member;
+    float low;
+    float high;
+};
+
+/** @brief describe the field member of struct S, see OpenGymTypedLayout */
+template <typename S, typename T>
+constexpr OpenGymTypedField<S, T>
+OpenGymField(const char* name,
+             T S::*member,
+             float low = -std::numeric_limits<float>::infinity(),
+             float high = std::numeric_limits<float>::infinity())
+{
+    static_assert(OpenGymTypedDtype<typename OpenGymTypedValue<T>::Element>() !=
+                      ns3penv::NoDType,
+                  "A typed field is a scalar of a Box dtype or std::arrays of one");
+    return {name, member, low, high};
+}
+
+/**
+ * @brief The fields of an observation or action struct of a TypedOpenGymEnv,
+ * to be specialized for it:
+ *
+ *     template <>
+ *     struct OpenGymTypedLayout<MyObs>
+ *     {
+ *         static constexpr auto fields =
+ *             std::make_tuple(OpenGymField("rtt", &MyObs::rtt, 0, 1),
+ *                             OpenGymField("queue", &MyObs::queue, 0, 100));
+ *     };
+ *
+ * Every field is a Box of a Dict space, a scalar one of shape {1}.
+ */
+template <typename S>
+struct OpenGymTypedLayout;
+
+/** @brief call f with every field of S */
+template <typename S, typename F>
+void
+OpenGymForEachField(F&& f)
+{
+    std::apply([&](const auto&... field) { (f(field), ...); }, OpenGymTypedLayout<S>::fields);
+}
+
+/** @brief the byte offset of a member in S */
+template <typename S, typename T>
+uint32_t
+OpenGymFieldOffset(T S::*member)
+{
+    static const S probe{};
+    return reinterpret_cast<const uint8_t*>(&(probe.*member)) -
+           reinterpret_cast<const uint8_t*>(&probe);
+}
+
+/** @brief the dtype of the Box of a field */
+template <typename S, typename T>
+constexpr ns3penv::Dtype
+OpenGymFieldDtype(const OpenGymTypedField<S, T>&)
+{
+    return OpenGymTypedDtype<typename OpenGymTypedValue<T>::Element>();
+}
+
+/** @brief the shape of the Box of a field */
+template <typename S, typename T>
+std::vector<uint32_t>
+OpenGymFieldShape(const OpenGymTypedField<S, T>&)
+{
+    std::vector<uint32_t> shape;
+    OpenGymTypedValue<T>::AppendShape(shape);
+    if (shape.empty())
+    {
+        shape.push_back(1);
+    }
+    return shape;
+}
+
+/** @brief the in-memory layout of S, which Python maps to a numpy dtype */
+template <typename S>
+ns3penv::StructLayout
+OpenGymStructLayout()
+{
+    static_assert(std::is_trivially_copyable_v<S>, "A typed struct is copied as it is");
+    ns3penv::StructLayout layout;
+    layout.set_size(sizeof(S));
+    OpenGymForEachField<S>([&](const auto& field) {
+        ns3penv::StructField* out = layout.add_field();
+        out->set_name(field.name);
+        out->set_dtype(OpenGymFieldDtype(field));
+        for (const auto& dim : OpenGymFieldShape(field))
+        {
+            out->add_shape(dim);
+        }
+        out->set_offset(OpenGymFieldOffset(field.member));
+    });
+    return layout;
+}
+
+/** @brief the Dict of Boxes of the fields of S */
+template <typename S>
+Ptr<OpenGymDictSpace>
+OpenGymStructSpace()
+{
+    Ptr<OpenGymDictSpace> space = CreateObject<OpenGymDictSpace>();
+    OpenGymForEachField<S>([&](const auto& field) {
+        space->Add(field.name,
+                   CreateObject<OpenGymBoxSpace>(field.low,
+                                                 field.high,
+                                                 OpenGymFieldShape(field),
+                                                 OpenGymTypedDtypeName(OpenGymFieldDtype(field))));
+    });
+    return space;
+}
+
+/**
+ * @brief A container holding a struct of a TypedOpenGymEnv
+ *
+ * Its flat encoding is the struct as it is, a payload of sizeof(S) UINT8
+ * that Python views with the numpy dtype of OpenGymStructLayout<S>. The
+ * protobuf message, for a state that is not flat, is the Dict of Boxes of
+ * OpenGymStructSpace<S>.
+ */
+template <typename S>
+class OpenGymTypedContainer : public OpenGymDataContainer
+{
+  public:
+    OpenGymTypedContainer()
+        : m_value{}
+    {
+    }
+
+    static TypeId GetTypeId()
+    {
+        static TypeId tid =
+            TypeId("ns3::OpenGymTypedContainer<" + std::string(typeid(S).name()) + ">")
+                .SetParent<OpenGymDataContainer>()
+                .SetGroupName("OpenGym")
+                .template AddConstructor<OpenGymTypedContainer<S>>();
+        return tid;
+    }
+
+    S& Get()
+    {
+        return m_value;
+    }
+
+    const S& Get() const
+    {
+        return m_value;
+    }
+
+    uint32_t GetFlatDataSize() const override
+    {
+        return sizeof(S);
+    }
+
+    void SerializeFlat(Ns3penvFlatStateHeader* header, uint8_t* payload) const override
+    {
+        header->dtype = ns3penv::UINT8;
+        header->ndim = 1;
+        header->shape[0] = sizeof(S);
+        header->dataSize = sizeof(S);
+        std::memcpy(payload, &m_value, sizeof(S));
+    }
+
+    bool DeserializeFlat(const uint8_t* payload, uint32_t size) override
+    {
+        if (size != sizeof(S))
+        {
+            return false;
+        }
+        std::memcpy(&m_value, payload, sizeof(S));
+        return true;
+    }
+
+    using OpenGymDataContainer::GetDataContainerPbMsg;
+    void GetDataContainerPbMsg(ns3penv::DataContainer* dataMsg) override
+    {
+        ns3penv::DictDataContainer* dictMsg = dataMsg->mutable_dict();
+        dictMsg->Clear();
+        OpenGymForEachField<S>([&](const auto& field) {
+            typedef typename OpenGymTypedValue<
+                std::remove_reference_t<decltype(m_value.*field.member)>>::Element T;
+            std::span<const T> values{reinterpret_cast<const T*>(&(m_value.*field.member)),
+                                      OpenGymTypedValue<std::remove_reference_t<
+                                          decltype(m_value.*field.member)>>::count};
+            Ptr<OpenGymBoxContainer<T>> box =
+                CreateObject<OpenGymBoxContainer<T>>(OpenGymFieldShape(field));
+            box->SetData(values);
+            ns3penv::DataContainer* element = dictMsg->add_element();
+            element->set_name(field.name);
+            box->GetDataContainerPbMsg(element);
+        });
+    }
+
+    /**
+     * @brief fill the struct from a Dict of Boxes of its fields, as the
+     * actions of an agent that does not send the struct come
+     * @returns false if data does not match, the struct is then partly
+     * filled
+     */
+    bool SetFrom(Ptr<OpenGymDataContainer> data)
+    {
+        Ptr<OpenGymDictContainer> dict = DynamicCast<OpenGymDictContainer>(data);
+        if (!dict)
+        {
+            return false;
+        }
+        bool matched = true;
+        OpenGymForEachField<S>([&](const auto& field) {
+            typedef std::remove_reference_t<decltype(m_value.*field.member)> V;
+            typedef typename OpenGymTypedValue<V>::Element T;
+            auto it = dict->GetEntries().find(field.name);
+            Ptr<OpenGymBoxContainer<T>> box =
+                it == dict->GetEntries().end() ? nullptr
+                                               : DynamicCast<OpenGymBoxContainer<T>>(it->second);
+            if (!box || box->GetDataView().size() != OpenGymTypedValue<V>::count)
+            {
+                matched = false;
+                return;
+            }
+            std::memcpy(&(m_value.*field.member), box->GetDataView().data(), sizeof(V));
+        });
+        return matched;
+    }
+
+    void Print(std::ostream& where) const override
+    {
+        where << "TypedContainer(" << sizeof(S) << " bytes)";
+    }
+
+  private:
+    S m_value;
+};
+
+/**
+ * @brief An environment whose observations and actions are fixed structs
+ *
+ * Obs and Act are trivially copyable structs of scalars and std::arrays of
+ * Box dtypes, described by OpenGymTypedLayout. The spaces are the Dicts of
+ * their fields. A state is sent as the observation struct itself, flat,
+ * and an agent that knows the layout of the actions (Ns3Env does) sends
+ * the action struct as it is, so no step builds containers or protobuf
+ * messages of the values. The dynamic OpenGymEnv stays for spaces that
+ * change or nest.
+ */
+template <typename Obs, typename Act>
+class TypedOpenGymEnv : public OpenGymEnv
+{
+  public:
+    TypedOpenGymEnv()
+        : m_obs(CreateObject<OpenGymTypedContainer<Obs>>()),
+          m_act(CreateObject<OpenGymTypedContainer<Act>>())
+    {
+    }
+
+    static TypeId GetTypeId()
+    {
+        static TypeId tid = TypeId("ns3::TypedOpenGymEnv<" + std::string(typeid(Obs).name()) +
+                                   ", " + std::string(typeid(Act).name()) + ">")
+                                .SetParent<OpenGymEnv>()
+                                .SetGroupName("OpenGym");
+        return tid;
+    }
+
+    /** @brief fill obs with the current observation */
+    virtual void GetTypedObservation(Obs& obs) = 0;
+
+    /** @brief execute the actions of the agent */
+    virtual bool ExecuteTypedActions(const Act& act) = 0;
+
+    void SetOpenGymInterface(Ptr<OpenGymInterface> openGymInterface) override
+    {
+        OpenGymEnv::SetOpenGymInterface(openGymInterface);
+        openGymInterface->SetStructLayouts(OpenGymStructLayout<Obs>(),
+                                           OpenGymStructLayout<Act>(),
+                                           m_act);
+    }
+
+    Ptr<OpenGymSpace> GetActionSpace() override
+    {
+        return OpenGymStructSpace<Act>();
+    }
+
+    Ptr<OpenGymSpace> GetObservationSpace() override
+    {
+        return OpenGymStructSpace<Obs>();
+    }
+
+    Ptr<OpenGymDataContainer> GetObservation() override
+    {
+        GetTypedObservation(m_obs->Get());
+        return m_obs;
+    }
+
+    bool ExecuteActions(Ptr<OpenGymDataContainer> action) override
+    {
+        if (action != m_act && !m_act->SetFrom(action))
+        {
+            return false;
+        }
+        return ExecuteTypedActions(m_act->Get());
+    }
+
+  protected:
+    void DoDispose() override
+    {
+        m_obs = nullptr;
+        m_act = nullptr;
+        OpenGymEnv::DoDispose();
+    }
+
+  private:
+    Ptr<OpenGymTypedContainer<Obs>> m_obs;
+    Ptr<OpenGymTypedContainer<Act>> m_act; //!< filled with the struct the agent sent
+};
+
+} // namespace ns3
+
+#endif /* OPENGYM_TYPED_ENV_H */
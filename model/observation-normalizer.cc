@@ -0,0 +1,358 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#include "observation-normalizer.h"
+
+#include "container.h"
+#include "quantize.h"
+#include "spaces.h"
+
+#include <ns3/abort.h>
+#include <ns3/log.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(NS3PENV_NO_SIMD)
+#define NS3PENV_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("OpenGymObservationNormalizer");
+
+NS_OBJECT_ENSURE_REGISTERED(OpenGymObservationNormalizer);
+
+/** Copy the values of a box of type T as floats, false if data is another box */
+template <typename T>
+static bool
+ReadBox(OpenGymDataContainer* data, float* out, uint32_t count)
+{
+    auto* box = dynamic_cast<OpenGymBoxContainer<T>*>(data);
+    if (!box || box->GetDataView().size() != count)
+    {
+        return false;
+    }
+    std::span<const T> values = box->GetDataView();
+    if constexpr (std::is_same_v<T, float>)
+    {
+        std::memcpy(out, values.data(), values.size_bytes());
+    }
+    else if constexpr (std::is_same_v<T, OpenGymFloat16>)
+    {
+        OpenGymHalfToFloat(values, {out, count});
+    }
+    else
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            out[i] = float(values[i]);
+        }
+    }
+    return true;
+}
+
+/**
+ * The arguments of a normalization pass. The variance of a feature is
+ * m2 * invCount + offset, so no statistics (invCount 0, offset 1) leave the
+ * values as they are but for the clipping.
+ */
+struct NormalizeArgs
+{
+    float* values;
+    double* mean;
+    double* m2;
+    uint32_t count;
+    bool update;
+    double invN; // 1 / observations including this one, when updating
+    double invCount;
+    double offset;
+    double clip;
+};
+
+/** Update and normalize the features from begin on, in place */
+static void
+NormalizeScalar(const NormalizeArgs& a, uint32_t begin)
+{
+    for (uint32_t i = begin; i < a.count; ++i)
+    {
+        double x = a.values[i];
+        double mean = a.mean[i];
+        if (a.update)
+        {
+            double delta = x - mean;
+            mean += delta * a.invN;
+            a.m2[i] += delta * (x - mean);
+            a.mean[i] = mean;
+        }
+        double y = (x - mean) / std::sqrt(a.m2[i] * a.invCount + a.offset);
+        // NaN takes the lower bound, as _mm256_max_pd does
+        y = std::min(a.clip, std::max(-a.clip, y));
+        a.values[i] = float(y);
+    }
+}
+
+#ifdef NS3PENV_X86_SIMD
+
+static bool
+HasAvx2()
+{
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+}
+
+/** The AVX2 pass, without FMA so it rounds exactly like NormalizeScalar */
+__attribute__((target("avx2"))) static uint32_t
+NormalizeAvx2(const NormalizeArgs& a)
+{
+    const __m256d invN = _mm256_set1_pd(a.invN);
+    const __m256d invCount = _mm256_set1_pd(a.invCount);
+    const __m256d offset = _mm256_set1_pd(a.offset);
+    const __m256d hi = _mm256_set1_pd(a.clip);
+    const __m256d lo = _mm256_set1_pd(-a.clip);
+    uint32_t i = 0;
+    for (; i + 4 <= a.count; i += 4)
+    {
+        __m256d x = _mm256_cvtps_pd(_mm_loadu_ps(a.values + i));
+        __m256d mean = _mm256_loadu_pd(a.mean + i);
+        __m256d m2 = _mm256_loadu_pd(a.m2 + i);
+        if (a.update)
+        {
+            __m256d delta = _mm256_sub_pd(x, mean);
+            mean = _mm256_add_pd(mean, _mm256_mul_pd(delta, invN));
+            m2 = _mm256_add_pd(m2, _mm256_mul_pd(delta, _mm256_sub_pd(x, mean)));
+            _mm256_storeu_pd(a.mean + i, mean);
+            _mm256_storeu_pd(a.m2 + i, m2);
+        }
+        __m256d var = _mm256_add_pd(_mm256_mul_pd(m2, invCount), offset);
+        __m256d y = _mm256_div_pd(_mm256_sub_pd(x, mean), _mm256_sqrt_pd(var));
+        y = _mm256_min_pd(_mm256_max_pd(y, lo), hi);
+        _mm_storeu_ps(a.values + i, _mm256_cvtpd_ps(y));
+    }
+    return i;
+}
+
+#endif
+
+TypeId
+OpenGymObservationNormalizer::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::OpenGymObservationNormalizer")
+                            .SetParent<Object>()
+                            .SetGroupName("OpenGym")
+                            .AddConstructor<OpenGymObservationNormalizer>();
+    return tid;
+}
+
+OpenGymObservationNormalizer::OpenGymObservationNormalizer()
+    : m_features(0),
+      m_count(0),
+      m_clip(10),
+      m_epsilon(1e-8),
+      m_frozen(false),
+      m_half(false),
+      m_read(nullptr)
+{
+    NS_LOG_FUNCTION(this);
+}
+
+OpenGymObservationNormalizer::~OpenGymObservationNormalizer()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+OpenGymObservationNormalizer::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    m_space = nullptr;
+    m_normalized = nullptr;
+}
+
+bool
+OpenGymObservationNormalizer::Configure(Ptr<OpenGymSpace> space, bool half, float clip)
+{
+    NS_LOG_FUNCTION(this << half << clip);
+    Ptr<OpenGymBoxSpace> box = DynamicCast<OpenGymBoxSpace>(space);
+    if (!box || !(clip > 0))
+    {
+        return false;
+    }
+    std::vector<uint32_t> shape = box->GetShape();
+    uint64_t length = 1;
+    for (const auto& dim : shape)
+    {
+        length *= dim;
+    }
+    NS_ABORT_MSG_IF(length > UINT32_MAX / sizeof(double), "Normalized observation too large");
+
+    bool known = OpenGymVisitDtype(box->GetDtype(), [&](auto type) {
+        m_read = &ReadBox<typename decltype(type)::type>;
+    });
+    if (!known)
+    {
+        return false;
+    }
+    m_features = length;
+    m_half = half;
+    m_clip = clip;
+    if (half)
+    {
+        m_normalized =
+            CreateObject<OpenGymBoxContainer<OpenGymFloat16>>(shape, OpenGymFloat16());
+        m_values.assign(length, 0);
+    }
+    else
+    {
+        m_normalized = CreateObject<OpenGymBoxContainer<float>>(shape, 0.0f);
+        m_values.clear();
+    }
+    m_space = CreateObject<OpenGymBoxSpace>(-clip, clip, shape, half ? "float16" : "float");
+    if (m_mean.size() != length || m_m2.size() != length)
+    {
+        Reset();
+    }
+    return true;
+}
+
+Ptr<OpenGymSpace>
+OpenGymObservationNormalizer::GetNormalizedSpace() const
+{
+    return m_space;
+}
+
+Ptr<OpenGymDataContainer>
+OpenGymObservationNormalizer::Normalize(Ptr<OpenGymDataContainer> obs, bool update)
+{
+    NS_ABORT_MSG_IF(!m_normalized, "Observation normalizer is not configured");
+    float* values =
+        m_half ? m_values.data()
+               : DynamicCast<OpenGymBoxContainer<float>>(m_normalized)->MutableView().data();
+    NS_ABORT_MSG_IF(!obs || !m_read(PeekPointer(obs), values, m_features),
+                    "Observation does not match the normalized Box of " << m_features
+                                                                        << " values");
+
+    update = update && !m_frozen;
+    if (update)
+    {
+        ++m_count;
+    }
+    double invCount = m_count ? 1.0 / double(m_count) : 0;
+    NormalizeArgs args{values,
+                       m_mean.data(),
+                       m_m2.data(),
+                       m_features,
+                       update,
+                       invCount,
+                       invCount,
+                       m_count ? m_epsilon : 1,
+                       m_clip};
+
+    uint32_t begin = 0;
+#ifdef NS3PENV_X86_SIMD
+    if (HasAvx2())
+    {
+        begin = NormalizeAvx2(args);
+    }
+#endif
+    NormalizeScalar(args, begin);
+
+    if (m_half)
+    {
+        OpenGymFloatToHalf(
+            m_values,
+            DynamicCast<OpenGymBoxContainer<OpenGymFloat16>>(m_normalized)->MutableView());
+    }
+    return m_normalized;
+}
+
+void
+OpenGymObservationNormalizer::SetFrozen(bool frozen)
+{
+    NS_LOG_FUNCTION(this << frozen);
+    m_frozen = frozen;
+}
+
+bool
+OpenGymObservationNormalizer::IsFrozen() const
+{
+    return m_frozen;
+}
+
+ns3penv::NormalizerStats
+OpenGymObservationNormalizer::GetStatistics() const
+{
+    ns3penv::NormalizerStats stats;
+    stats.set_count(m_count);
+    stats.set_clip(m_clip);
+    stats.set_epsilon(m_epsilon);
+    stats.set_frozen(m_frozen);
+    stats.mutable_mean()->Add(m_mean.begin(), m_mean.end());
+    double invCount = m_count ? 1.0 / double(m_count) : 0;
+    stats.mutable_var()->Reserve(m_m2.size());
+    for (const auto& m2 : m_m2)
+    {
+        stats.add_var(m2 * invCount);
+    }
+    return stats;
+}
+
+bool
+OpenGymObservationNormalizer::SetStatistics(const ns3penv::NormalizerStats& stats)
+{
+    NS_LOG_FUNCTION(this << stats.count());
+    // the clip bounds the normalized space, which is already advertised
+    if (stats.mean_size() != stats.var_size() ||
+        (m_features && uint32_t(stats.mean_size()) != m_features) || stats.epsilon() < 0 ||
+        !(stats.clip() > 0) || (m_space && stats.clip() != m_clip))
+    {
+        return false;
+    }
+    m_count = stats.count();
+    m_mean.assign(stats.mean().begin(), stats.mean().end());
+    m_m2.resize(stats.var_size());
+    for (int i = 0; i < stats.var_size(); ++i)
+    {
+        m_m2[i] = stats.var(i) * double(m_count);
+    }
+    m_epsilon = stats.epsilon();
+    m_frozen = stats.frozen();
+    m_clip = stats.clip();
+    return true;
+}
+
+float
+OpenGymObservationNormalizer::GetClip() const
+{
+    return m_clip;
+}
+
+void
+OpenGymObservationNormalizer::Reset()
+{
+    NS_LOG_FUNCTION(this);
+    m_count = 0;
+    m_mean.assign(m_features, 0);
+    m_m2.assign(m_features, 0);
+}
+
+} // namespace ns3
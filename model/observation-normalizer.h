@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#ifndef OPENGYM_OBSERVATION_NORMALIZER_H
+#define OPENGYM_OBSERVATION_NORMALIZER_H
+
+#include "messages.pb.h"
+
+#include <ns3/object.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace ns3
+{
+
+class OpenGymSpace;
+class OpenGymBoxSpace;
+class OpenGymDataContainer;
+
+/**
+ * @brief Normalizes the values of a Box space by running statistics
+ *
+ * Every value of the box is a feature with its own mean and variance,
+ * updated with Welford's algorithm in double precision. A normalized
+ * value is (x - mean) / sqrt(var + epsilon), clipped to [-clip, clip], and
+ * goes into a float or float16 box that is the same object step after
+ * step. Frozen statistics are applied without being updated, for
+ * evaluation runs.
+ */
+class OpenGymObservationNormalizer : public Object
+{
+  public:
+    OpenGymObservationNormalizer();
+    ~OpenGymObservationNormalizer() override;
+
+    static TypeId GetTypeId();
+
+    /**
+     * @brief normalize the observations of a Box space, of any dtype.
+     * Statistics set before for as many features are kept.
+     * @returns false if the space is not a Box
+     */
+    bool Configure(Ptr<OpenGymSpace> space, bool half = false, float clip = 10);
+
+    /** @brief get the space of the normalized observations */
+    Ptr<OpenGymSpace> GetNormalizedSpace() const;
+
+    /**
+     * @brief update the statistics with an observation, unless frozen or
+     * not update, and get it normalized. Aborts if it is not a Box of the
+     * configured dtype and size.
+     */
+    Ptr<OpenGymDataContainer> Normalize(Ptr<OpenGymDataContainer> obs, bool update = true);
+
+    void SetFrozen(bool frozen);
+    bool IsFrozen() const;
+
+    /** @brief get a copy of the statistics, for instance to store them */
+    ns3penv::NormalizerStats GetStatistics() const;
+
+    /**
+     * @brief replace the statistics, for instance with stored ones. Mean and
+     * variance must have a value per feature once configured; epsilon and
+     * frozen are taken over too, and the clip until Configure sets it. Once
+     * configured the clip must stay, as the normalized space has been sent;
+     * OpenGymInterface::SetObservationStatistics changes it with the space.
+     * @returns false, keeping the statistics, if they do not fit
+     */
+    bool SetStatistics(const ns3penv::NormalizerStats& stats);
+
+    float GetClip() const;
+
+    /** @brief forget the observations seen so far */
+    void Reset();
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    typedef bool (*ReadKernel)(OpenGymDataContainer* data, float* out, uint32_t count);
+
+    uint32_t m_features; // 0 until configured
+    uint64_t m_count;
+    float m_clip;
+    double m_epsilon;
+    bool m_frozen;
+    bool m_half;
+    std::vector<double> m_mean;
+    std::vector<double> m_m2; // sums of squared differences from the mean
+    std::vector<float> m_values; // scratch, the observation as floats
+    Ptr<OpenGymBoxSpace> m_space;
+    Ptr<OpenGymDataContainer> m_normalized;
+    ReadKernel m_read;
+};
+
+} // namespace ns3
+
+#endif /* OPENGYM_OBSERVATION_NORMALIZER_H */
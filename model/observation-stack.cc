@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#include "observation-stack.h"
+
+#include "container.h"
+#include "spaces.h"
+
+#include <ns3/abort.h>
+#include <ns3/log.h>
+
+#include <cstring>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("OpenGymObservationStack");
+
+NS_OBJECT_ENSURE_REGISTERED(OpenGymObservationStack);
+
+/** The values of a box of type T as bytes, empty if data is another type */
+template <typename T>
+static std::span<const uint8_t>
+BoxBytes(OpenGymDataContainer* data)
+{
+    auto* box = dynamic_cast<OpenGymBoxContainer<T>*>(data);
+    if (!box)
+    {
+        return {};
+    }
+    std::span<const T> values = box->GetDataView();
+    return {reinterpret_cast<const uint8_t*>(values.data()), values.size_bytes()};
+}
+
+template <typename T>
+static std::span<uint8_t>
+MutableBoxBytes(OpenGymDataContainer* data)
+{
+    std::span<T> values = static_cast<OpenGymBoxContainer<T>*>(data)->MutableView();
+    return {reinterpret_cast<uint8_t*>(values.data()), values.size_bytes()};
+}
+
+TypeId
+OpenGymObservationStack::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::OpenGymObservationStack")
+                            .SetParent<Object>()
+                            .SetGroupName("OpenGym")
+                            .AddConstructor<OpenGymObservationStack>();
+    return tid;
+}
+
+OpenGymObservationStack::OpenGymObservationStack()
+    : m_depth(0),
+      m_frameSize(0),
+      m_head(0),
+      m_empty(true),
+      m_bytes(nullptr),
+      m_mutableBytes(nullptr)
+{
+    NS_LOG_FUNCTION(this);
+}
+
+OpenGymObservationStack::~OpenGymObservationStack()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+OpenGymObservationStack::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    m_space = nullptr;
+    m_stacked = nullptr;
+}
+
+bool
+OpenGymObservationStack::Configure(Ptr<OpenGymSpace> space, uint32_t depth)
+{
+    NS_LOG_FUNCTION(this << depth);
+    Ptr<OpenGymBoxSpace> box = DynamicCast<OpenGymBoxSpace>(space);
+    if (!box || depth == 0)
+    {
+        return false;
+    }
+    std::vector<uint32_t> shape = box->GetShape();
+    uint64_t length = 1;
+    for (const auto& dim : shape)
+    {
+        length *= dim;
+    }
+    shape.insert(shape.begin(), depth);
+
+    bool known = OpenGymVisitDtype(box->GetDtype(), [&](auto type) {
+        typedef typename decltype(type)::type T;
+        NS_ABORT_MSG_IF(length * depth * sizeof(T) > UINT32_MAX, "Stacked observation too large");
+        m_frameSize = length * sizeof(T);
+        m_stacked = CreateObject<OpenGymBoxContainer<T>>(shape, T());
+        m_bytes = &BoxBytes<T>;
+        m_mutableBytes = &MutableBoxBytes<T>;
+    });
+    if (!known)
+    {
+        return false;
+    }
+    m_depth = depth;
+    m_space = CreateObject<OpenGymBoxSpace>(box->GetLow(),
+                                            box->GetHigh(),
+                                            shape,
+                                            box->GetDtypeName());
+    m_frames.assign(uint64_t(m_frameSize) * depth, 0);
+    Clear();
+    return true;
+}
+
+Ptr<OpenGymSpace>
+OpenGymObservationStack::GetStackedSpace() const
+{
+    return m_space;
+}
+
+Ptr<OpenGymDataContainer>
+OpenGymObservationStack::Push(Ptr<OpenGymDataContainer> obs, bool keep)
+{
+    NS_ABORT_MSG_IF(!m_stacked, "Observation stack is not configured");
+    std::span<const uint8_t> frame;
+    if (obs)
+    {
+        frame = m_bytes(PeekPointer(obs));
+    }
+    NS_ABORT_MSG_IF(frame.size() != m_frameSize,
+                    "Observation of " << frame.size() << " bytes does not match the stacked "
+                                      << m_frameSize << " byte Box");
+    std::span<uint8_t> out = m_mutableBytes(PeekPointer(m_stacked));
+    if (!keep)
+    {
+        // the frames as this push would lay them out, the ring left as it is
+        for (uint32_t i = 0; i + 1 < m_depth; ++i)
+        {
+            uint32_t slot = (m_head + 1 + i) % m_depth;
+            std::memcpy(out.data() + uint64_t(i) * m_frameSize,
+                        m_empty ? frame.data() : m_frames.data() + uint64_t(slot) * m_frameSize,
+                        m_frameSize);
+        }
+        std::memcpy(out.data() + uint64_t(m_depth - 1) * m_frameSize, frame.data(), m_frameSize);
+        return m_stacked;
+    }
+    if (m_empty)
+    {
+        for (uint32_t i = 0; i < m_depth; ++i)
+        {
+            std::memcpy(m_frames.data() + uint64_t(i) * m_frameSize, frame.data(), m_frameSize);
+        }
+        m_empty = false;
+    }
+    else
+    {
+        std::memcpy(m_frames.data() + uint64_t(m_head) * m_frameSize, frame.data(), m_frameSize);
+    }
+    m_head = (m_head + 1) % m_depth;
+
+    // oldest first: the slots from m_head to the end, then the ones before it
+    uint64_t older = uint64_t(m_depth - m_head) * m_frameSize;
+    std::memcpy(out.data(), m_frames.data() + uint64_t(m_head) * m_frameSize, older);
+    std::memcpy(out.data() + older, m_frames.data(), uint64_t(m_head) * m_frameSize);
+    return m_stacked;
+}
+
+void
+OpenGymObservationStack::Clear()
+{
+    NS_LOG_FUNCTION(this);
+    m_head = 0;
+    m_empty = true;
+}
+
+} // namespace ns3
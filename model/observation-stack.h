@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#ifndef OPENGYM_OBSERVATION_STACK_H
+#define OPENGYM_OBSERVATION_STACK_H
+
+#include <ns3/object.h>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace ns3
+{
+
+class OpenGymSpace;
+class OpenGymBoxSpace;
+class OpenGymDataContainer;
+
+/**
+ * @brief Keeps the last observations of a Box space and sends them as one
+ * Box with an extra leading dimension
+ *
+ * The frames live in a ring buffer; every push writes the newest frame
+ * into it and lays the ring out oldest first in the stacked container,
+ * which is the same object step after step.
+ */
+class OpenGymObservationStack : public Object
+{
+  public:
+    OpenGymObservationStack();
+    ~OpenGymObservationStack() override;
+
+    static TypeId GetTypeId();
+
+    /**
+     * @brief stack depth observations of a Box space
+     * @returns false if the space is not a Box
+     */
+    bool Configure(Ptr<OpenGymSpace> space, uint32_t depth);
+
+    /** @brief get the space of the stacked observations, of shape {depth, ...} */
+    Ptr<OpenGymSpace> GetStackedSpace() const;
+
+    /**
+     * @brief add an observation and get the stack, oldest first. The first
+     * observation after Clear fills every frame. Unless keep, the stack
+     * only shows the observation as its newest frame, and the next push
+     * goes on from the frames before it. Aborts if the observation is not a
+     * Box of the configured dtype and size.
+     */
+    Ptr<OpenGymDataContainer> Push(Ptr<OpenGymDataContainer> obs, bool keep = true);
+
+    /** @brief forget the observations pushed so far */
+    void Clear();
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    typedef std::span<const uint8_t> (*BytesKernel)(OpenGymDataContainer* data);
+    typedef std::span<uint8_t> (*MutableBytesKernel)(OpenGymDataContainer* data);
+
+    uint32_t m_depth;
+    uint32_t m_frameSize; // bytes
+    uint32_t m_head;      // slot of the next frame, the oldest one once full
+    bool m_empty;
+    std::vector<uint8_t> m_frames;
+    Ptr<OpenGymBoxSpace> m_space;
+    Ptr<OpenGymDataContainer> m_stacked;
+    BytesKernel m_bytes;
+    MutableBytesKernel m_mutableBytes;
+};
+
+} // namespace ns3
+
+#endif /* OPENGYM_OBSERVATION_STACK_H */
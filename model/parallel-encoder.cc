@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#include "parallel-encoder.h"
+
+#include <ns3/abort.h>
+#include <ns3/log.h>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+
+#include <algorithm>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("OpenGymParallelEncoder");
+
+NS_OBJECT_ENSURE_REGISTERED(OpenGymParallelEncoder);
+
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::internal::WireFormatLite;
+
+/** The tag of a length-delimited field */
+static uint32_t
+MessageTag(int fieldNumber)
+{
+    return WireFormatLite::MakeTag(fieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+}
+
+/** The bytes of a length-delimited field holding size bytes */
+static uint64_t
+FieldSize(uint32_t tag, uint64_t size)
+{
+    return CodedOutputStream::VarintSize32(tag) + CodedOutputStream::VarintSize64(size) + size;
+}
+
+TypeId
+OpenGymParallelEncoder::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::OpenGymParallelEncoder")
+                            .SetParent<Object>()
+                            .SetGroupName("OpenGym")
+                            .AddConstructor<OpenGymParallelEncoder>();
+    return tid;
+}
+
+OpenGymParallelEncoder::OpenGymParallelEncoder()
+    : m_threshold(0),
+      m_parallel(false),
+      m_lastSize(0),
+      m_dataTag(0),
+      m_elementTag(0),
+      m_elementsSize(0),
+      m_restSize(0),
+      m_buffer(nullptr),
+      m_batch(0),
+      m_busy(0),
+      m_stop(false),
+      m_task(nullptr),
+      m_count(0),
+      m_next(0)
+{
+    NS_LOG_FUNCTION(this);
+}
+
+OpenGymParallelEncoder::~OpenGymParallelEncoder()
+{
+    NS_LOG_FUNCTION(this);
+    Stop();
+}
+
+void
+OpenGymParallelEncoder::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    Stop();
+    m_children.clear();
+    m_names.clear();
+    m_elements.clear();
+    m_distinct.clear();
+}
+
+void
+OpenGymParallelEncoder::Start(uint32_t threads, uint32_t threshold)
+{
+    NS_LOG_FUNCTION(this << threads << threshold);
+    Stop();
+    m_threshold = threshold;
+    m_stop = false;
+    for (uint32_t i = 0; i < threads; ++i)
+    {
+        m_workers.emplace_back(&OpenGymParallelEncoder::WorkerLoop, this);
+    }
+}
+
+void
+OpenGymParallelEncoder::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+    m_workers.clear();
+}
+
+void
+OpenGymParallelEncoder::Run(Task task, uint32_t count)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = task;
+        m_count = count;
+        m_next.store(0, std::memory_order_relaxed);
+        m_busy = m_workers.size();
+        ++m_batch;
+    }
+    m_wake.notify_all();
+    Work();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_busy == 0; });
+}
+
+void
+OpenGymParallelEncoder::Work()
+{
+    uint32_t index;
+    while ((index = m_next.fetch_add(1, std::memory_order_relaxed)) < m_count)
+    {
+        (this->*m_task)(index);
+    }
+}
+
+void
+OpenGymParallelEncoder::WorkerLoop()
+{
+    uint64_t seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stop || m_batch != seen; });
+            if (m_stop)
+            {
+                return;
+            }
+            seen = m_batch;
+        }
+        Work();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_busy == 0)
+        {
+            m_done.notify_one();
+        }
+    }
+}
+
+bool
+OpenGymParallelEncoder::Fill(Ptr<OpenGymDataContainer> obs, ns3penv::DataContainer* obsMsg)
+{
+    m_parallel = false;
+    if (m_workers.empty() || m_lastSize < m_threshold || obsMsg->has_name())
+    {
+        return false;
+    }
+
+    // the order and names of GetDataContainerPbMsg of the dict or tuple
+    m_children.clear();
+    m_names.clear();
+    Ptr<OpenGymDictContainer> dict = DynamicCast<OpenGymDictContainer>(obs);
+    Ptr<OpenGymTupleContainer> tuple = DynamicCast<OpenGymTupleContainer>(obs);
+    if (dict)
+    {
+        for (const auto& [name, child] : dict->GetEntries())
+        {
+            m_children.push_back(PeekPointer(child));
+            m_names.push_back(&name);
+        }
+    }
+    else if (tuple)
+    {
+        for (const auto& child : tuple->GetElements())
+        {
+            m_children.push_back(PeekPointer(child));
+        }
+    }
+    m_distinct = m_children;
+    std::sort(m_distinct.begin(), m_distinct.end());
+    if (m_children.size() < 2 ||
+        std::adjacent_find(m_distinct.begin(), m_distinct.end()) != m_distinct.end())
+    {
+        NS_LOG_DEBUG("Observation is not a dict or tuple of distinct containers");
+        return false;
+    }
+
+    m_elements.clear();
+    if (dict)
+    {
+        ns3penv::DictDataContainer* dictMsg = obsMsg->mutable_dict();
+        dictMsg->Clear();
+        for (const std::string* name : m_names)
+        {
+            ns3penv::DataContainer* element = dictMsg->add_element();
+            element->set_name(*name);
+            m_elements.push_back(element);
+        }
+        m_dataTag = MessageTag(ns3penv::DataContainer::kDictFieldNumber);
+        m_elementTag = MessageTag(ns3penv::DictDataContainer::kElementFieldNumber);
+    }
+    else
+    {
+        ns3penv::TupleDataContainer* tupleMsg = obsMsg->mutable_tuple();
+        tupleMsg->Clear();
+        for (std::size_t i = 0; i < m_children.size(); ++i)
+        {
+            m_elements.push_back(tupleMsg->add_element());
+        }
+        m_dataTag = MessageTag(ns3penv::DataContainer::kTupleFieldNumber);
+        m_elementTag = MessageTag(ns3penv::TupleDataContainer::kElementFieldNumber);
+    }
+
+    m_sizes.resize(m_children.size());
+    Run(&OpenGymParallelEncoder::FillElement, m_children.size());
+    m_parallel = true;
+    return true;
+}
+
+void
+OpenGymParallelEncoder::FillElement(uint32_t index)
+{
+    m_children[index]->GetDataContainerPbMsg(m_elements[index]);
+    size_t size = m_elements[index]->ByteSizeLong();
+    NS_ABORT_MSG_IF(size > INT32_MAX, "Observation element too large");
+    m_sizes[index] = size;
+}
+
+size_t
+OpenGymParallelEncoder::ByteSize(ns3penv::EnvStateMsg* msg)
+{
+    if (!m_parallel)
+    {
+        m_lastSize = msg->ByteSizeLong();
+        return m_lastSize;
+    }
+
+    uint64_t elementsSize = 0;
+    m_offsets.resize(m_sizes.size());
+    for (std::size_t i = 0; i < m_sizes.size(); ++i)
+    {
+        m_offsets[i] = elementsSize;
+        elementsSize += FieldSize(m_elementTag, m_sizes[i]);
+    }
+    uint64_t dataSize = FieldSize(m_dataTag, elementsSize);
+    NS_ABORT_MSG_IF(dataSize > INT32_MAX, "Observation too large");
+    m_elementsSize = elementsSize;
+
+    // the observation is field 1, everything else follows it
+    ns3penv::DataContainer* obsMsg = msg->unsafe_arena_release_obsdata();
+    m_restSize = msg->ByteSizeLong();
+    msg->unsafe_arena_set_allocated_obsdata(obsMsg);
+
+    m_lastSize =
+        FieldSize(MessageTag(ns3penv::EnvStateMsg::kObsDataFieldNumber), dataSize) + m_restSize;
+    return m_lastSize;
+}
+
+void
+OpenGymParallelEncoder::Serialize(ns3penv::EnvStateMsg* msg, uint8_t* buffer)
+{
+    if (!m_parallel)
+    {
+        msg->SerializeWithCachedSizesToArray(buffer);
+        return;
+    }
+
+    uint8_t* out = buffer;
+    uint32_t dataSize = FieldSize(m_dataTag, m_elementsSize);
+    out = CodedOutputStream::WriteTagToArray(
+        MessageTag(ns3penv::EnvStateMsg::kObsDataFieldNumber),
+        out);
+    out = CodedOutputStream::WriteVarint32ToArray(dataSize, out);
+    out = CodedOutputStream::WriteTagToArray(m_dataTag, out);
+    out = CodedOutputStream::WriteVarint32ToArray(m_elementsSize, out);
+    m_buffer = out;
+    Run(&OpenGymParallelEncoder::SerializeElement, m_elements.size());
+    out += m_elementsSize;
+
+    ns3penv::DataContainer* obsMsg = msg->unsafe_arena_release_obsdata();
+    msg->SerializeWithCachedSizesToArray(out);
+    msg->unsafe_arena_set_allocated_obsdata(obsMsg);
+    m_parallel = false;
+}
+
+void
+OpenGymParallelEncoder::SerializeElement(uint32_t index)
+{
+    uint8_t* out = m_buffer + m_offsets[index];
+    out = CodedOutputStream::WriteTagToArray(m_elementTag, out);
+    out = CodedOutputStream::WriteVarint32ToArray(m_sizes[index], out);
+    m_elements[index]->SerializeWithCachedSizesToArray(out);
+}
+
+} // namespace ns3
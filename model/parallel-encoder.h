@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#ifndef OPENGYM_PARALLEL_ENCODER_H
+#define OPENGYM_PARALLEL_ENCODER_H
+
+#include "container.h"
+#include "messages.pb.h"
+
+#include <ns3/object.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @brief Encodes the elements of a dict or tuple observation on a pool of
+ * worker threads
+ *
+ * Fill writes every element into its own message concurrently and sizes
+ * it. ByteSize then lays the elements out back to back, exactly where
+ * protobuf puts them, and Serialize writes each one into its region of the
+ * buffer concurrently, so the bytes are those of EnvStateMsg::SerializeToArray.
+ *
+ * A state is encoded in parallel when the previous one was at least the
+ * threshold in size, otherwise sequentially. The elements must not share
+ * containers, as they are encoded by different threads.
+ */
+class OpenGymParallelEncoder : public Object
+{
+  public:
+    OpenGymParallelEncoder();
+    ~OpenGymParallelEncoder() override;
+
+    static TypeId GetTypeId();
+
+    /**
+     * @brief start the workers, which the calling thread joins during the
+     * encoding
+     * @param threads number of workers besides the calling thread
+     * @param threshold bytes of a state from which on the next one is
+     * encoded in parallel
+     */
+    void Start(uint32_t threads, uint32_t threshold);
+
+    /**
+     * @brief fill the observation of a state, in parallel if it is a dict or
+     * a tuple of distinct containers and the previous state was large
+     * @returns false, leaving obsMsg as it was, when the observation is to
+     * be filled sequentially instead
+     */
+    bool Fill(Ptr<OpenGymDataContainer> obs, ns3penv::DataContainer* obsMsg);
+
+    /** @brief get the serialized size of the state, once it is complete */
+    size_t ByteSize(ns3penv::EnvStateMsg* msg);
+
+    /** @brief serialize the state into the ByteSize bytes of buffer */
+    void Serialize(ns3penv::EnvStateMsg* msg, uint8_t* buffer);
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    typedef void (OpenGymParallelEncoder::*Task)(uint32_t index);
+
+    /** @brief run task for every index below count on all the threads */
+    void Run(Task task, uint32_t count);
+    void Work();
+    void WorkerLoop();
+    void Stop();
+
+    void FillElement(uint32_t index);
+    void SerializeElement(uint32_t index);
+
+    uint32_t m_threshold;
+    bool m_parallel;       // whether the state being encoded was filled by Fill
+    size_t m_lastSize;     // bytes of the previous state
+    uint32_t m_dataTag;    // tag of the tuple or dict of the observation
+    uint32_t m_elementTag; // tag of its elements
+    uint32_t m_elementsSize;
+    size_t m_restSize; // bytes of the fields after the observation
+    uint8_t* m_buffer;
+
+    std::vector<OpenGymDataContainer*> m_children;
+    std::vector<const std::string*> m_names; // of the dict entries
+    std::vector<ns3penv::DataContainer*> m_elements;
+    std::vector<uint32_t> m_sizes;
+    std::vector<uint32_t> m_offsets;               // of each element in the elements
+    std::vector<OpenGymDataContainer*> m_distinct; // sorted m_children
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake; // workers wait for a batch
+    std::condition_variable m_done; // the caller waits for the workers
+    uint64_t m_batch;               // incremented for every batch
+    uint32_t m_busy;                // workers still in the batch
+    bool m_stop;
+    Task m_task;
+    uint32_t m_count;
+    std::atomic<uint32_t> m_next; // next index of the batch to run
+};
+
+} // namespace ns3
+
+#endif /* OPENGYM_PARALLEL_ENCODER_H */
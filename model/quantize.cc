@@ -0,0 +1,557 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#include "quantize.h"
+
+#include <ns3/abort.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(NS3PENV_NO_SIMD)
+#define NS3PENV_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace ns3
+{
+
+static uint16_t
+FloatToHalfBits(float value)
+{
+    uint32_t f;
+    std::memcpy(&f, &value, sizeof(f));
+    uint32_t sign = (f >> 16) & 0x8000;
+    uint32_t exponent = (f >> 23) & 0xFF;
+    uint32_t mantissa = f & 0x7FFFFF;
+    if (exponent == 0xFF)
+    {
+        // infinity, or a quiet NaN keeping the top of the payload
+        return sign | 0x7C00 | (mantissa ? 0x200 | (mantissa >> 13) : 0);
+    }
+    int32_t e = int32_t(exponent) - 127 + 15;
+    if (e >= 0x1F)
+    {
+        return sign | 0x7C00;
+    }
+    uint32_t half;
+    uint32_t rest;
+    uint32_t midpoint;
+    if (e <= 0)
+    {
+        // subnormal half, or zero
+        if (e < -10)
+        {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = 14 - e;
+        half = mantissa >> shift;
+        rest = mantissa & ((1U << shift) - 1);
+        midpoint = 1U << (shift - 1);
+    }
+    else
+    {
+        half = (uint32_t(e) << 10) | (mantissa >> 13);
+        rest = mantissa & 0x1FFF;
+        midpoint = 0x1000;
+    }
+    // round to nearest even, a carry into the exponent is still correct
+    if (rest > midpoint || (rest == midpoint && (half & 1)))
+    {
+        ++half;
+    }
+    return sign | half;
+}
+
+static float
+HalfBitsToFloat(uint16_t half)
+{
+    uint32_t sign = uint32_t(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    uint32_t f;
+    if (exponent == 0x1F)
+    {
+        f = sign | 0x7F800000 | (mantissa << 13);
+    }
+    else if (exponent != 0)
+    {
+        f = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    else if (mantissa == 0)
+    {
+        f = sign;
+    }
+    else
+    {
+        // subnormal half, normal as a float
+        exponent = 113;
+        while (!(mantissa & 0x400))
+        {
+            mantissa <<= 1;
+            --exponent;
+        }
+        f = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    }
+    float value;
+    std::memcpy(&value, &f, sizeof(value));
+    return value;
+}
+
+OpenGymFloat16::OpenGymFloat16(float value)
+    : bits(FloatToHalfBits(value))
+{
+}
+
+OpenGymFloat16::operator float() const
+{
+    return HalfBitsToFloat(bits);
+}
+
+/** The quantized value of one float, clamped before rounding so NaN maps to lo */
+static inline int32_t
+QuantizeValue(float value, float inverse, float zeroPoint, float lo, float hi)
+{
+    float q = value * inverse + zeroPoint;
+    q = std::min(hi, std::max(lo, q));
+    return static_cast<int32_t>(std::nearbyint(q));
+}
+
+#ifdef NS3PENV_X86_SIMD
+
+static bool
+HasF16c()
+{
+    static const bool has = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+    return has;
+}
+
+static bool
+HasAvx2()
+{
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+}
+
+__attribute__((target("avx,f16c"))) static std::size_t
+FloatToHalfF16c(const float* src, OpenGymFloat16* dst, std::size_t count)
+{
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), half);
+    }
+    return i;
+}
+
+__attribute__((target("avx,f16c"))) static std::size_t
+HalfToFloatF16c(const OpenGymFloat16* src, float* dst, std::size_t count)
+{
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(half));
+    }
+    return i;
+}
+
+/** Quantizes 8 floats at a time, returns how many were done */
+template <bool Unsigned>
+__attribute__((target("avx2"))) static std::size_t
+QuantizeAvx2(const float* src,
+             void* dst,
+             std::size_t count,
+             float inverse,
+             float zeroPoint,
+             float lo,
+             float hi)
+{
+    const __m256 vInverse = _mm256_set1_ps(inverse);
+    const __m256 vZeroPoint = _mm256_set1_ps(zeroPoint);
+    const __m256 vLo = _mm256_set1_ps(lo);
+    const __m256 vHi = _mm256_set1_ps(hi);
+    uint8_t* out = static_cast<uint8_t*>(dst);
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 q = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), vInverse), vZeroPoint);
+        // max returns its second operand for NaN, as the scalar path
+        q = _mm256_min_ps(vHi, _mm256_max_ps(q, vLo));
+        __m256i values = _mm256_cvtps_epi32(q);
+        __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(values),
+                                        _mm256_extracti128_si256(values, 1));
+        __m128i bytes = Unsigned ? _mm_packus_epi16(words, words) : _mm_packs_epi16(words, words);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), bytes);
+    }
+    return i;
+}
+
+/** Clamps 256 bits of values at a time, returns how many were done */
+template <typename T>
+__attribute__((target("avx2"))) static std::size_t
+ClipAvx2(T* values, std::size_t count, T lo, T hi, uint32_t& changed)
+{
+    constexpr std::size_t lanes = 32 / sizeof(T);
+    std::size_t i = 0;
+    for (; i + lanes <= count; i += lanes)
+    {
+        T* p = values + i;
+        uint32_t same;
+        if constexpr (std::is_same_v<T, float>)
+        {
+            __m256 v = _mm256_loadu_ps(p);
+            // max returns its second operand for NaN, as the scalar path
+            __m256 c = _mm256_min_ps(_mm256_set1_ps(hi), _mm256_max_ps(v, _mm256_set1_ps(lo)));
+            _mm256_storeu_ps(p, c);
+            same = _mm256_movemask_ps(_mm256_cmp_ps(c, v, _CMP_EQ_OQ));
+            changed += lanes - __builtin_popcount(same);
+        }
+        else if constexpr (std::is_same_v<T, double>)
+        {
+            __m256d v = _mm256_loadu_pd(p);
+            __m256d c = _mm256_min_pd(_mm256_set1_pd(hi), _mm256_max_pd(v, _mm256_set1_pd(lo)));
+            _mm256_storeu_pd(p, c);
+            same = _mm256_movemask_pd(_mm256_cmp_pd(c, v, _CMP_EQ_OQ));
+            changed += lanes - __builtin_popcount(same);
+        }
+        else
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i c;
+            if constexpr (std::is_same_v<T, int32_t>)
+            {
+                c = _mm256_min_epi32(_mm256_set1_epi32(hi),
+                                     _mm256_max_epi32(v, _mm256_set1_epi32(lo)));
+            }
+            else if constexpr (std::is_same_v<T, uint32_t>)
+            {
+                c = _mm256_min_epu32(_mm256_set1_epi32(hi),
+                                     _mm256_max_epu32(v, _mm256_set1_epi32(lo)));
+            }
+            else if constexpr (std::is_same_v<T, int8_t>)
+            {
+                c = _mm256_min_epi8(_mm256_set1_epi8(hi),
+                                    _mm256_max_epi8(v, _mm256_set1_epi8(lo)));
+            }
+            else
+            {
+                static_assert(std::is_same_v<T, uint8_t>);
+                c = _mm256_min_epu8(_mm256_set1_epi8(hi),
+                                    _mm256_max_epu8(v, _mm256_set1_epi8(lo)));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), c);
+            // one bit per byte, sizeof(T) bits per value
+            __m256i equal = sizeof(T) == 4 ? _mm256_cmpeq_epi32(c, v) : _mm256_cmpeq_epi8(c, v);
+            same = _mm256_movemask_epi8(equal);
+            changed += (32 - __builtin_popcount(same)) / sizeof(T);
+        }
+    }
+    return i;
+}
+
+/** Replaces the non-finite values 256 bits at a time, returns how many were done */
+template <typename T>
+__attribute__((target("avx2"))) static std::size_t
+ReplaceNonFiniteAvx2(T* values, std::size_t count, T replacement, uint32_t& changed)
+{
+    constexpr std::size_t lanes = 32 / sizeof(T);
+    std::size_t i = 0;
+    for (; i + lanes <= count; i += lanes)
+    {
+        T* p = values + i;
+        uint32_t finite;
+        // v - v is 0 for finite values and NaN otherwise
+        if constexpr (std::is_same_v<T, float>)
+        {
+            __m256 v = _mm256_loadu_ps(p);
+            __m256 mask = _mm256_cmp_ps(_mm256_sub_ps(v, v), _mm256_setzero_ps(), _CMP_EQ_OQ);
+            _mm256_storeu_ps(p, _mm256_blendv_ps(_mm256_set1_ps(replacement), v, mask));
+            finite = _mm256_movemask_ps(mask);
+        }
+        else
+        {
+            static_assert(std::is_same_v<T, double>);
+            __m256d v = _mm256_loadu_pd(p);
+            __m256d mask = _mm256_cmp_pd(_mm256_sub_pd(v, v), _mm256_setzero_pd(), _CMP_EQ_OQ);
+            _mm256_storeu_pd(p, _mm256_blendv_pd(_mm256_set1_pd(replacement), v, mask));
+            finite = _mm256_movemask_pd(mask);
+        }
+        changed += lanes - __builtin_popcount(finite);
+    }
+    return i;
+}
+
+#endif
+
+/** The bounds of values of type T within [low, high], rounded inwards */
+template <typename T>
+static void
+ClipBounds(float low, float high, T& lo, T& hi)
+{
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        lo = low;
+        hi = high;
+    }
+    else
+    {
+        const double min = std::numeric_limits<T>::min();
+        const double max = std::numeric_limits<T>::max();
+        double l = std::ceil(double(low));
+        double h = std::floor(double(high));
+        lo = l <= min   ? std::numeric_limits<T>::min()
+             : l >= max ? std::numeric_limits<T>::max()
+                        : T(l);
+        hi = h >= max   ? std::numeric_limits<T>::max()
+             : h <= min ? std::numeric_limits<T>::min()
+                        : T(h);
+    }
+}
+
+template <typename T>
+static uint32_t
+Clip(std::span<T> values, float low, float high)
+{
+    T lo;
+    T hi;
+    ClipBounds(low, high, lo, hi);
+    uint32_t changed = 0;
+    std::size_t i = 0;
+#ifdef NS3PENV_X86_SIMD
+    if constexpr (!std::is_same_v<T, int64_t>)
+    {
+        // AVX2 has no 64-bit integer min and max
+        if (HasAvx2())
+        {
+            i = ClipAvx2(values.data(), values.size(), lo, hi, changed);
+        }
+    }
+#endif
+    for (; i < values.size(); ++i)
+    {
+        // the operand order of the AVX2 min and max, NaN becomes lo
+        T value = values[i];
+        T clipped = value > lo ? value : lo;
+        clipped = hi < clipped ? hi : clipped;
+        changed += !(clipped == value);
+        values[i] = clipped;
+    }
+    return changed;
+}
+
+uint32_t
+OpenGymClip(std::span<float> values, float low, float high)
+{
+    return Clip(values, low, high);
+}
+
+uint32_t
+OpenGymClip(std::span<double> values, float low, float high)
+{
+    return Clip(values, low, high);
+}
+
+uint32_t
+OpenGymClip(std::span<int32_t> values, float low, float high)
+{
+    return Clip(values, low, high);
+}
+
+uint32_t
+OpenGymClip(std::span<uint32_t> values, float low, float high)
+{
+    return Clip(values, low, high);
+}
+
+uint32_t
+OpenGymClip(std::span<int64_t> values, float low, float high)
+{
+    return Clip(values, low, high);
+}
+
+uint32_t
+OpenGymClip(std::span<int8_t> values, float low, float high)
+{
+    return Clip(values, low, high);
+}
+
+uint32_t
+OpenGymClip(std::span<uint8_t> values, float low, float high)
+{
+    return Clip(values, low, high);
+}
+
+uint32_t
+OpenGymClip(std::span<OpenGymFloat16> values, float low, float high)
+{
+    uint32_t changed = 0;
+    for (auto& value : values)
+    {
+        float v = value;
+        float clipped = v > low ? v : low;
+        clipped = high < clipped ? high : clipped;
+        if (!(clipped == v))
+        {
+            // the bounds are rounded to the nearest half, not inwards
+            value = OpenGymFloat16(clipped);
+            ++changed;
+        }
+    }
+    return changed;
+}
+
+template <typename T>
+static uint32_t
+ReplaceNonFinite(std::span<T> values, float replacement)
+{
+    uint32_t changed = 0;
+    std::size_t i = 0;
+#ifdef NS3PENV_X86_SIMD
+    if (HasAvx2())
+    {
+        i = ReplaceNonFiniteAvx2<T>(values.data(), values.size(), replacement, changed);
+    }
+#endif
+    for (; i < values.size(); ++i)
+    {
+        if (!std::isfinite(values[i]))
+        {
+            values[i] = replacement;
+            ++changed;
+        }
+    }
+    return changed;
+}
+
+uint32_t
+OpenGymReplaceNonFinite(std::span<float> values, float replacement)
+{
+    return ReplaceNonFinite(values, replacement);
+}
+
+uint32_t
+OpenGymReplaceNonFinite(std::span<double> values, float replacement)
+{
+    return ReplaceNonFinite(values, replacement);
+}
+
+uint32_t
+OpenGymReplaceNonFinite(std::span<OpenGymFloat16> values, float replacement)
+{
+    const OpenGymFloat16 half(replacement);
+    uint32_t changed = 0;
+    for (auto& value : values)
+    {
+        // all exponent bits set: infinity or NaN
+        if ((value.bits & 0x7C00) == 0x7C00)
+        {
+            value = half;
+            ++changed;
+        }
+    }
+    return changed;
+}
+
+void
+OpenGymFloatToHalf(std::span<const float> src, std::span<OpenGymFloat16> dst)
+{
+    NS_ABORT_MSG_IF(src.size() != dst.size(), "Conversion between spans of different sizes");
+    std::size_t i = 0;
+#ifdef NS3PENV_X86_SIMD
+    if (HasF16c())
+    {
+        i = FloatToHalfF16c(src.data(), dst.data(), src.size());
+    }
+#endif
+    for (; i < src.size(); ++i)
+    {
+        dst[i] = OpenGymFloat16(src[i]);
+    }
+}
+
+void
+OpenGymHalfToFloat(std::span<const OpenGymFloat16> src, std::span<float> dst)
+{
+    NS_ABORT_MSG_IF(src.size() != dst.size(), "Conversion between spans of different sizes");
+    std::size_t i = 0;
+#ifdef NS3PENV_X86_SIMD
+    if (HasF16c())
+    {
+        i = HalfToFloatF16c(src.data(), dst.data(), src.size());
+    }
+#endif
+    for (; i < src.size(); ++i)
+    {
+        dst[i] = src[i];
+    }
+}
+
+template <typename T>
+static void
+Quantize(std::span<const float> src, std::span<T> dst, float scale, int32_t zeroPoint)
+{
+    NS_ABORT_MSG_IF(src.size() != dst.size(), "Conversion between spans of different sizes");
+    NS_ABORT_MSG_IF(!(scale > 0), "Quantization needs a positive scale");
+    const float inverse = 1.0f / scale;
+    const float zero = zeroPoint;
+    const float lo = std::numeric_limits<T>::min();
+    const float hi = std::numeric_limits<T>::max();
+    std::size_t i = 0;
+#ifdef NS3PENV_X86_SIMD
+    if (HasAvx2())
+    {
+        i = QuantizeAvx2<std::is_unsigned_v<T>>(src.data(),
+                                                 dst.data(),
+                                                 src.size(),
+                                                 inverse,
+                                                 zero,
+                                                 lo,
+                                                 hi);
+    }
+#endif
+    for (; i < src.size(); ++i)
+    {
+        dst[i] = static_cast<T>(QuantizeValue(src[i], inverse, zero, lo, hi));
+    }
+}
+
+void
+OpenGymQuantize(std::span<const float> src,
+                std::span<int8_t> dst,
+                float scale,
+                int32_t zeroPoint)
+{
+    Quantize(src, dst, scale, zeroPoint);
+}
+
+void
+OpenGymQuantize(std::span<const float> src,
+                std::span<uint8_t> dst,
+                float scale,
+                int32_t zeroPoint)
+{
+    Quantize(src, dst, scale, zeroPoint);
+}
+
+} // namespace ns3
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#ifndef OPENGYM_QUANTIZE_H
+#define OPENGYM_QUANTIZE_H
+
+#include <ns3/type-name.h>
+
+#include <cstdint>
+#include <span>
+
+namespace ns3
+{
+
+/**
+ * @brief An IEEE 754 half-precision value, the value type of FLOAT16 boxes
+ *
+ * Only storage: it converts to and from float, rounding to nearest even,
+ * and compares bitwise.
+ */
+struct OpenGymFloat16
+{
+    uint16_t bits = 0;
+
+    OpenGymFloat16() = default;
+    OpenGymFloat16(float value);
+    operator float() const;
+
+    bool operator==(const OpenGymFloat16& other) const = default;
+};
+
+TYPENAMEGET_DEFINE(OpenGymFloat16);
+
+/*
+ * Bulk conversions for filling boxes of the compact dtypes in place, for
+ * instance through OpenGymBoxContainer::MutableView. src and dst must have
+ * the same size. On x86-64 they use F16C and AVX2 when the CPU has them,
+ * unless the module is built with NS3PENV_NO_SIMD.
+ */
+
+/** @brief convert floats to half precision */
+void OpenGymFloatToHalf(std::span<const float> src, std::span<OpenGymFloat16> dst);
+
+/** @brief convert half precision values to floats */
+void OpenGymHalfToFloat(std::span<const OpenGymFloat16> src, std::span<float> dst);
+
+/**
+ * @brief quantize floats as round(x / scale) + zeroPoint, saturated to the
+ * range of int8. NaN maps to the lowest value.
+ */
+void OpenGymQuantize(std::span<const float> src,
+                     std::span<int8_t> dst,
+                     float scale,
+                     int32_t zeroPoint = 0);
+
+/** @brief like the int8 OpenGymQuantize, saturated to the range of uint8 */
+void OpenGymQuantize(std::span<const float> src,
+                     std::span<uint8_t> dst,
+                     float scale,
+                     int32_t zeroPoint = 0);
+
+/*
+ * Bounds checks of box values in place, with AVX2 kernels on x86-64 as
+ * above. They return how many values they changed.
+ */
+
+/**
+ * @brief clamp the values to [low, high], rounded inwards to the values
+ * the dtype can hold. NaN becomes low.
+ */
+uint32_t OpenGymClip(std::span<float> values, float low, float high);
+uint32_t OpenGymClip(std::span<double> values, float low, float high);
+uint32_t OpenGymClip(std::span<int32_t> values, float low, float high);
+uint32_t OpenGymClip(std::span<uint32_t> values, float low, float high);
+uint32_t OpenGymClip(std::span<int64_t> values, float low, float high);
+uint32_t OpenGymClip(std::span<int8_t> values, float low, float high);
+uint32_t OpenGymClip(std::span<uint8_t> values, float low, float high);
+uint32_t OpenGymClip(std::span<OpenGymFloat16> values, float low, float high);
+
+/** @brief replace NaN and infinite values with replacement */
+uint32_t OpenGymReplaceNonFinite(std::span<float> values, float replacement);
+uint32_t OpenGymReplaceNonFinite(std::span<double> values, float replacement);
+uint32_t OpenGymReplaceNonFinite(std::span<OpenGymFloat16> values, float replacement);
+
+} // namespace ns3
+
+#endif /* OPENGYM_QUANTIZE_H */
@@ -25,12 +25,16 @@
 #include "ns3/log.h"
 #include "ns3/object.h"
 
+#include <algorithm>
+
 namespace ns3
 {
 
 NS_LOG_COMPONENT_DEFINE("OpenGymSpace");
 NS_OBJECT_ENSURE_REGISTERED(OpenGymSpace);
 
+uint64_t OpenGymSpace::s_revision = 1;
+
 TypeId
 OpenGymSpace::GetTypeId()
 {
@@ -39,6 +43,7 @@ OpenGymSpace::GetTypeId()
 }
 
 OpenGymSpace::OpenGymSpace()
+    : m_descRevision(0)
 {
     NS_LOG_FUNCTION(this);
 }
@@ -54,6 +59,31 @@ OpenGymSpace::DoDispose()
     NS_LOG_FUNCTION(this);
 }
 
+uint32_t
+OpenGymSpace::GetMaxDataSize() const
+{
+    return 0;
+}
+
+const ns3penv::SpaceDescription&
+OpenGymSpace::GetCachedSpaceDescription()
+{
+    // a single global revision is enough: spaces are built once at start
+    // up, and a tuple or dict also goes stale when a nested space changes
+    if (m_descRevision != s_revision)
+    {
+        m_desc = GetSpaceDescription();
+        m_descRevision = s_revision;
+    }
+    return m_desc;
+}
+
+void
+OpenGymSpace::NotifySpaceChanged()
+{
+    ++s_revision;
+}
+
 void
 OpenGymSpace::DoInitialize()
 {
@@ -121,6 +151,13 @@ OpenGymDiscreteSpace::Print(std::ostream& where) const
     where << " DiscreteSpace N: " << m_n;
 }
 
+uint32_t
+OpenGymDiscreteSpace::GetMaxDataSize() const
+{
+    // container tag and length, a varint int32 and the optional name
+    return 32;
+}
+
 TypeId
 OpenGymBoxSpace::GetTypeId()
 {
@@ -186,11 +223,27 @@ void
 OpenGymBoxSpace::SetDtype()
 {
     std::string name = m_dtypeName;
-    if (name == "int8_t" || name == "int16_t" || name == "int32_t" || name == "int64_t")
+    if (name == "int8_t")
+    {
+        m_dtype = ns3penv::INT8;
+    }
+    else if (name == "uint8_t")
+    {
+        m_dtype = ns3penv::UINT8;
+    }
+    else if (name == "int64_t")
+    {
+        m_dtype = ns3penv::INT64;
+    }
+    else if (name == "float16" || name == "OpenGymFloat16")
+    {
+        m_dtype = ns3penv::FLOAT16;
+    }
+    else if (name == "int16_t" || name == "int32_t")
     {
         m_dtype = ns3penv::INT;
     }
-    else if (name == "uint8_t" || name == "uint16_t" || name == "uint32_t" || name == "uint64_t")
+    else if (name == "uint16_t" || name == "uint32_t" || name == "uint64_t")
     {
         m_dtype = ns3penv::UINT;
     }
@@ -229,6 +282,18 @@ OpenGymBoxSpace::GetShape()
     return m_shape;
 }
 
+std::string
+OpenGymBoxSpace::GetDtypeName() const
+{
+    return m_dtypeName;
+}
+
+ns3penv::Dtype
+OpenGymBoxSpace::GetDtype() const
+{
+    return m_dtype;
+}
+
 ns3penv::SpaceDescription
 OpenGymBoxSpace::GetSpaceDescription()
 {
@@ -261,6 +326,43 @@ OpenGymBoxSpace::Print(std::ostream& where) const
     where << ") Dtype: " << m_dtypeName;
 }
 
+uint32_t
+OpenGymBoxSpace::GetMaxDataSize() const
+{
+    uint64_t count = 1;
+    for (const auto& dim : m_shape)
+    {
+        count *= dim;
+    }
+    // worst case per element: negative int32 and int64 varints take 10 bytes
+    uint64_t elementSize = 8;
+    switch (m_dtype)
+    {
+    case ns3penv::INT:
+    case ns3penv::INT64:
+        elementSize = 10;
+        break;
+    case ns3penv::INT8:
+    case ns3penv::UINT8:
+        elementSize = 1;
+        break;
+    case ns3penv::FLOAT16:
+        elementSize = 2;
+        break;
+    case ns3penv::UINT:
+        elementSize = 5;
+        break;
+    case ns3penv::FLOAT:
+        elementSize = 4;
+        break;
+    default:
+        break;
+    }
+    // dtype, packed shape and the tags and lengths around the data
+    uint64_t size = count * elementSize + 5 * m_shape.size() + 64;
+    return static_cast<uint32_t>(std::min<uint64_t>(size, UINT32_MAX));
+}
+
 TypeId
 OpenGymTupleSpace::GetTypeId()
 {
@@ -298,6 +400,7 @@ OpenGymTupleSpace::Add(Ptr<OpenGymSpace> space)
 {
     NS_LOG_FUNCTION(this);
     m_tuple.push_back(space);
+    NotifySpaceChanged();
     return true;
 }
 
@@ -322,15 +425,26 @@ OpenGymTupleSpace::GetSpaceDescription()
     ns3penv::SpaceDescription desc;
     ns3penv::TupleSpace* tupleSpacePb = desc.mutable_tuple();
 
+    tupleSpacePb->mutable_element()->Reserve(m_tuple.size());
     for (auto& subSpace : m_tuple)
     {
-        ns3penv::SpaceDescription subDesc = subSpace->GetSpaceDescription();
-        tupleSpacePb->add_element()->CopyFrom(subDesc);
+        *tupleSpacePb->add_element() = subSpace->GetCachedSpaceDescription();
     }
 
     return desc;
 }
 
+uint32_t
+OpenGymTupleSpace::GetMaxDataSize() const
+{
+    uint64_t size = 32;
+    for (const auto& subSpace : m_tuple)
+    {
+        size += subSpace->GetMaxDataSize() + 16;
+    }
+    return static_cast<uint32_t>(std::min<uint64_t>(size, UINT32_MAX));
+}
+
 void
 OpenGymTupleSpace::Print(std::ostream& where) const
 {
@@ -381,6 +495,7 @@ OpenGymDictSpace::Add(std::string key, Ptr<OpenGymSpace> space)
 {
     NS_LOG_FUNCTION(this);
     m_dict.insert(std::pair<std::string, Ptr<OpenGymSpace>>(key, space));
+    NotifySpaceChanged();
     return true;
 }
 
@@ -406,17 +521,29 @@ OpenGymDictSpace::GetSpaceDescription()
 
     ns3penv::DictSpace* dictSpace = desc.mutable_dict();
 
+    dictSpace->mutable_element()->Reserve(m_dict.size());
     for (const auto& [name, subSpace] : m_dict)
     {
-        ns3penv::SpaceDescription subDesc = subSpace->GetSpaceDescription();
-        subDesc.set_name(name);
-
-        dictSpace->add_element()->CopyFrom(subDesc);
+        ns3penv::SpaceDescription* subDesc = dictSpace->add_element();
+        *subDesc = subSpace->GetCachedSpaceDescription();
+        subDesc->set_name(name);
     }
 
     return desc;
 }
 
+uint32_t
+OpenGymDictSpace::GetMaxDataSize() const
+{
+    uint64_t size = 32;
+    for (const auto& [name, subSpace] : m_dict)
+    {
+        // each element also carries its key as the container name
+        size += subSpace->GetMaxDataSize() + name.size() + 16;
+    }
+    return static_cast<uint32_t>(std::min<uint64_t>(size, UINT32_MAX));
+}
+
 void
 OpenGymDictSpace::Print(std::ostream& where) const
 {
@@ -54,10 +54,34 @@ class OpenGymSpace : public Object
     virtual ns3penv::SpaceDescription GetSpaceDescription() = 0;
     virtual void Print(std::ostream& where) const = 0;
 
+    /** \brief Get the space description, built once and kept until a
+     * space is mutated
+     *
+     * \return The memoized space description.
+     */
+    const ns3penv::SpaceDescription& GetCachedSpaceDescription();
+
+    /** \brief Get an upper bound of the encoded size of one data container
+     * of this space, used to size the shared memory buffers up front
+     *
+     * \return The size in bytes, or 0 if it is not known.
+     */
+    virtual uint32_t GetMaxDataSize() const;
+
   protected:
     // Inherited
     void DoInitialize() override;
     void DoDispose() override;
+
+    /** \brief Invalidate the memoized descriptions, to be called by
+     * spaces that change after construction
+     */
+    static void NotifySpaceChanged();
+
+  private:
+    static uint64_t s_revision; // bumped whenever any space changes
+    uint64_t m_descRevision;    // revision m_desc was built at, 0 if never
+    ns3penv::SpaceDescription m_desc;
 };
 
 /**
@@ -78,6 +102,7 @@ class OpenGymDiscreteSpace : public OpenGymSpace
 
     int GetN();
     void Print(std::ostream& where) const override;
+    uint32_t GetMaxDataSize() const override;
 
     friend std::ostream& operator<<(std::ostream& os, const Ptr<OpenGymDiscreteSpace> space)
     {
@@ -112,8 +137,12 @@ class OpenGymBoxSpace : public OpenGymSpace
     float GetLow();
     float GetHigh();
     std::vector<uint32_t> GetShape();
+    /** @brief get the dtype name the space was created with */
+    std::string GetDtypeName() const;
+    ns3penv::Dtype GetDtype() const;
 
     void Print(std::ostream& where) const override;
+    uint32_t GetMaxDataSize() const override;
 
     friend std::ostream& operator<<(std::ostream& os, const Ptr<OpenGymBoxSpace> space)
     {
@@ -153,6 +182,7 @@ class OpenGymTupleSpace : public OpenGymSpace
     Ptr<OpenGymSpace> Get(uint32_t idx);
 
     void Print(std::ostream& where) const override;
+    uint32_t GetMaxDataSize() const override;
 
     friend std::ostream& operator<<(std::ostream& os, const Ptr<OpenGymTupleSpace> space)
     {
@@ -183,6 +213,7 @@ class OpenGymDictSpace : public OpenGymSpace
     Ptr<OpenGymSpace> Get(std::string key);
 
     void Print(std::ostream& where) const override;
+    uint32_t GetMaxDataSize() const override;
 
     friend std::ostream& operator<<(std::ostream& os, const Ptr<OpenGymDictSpace> space)
     {
@@ -0,0 +1,690 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#include "trajectory-recorder.h"
+
+#include "container.h"
+
+#include <ns3/abort.h>
+#include <ns3/log.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("OpenGymTrajectoryRecorder");
+
+NS_OBJECT_ENSURE_REGISTERED(OpenGymTrajectoryRecorder);
+
+/** Full chunks waiting for the writer before the simulation waits too */
+static constexpr std::size_t MAX_QUEUED_CHUNKS = 4;
+
+/** Bytes of a chunk above which it takes fewer than chunkSteps rows */
+static constexpr uint64_t MAX_CHUNK_BYTES = 64 << 20;
+
+/** The numpy name of a Box dtype */
+static const char*
+NumpyDtype(ns3penv::Dtype dtype)
+{
+    switch (dtype)
+    {
+    case ns3penv::INT:
+        return "int32";
+    case ns3penv::UINT:
+        return "uint32";
+    case ns3penv::FLOAT:
+        return "float32";
+    case ns3penv::DOUBLE:
+        return "float64";
+    case ns3penv::INT8:
+        return "int8";
+    case ns3penv::UINT8:
+        return "uint8";
+    case ns3penv::INT64:
+        return "int64";
+    case ns3penv::FLOAT16:
+        return "float16";
+    default:
+        return "";
+    }
+}
+
+static std::string
+JsonString(const std::string& s)
+{
+    std::string out = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out += escape;
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+/** The file of a column, its name with anything unusual replaced */
+static std::string
+ColumnFile(const std::string& name)
+{
+    std::string file = name;
+    for (auto& c : file)
+    {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '.' && c != '-' && c != '_')
+        {
+            c = '_';
+        }
+    }
+    return file + ".bin";
+}
+
+/** Write all of data, aborting on failure */
+static void
+WriteAll(int fd, const uint8_t* data, std::size_t size, const std::string& name)
+{
+    while (size > 0)
+    {
+        ssize_t written = write(fd, data, size);
+        if (written < 0)
+        {
+            NS_ABORT_MSG_IF(errno != EINTR,
+                            "Cannot write the trajectory column " << name << ": "
+                                                                  << std::strerror(errno));
+            continue;
+        }
+        data += written;
+        size -= written;
+    }
+}
+
+TypeId
+OpenGymTrajectoryRecorder::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::OpenGymTrajectoryRecorder")
+                            .SetParent<Object>()
+                            .SetGroupName("OpenGym")
+                            .AddConstructor<OpenGymTrajectoryRecorder>();
+    return tid;
+}
+
+OpenGymTrajectoryRecorder::OpenGymTrajectoryRecorder()
+    : m_actColumn(0),
+      m_rewardColumn(0),
+      m_chunkSteps(0),
+      m_steps(0),
+      m_rowOpen(false),
+      m_mismatchLogged(false),
+      m_open(false),
+      m_chunk{{}, 0},
+      m_writing(false),
+      m_stop(false)
+{
+    NS_LOG_FUNCTION(this);
+}
+
+OpenGymTrajectoryRecorder::~OpenGymTrajectoryRecorder()
+{
+    NS_LOG_FUNCTION(this);
+    Close();
+}
+
+void
+OpenGymTrajectoryRecorder::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    Close();
+}
+
+bool
+OpenGymTrajectoryRecorder::Configure(const ns3penv::SpaceDescription& obsSpace,
+                                     const ns3penv::SpaceDescription& actSpace,
+                                     uint32_t chunkSteps)
+{
+    NS_LOG_FUNCTION(this << chunkSteps);
+    NS_ABORT_MSG_IF(m_open, "Cannot configure a trajectory recorder while it records");
+    m_columns.clear();
+    std::string obsLayout;
+    std::string actLayout;
+    if (chunkSteps == 0 || !AddColumns(obsSpace, "obs", obsLayout))
+    {
+        m_columns.clear();
+        return false;
+    }
+    m_actColumn = m_columns.size();
+    if (!AddColumns(actSpace, "action", actLayout))
+    {
+        m_columns.clear();
+        return false;
+    }
+    m_rewardColumn = m_columns.size();
+    PlanStruct(m_obsStruct, "obs", 0, m_actColumn);
+    PlanStruct(m_actStruct, "action", m_actColumn, m_rewardColumn);
+    m_columns.push_back({"reward", ns3penv::FLOAT, false, {}, sizeof(float), -1});
+    for (const char* flag : {"terminated", "truncated", "acted"})
+    {
+        m_columns.push_back({flag, ns3penv::UINT8, false, {}, 1, -1});
+    }
+
+    uint64_t rowBytes = 0;
+    for (const auto& column : m_columns)
+    {
+        rowBytes += column.rowBytes;
+    }
+    m_chunkSteps = std::clamp<uint64_t>(MAX_CHUNK_BYTES / rowBytes, 1, chunkSteps);
+    m_obsSpace = obsSpace;
+    m_actSpace = actSpace;
+    m_layout = "  \"obs\": " + obsLayout + ",\n  \"action\": " + actLayout + "\n";
+    return true;
+}
+
+void
+OpenGymTrajectoryRecorder::SetStructLayouts(const ns3penv::StructLayout& obs,
+                                            const ns3penv::StructLayout& act)
+{
+    NS_LOG_FUNCTION(this);
+    m_obsStruct = {obs, {}};
+    m_actStruct = {act, {}};
+}
+
+void
+OpenGymTrajectoryRecorder::PlanStruct(StructCopy& copy,
+                                      const std::string& name,
+                                      uint32_t first,
+                                      uint32_t last)
+{
+    copy.fields.clear();
+    if (copy.layout.field_size() == 0)
+    {
+        return;
+    }
+    // every column is a field, or it would keep the values of an older row
+    if (uint32_t(copy.layout.field_size()) != last - first)
+    {
+        NS_LOG_DEBUG("The " << name << " space is no longer the struct, copying it as it is");
+        return;
+    }
+    for (const auto& field : copy.layout.field())
+    {
+        std::string columnName = name + "." + field.name();
+        auto column = std::find_if(m_columns.begin() + first,
+                                   m_columns.begin() + last,
+                                   [&](const Column& c) { return c.name == columnName; });
+        if (column == m_columns.begin() + last || column->discrete ||
+            column->dtype != field.dtype() ||
+            !std::equal(column->shape.begin(),
+                        column->shape.end(),
+                        field.shape().begin(),
+                        field.shape().end()) ||
+            uint64_t(field.offset()) + column->rowBytes > copy.layout.size())
+        {
+            NS_LOG_DEBUG("The " << name << " space is no longer the struct, copying it as it is");
+            copy.fields.clear();
+            return;
+        }
+        copy.fields.emplace_back(field.offset(), uint32_t(column - m_columns.begin()));
+    }
+}
+
+bool
+OpenGymTrajectoryRecorder::AddColumns(const ns3penv::SpaceDescription& space,
+                                      const std::string& name,
+                                      std::string& layout)
+{
+    switch (space.space_variant_case())
+    {
+    case ns3penv::SpaceDescription::kDiscrete:
+        m_columns.push_back({name, ns3penv::INT64, true, {}, sizeof(int64_t), -1});
+        layout = "{\"discrete\": " + JsonString(name) +
+                 ", \"n\": " + std::to_string(space.discrete().n()) + "}";
+        return true;
+    case ns3penv::SpaceDescription::kBox: {
+        const auto& box = space.box();
+        uint64_t rowBytes = 0;
+        bool known = OpenGymVisitDtype(box.dtype(), [&](auto type) {
+            rowBytes = sizeof(typename decltype(type)::type);
+        });
+        std::vector<uint32_t> shape{box.shape().begin(), box.shape().end()};
+        for (const auto& dim : shape)
+        {
+            rowBytes *= dim;
+        }
+        if (!known || rowBytes > UINT32_MAX)
+        {
+            return false;
+        }
+        m_columns.push_back({name, box.dtype(), false, shape, uint32_t(rowBytes), -1});
+        layout = "{\"box\": " + JsonString(name) + "}";
+        return true;
+    }
+    case ns3penv::SpaceDescription::kTuple: {
+        layout = "{\"tuple\": [";
+        for (int i = 0; i < space.tuple().element_size(); ++i)
+        {
+            std::string element;
+            if (!AddColumns(space.tuple().element(i), name + "." + std::to_string(i), element))
+            {
+                return false;
+            }
+            layout += (i ? ", " : "") + element;
+        }
+        layout += "]}";
+        return true;
+    }
+    case ns3penv::SpaceDescription::kDict: {
+        layout = "{\"dict\": {";
+        for (int i = 0; i < space.dict().element_size(); ++i)
+        {
+            const auto& entry = space.dict().element(i);
+            std::string element;
+            if (!AddColumns(entry, name + "." + entry.name(), element))
+            {
+                return false;
+            }
+            layout += (i ? ", " : "") + JsonString(entry.name()) + ": " + element;
+        }
+        layout += "}}";
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+void
+OpenGymTrajectoryRecorder::Open(const std::string& path)
+{
+    NS_LOG_FUNCTION(this << path);
+    NS_ABORT_MSG_IF(m_columns.empty(), "Trajectory recorder is not configured");
+    Close();
+
+    std::error_code error;
+    std::filesystem::create_directories(path, error);
+    NS_ABORT_MSG_IF(error,
+                    "Cannot create the trajectory directory " << path << ": " << error.message());
+    std::string columns;
+    for (auto& column : m_columns)
+    {
+        std::string file = ColumnFile(column.name);
+        std::string filePath = path + "/" + file;
+        column.fd = open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        NS_ABORT_MSG_IF(column.fd < 0,
+                        "Cannot create " << filePath << ": " << std::strerror(errno));
+
+        std::string shape;
+        for (const auto& dim : column.shape)
+        {
+            shape += (shape.empty() ? "" : ", ") + std::to_string(dim);
+        }
+        columns += std::string(columns.empty() ? "" : ",\n") + "    {\"name\": " +
+                   JsonString(column.name) + ", \"file\": " + JsonString(file) +
+                   ", \"dtype\": \"" + NumpyDtype(column.dtype) + "\", \"shape\": [" + shape +
+                   "]}";
+    }
+    // written first, so a recording can be read while it grows
+    std::string layoutPath = path + "/layout.json";
+    std::ofstream layout(layoutPath, std::ios::trunc);
+    layout << "{\n  \"version\": 1,\n  \"steps_per_chunk\": " << m_chunkSteps
+           << ",\n  \"columns\": [\n"
+           << columns << "\n  ],\n"
+           << m_layout << "}\n";
+    layout.close();
+    NS_ABORT_MSG_IF(!layout, "Cannot write " << layoutPath);
+
+    m_chunk = NewChunk();
+    m_steps = 0;
+    m_rowOpen = false;
+    m_stop = false;
+    m_open = true;
+    m_writer = std::thread(&OpenGymTrajectoryRecorder::WriterLoop, this);
+}
+
+bool
+OpenGymTrajectoryRecorder::IsOpen() const
+{
+    return m_open;
+}
+
+void
+OpenGymTrajectoryRecorder::RecordState(Ptr<OpenGymDataContainer> obs,
+                                       float reward,
+                                       bool terminated,
+                                       bool truncated)
+{
+    if (!m_open)
+    {
+        return;
+    }
+    if (m_rowOpen)
+    {
+        CommitRow();
+    }
+    uint32_t column = 0;
+    if (CopyStruct(PeekPointer(obs), m_obsStruct))
+    {
+        column = m_actColumn;
+    }
+    else
+    {
+        CopyData(PeekPointer(obs), m_obsSpace, column);
+    }
+    // no action until RecordAction
+    CopyData(nullptr, m_actSpace, column);
+    std::memcpy(Cell(m_rewardColumn), &reward, sizeof(reward));
+    *Cell(m_rewardColumn + 1) = terminated;
+    *Cell(m_rewardColumn + 2) = truncated;
+    *Cell(m_rewardColumn + 3) = 0;
+    m_rowOpen = true;
+}
+
+void
+OpenGymTrajectoryRecorder::RecordAction(Ptr<OpenGymDataContainer> action)
+{
+    // the row is committed by the next state, which may still truncate it
+    if (!m_open || !m_rowOpen || *Cell(m_rewardColumn + 3))
+    {
+        return;
+    }
+    uint32_t column = m_actColumn;
+    if (!CopyStruct(PeekPointer(action), m_actStruct))
+    {
+        CopyData(PeekPointer(action), m_actSpace, column);
+    }
+    *Cell(m_rewardColumn + 3) = 1;
+}
+
+void
+OpenGymTrajectoryRecorder::Truncate()
+{
+    NS_LOG_FUNCTION(this);
+    if (!m_open || !m_rowOpen)
+    {
+        return;
+    }
+    // a terminated episode is not cut short
+    *Cell(m_rewardColumn + 2) = !*Cell(m_rewardColumn + 1);
+    CommitRow();
+}
+
+void
+OpenGymTrajectoryRecorder::Flush()
+{
+    NS_LOG_FUNCTION(this);
+    if (!m_open)
+    {
+        return;
+    }
+    if (m_rowOpen)
+    {
+        CommitRow();
+    }
+    if (m_chunk.rows > 0)
+    {
+        SubmitChunk();
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_queue.empty() && !m_writing; });
+}
+
+void
+OpenGymTrajectoryRecorder::Close()
+{
+    if (!m_open)
+    {
+        return;
+    }
+    NS_LOG_FUNCTION(this);
+    Flush();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_writer.join();
+    for (auto& column : m_columns)
+    {
+        close(column.fd);
+        column.fd = -1;
+    }
+    m_free.clear();
+    m_chunk = {{}, 0};
+    m_open = false;
+    NS_LOG_DEBUG("Recorded " << m_steps << " steps");
+}
+
+uint64_t
+OpenGymTrajectoryRecorder::GetSteps() const
+{
+    return m_steps;
+}
+
+void
+OpenGymTrajectoryRecorder::CopyData(OpenGymDataContainer* data,
+                                    const ns3penv::SpaceDescription& space,
+                                    uint32_t& column)
+{
+    switch (space.space_variant_case())
+    {
+    case ns3penv::SpaceDescription::kDiscrete: {
+        auto* discrete = dynamic_cast<OpenGymDiscreteContainer*>(data);
+        int64_t value = discrete ? discrete->GetValue() : 0;
+        std::memcpy(Cell(column++), &value, sizeof(value));
+        if (data && !discrete)
+        {
+            WarnMismatch(space);
+        }
+        return;
+    }
+    case ns3penv::SpaceDescription::kBox: {
+        const Column& to = m_columns[column];
+        uint8_t* cell = Cell(column++);
+        bool copied = false;
+        OpenGymVisitDtype(to.dtype, [&](auto type) {
+            auto* box = dynamic_cast<OpenGymBoxContainer<typename decltype(type)::type>*>(data);
+            if (box && box->GetDataView().size_bytes() == to.rowBytes)
+            {
+                std::memcpy(cell, box->GetDataView().data(), to.rowBytes);
+                copied = true;
+            }
+        });
+        if (!copied)
+        {
+            std::memset(cell, 0, to.rowBytes);
+            if (data)
+            {
+                WarnMismatch(space);
+            }
+        }
+        return;
+    }
+    case ns3penv::SpaceDescription::kTuple: {
+        auto* tuple = dynamic_cast<OpenGymTupleContainer*>(data);
+        if (data &&
+            (!tuple || tuple->GetElements().size() != std::size_t(space.tuple().element_size())))
+        {
+            WarnMismatch(space);
+            tuple = nullptr;
+        }
+        for (int i = 0; i < space.tuple().element_size(); ++i)
+        {
+            CopyData(tuple ? PeekPointer(tuple->GetElements()[i]) : nullptr,
+                     space.tuple().element(i),
+                     column);
+        }
+        return;
+    }
+    case ns3penv::SpaceDescription::kDict: {
+        auto* dict = dynamic_cast<OpenGymDictContainer*>(data);
+        if (data && !dict)
+        {
+            WarnMismatch(space);
+        }
+        for (const auto& entry : space.dict().element())
+        {
+            OpenGymDataContainer* value = nullptr;
+            if (dict)
+            {
+                auto it = dict->GetEntries().find(entry.name());
+                if (it == dict->GetEntries().end())
+                {
+                    WarnMismatch(entry);
+                }
+                else
+                {
+                    value = PeekPointer(it->second);
+                }
+            }
+            CopyData(value, entry, column);
+        }
+        return;
+    }
+    default:
+        return;
+    }
+}
+
+bool
+OpenGymTrajectoryRecorder::CopyStruct(OpenGymDataContainer* data, const StructCopy& copy)
+{
+    // a Dict is the generic form of the struct, which CopyData takes
+    if (copy.fields.empty() || !data || dynamic_cast<OpenGymDictContainer*>(data) ||
+        data->GetFlatDataSize() != copy.layout.size())
+    {
+        return false;
+    }
+    m_structBytes.resize(copy.layout.size());
+    Ns3penvFlatStateHeader header{};
+    data->SerializeFlat(&header, m_structBytes.data());
+    for (const auto& [offset, column] : copy.fields)
+    {
+        std::memcpy(Cell(column), m_structBytes.data() + offset, m_columns[column].rowBytes);
+    }
+    return true;
+}
+
+void
+OpenGymTrajectoryRecorder::WarnMismatch(const ns3penv::SpaceDescription& space)
+{
+    if (!m_mismatchLogged)
+    {
+        NS_LOG_WARN("Recorded data does not match its space " << space.ShortDebugString()
+                                                              << ", zeros are written instead");
+        m_mismatchLogged = true;
+    }
+}
+
+uint8_t*
+OpenGymTrajectoryRecorder::Cell(uint32_t column)
+{
+    return m_chunk.columns[column].data() + std::size_t(m_chunk.rows) * m_columns[column].rowBytes;
+}
+
+OpenGymTrajectoryRecorder::Chunk
+OpenGymTrajectoryRecorder::NewChunk() const
+{
+    Chunk chunk{std::vector<std::vector<uint8_t>>(m_columns.size()), 0};
+    for (std::size_t i = 0; i < m_columns.size(); ++i)
+    {
+        chunk.columns[i].resize(std::size_t(m_chunkSteps) * m_columns[i].rowBytes);
+    }
+    return chunk;
+}
+
+void
+OpenGymTrajectoryRecorder::CommitRow()
+{
+    m_rowOpen = false;
+    ++m_steps;
+    if (++m_chunk.rows == m_chunkSteps)
+    {
+        SubmitChunk();
+    }
+}
+
+void
+OpenGymTrajectoryRecorder::SubmitChunk()
+{
+    Chunk next;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        // the writer falling behind holds the simulation back, rather than
+        // memory growing without bound
+        m_idle.wait(lock, [this] { return m_queue.size() < MAX_QUEUED_CHUNKS; });
+        m_queue.push_back(std::move(m_chunk));
+        if (!m_free.empty())
+        {
+            next = std::move(m_free.back());
+            m_free.pop_back();
+        }
+    }
+    m_wake.notify_one();
+    m_chunk = next.columns.empty() ? NewChunk() : std::move(next);
+    m_chunk.rows = 0;
+}
+
+void
+OpenGymTrajectoryRecorder::WriterLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_wake.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+        if (m_queue.empty())
+        {
+            return;
+        }
+        Chunk chunk = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_writing = true;
+        lock.unlock();
+        for (std::size_t i = 0; i < m_columns.size(); ++i)
+        {
+            WriteAll(m_columns[i].fd,
+                     chunk.columns[i].data(),
+                     std::size_t(chunk.rows) * m_columns[i].rowBytes,
+                     m_columns[i].name);
+        }
+        lock.lock();
+        m_writing = false;
+        m_free.push_back(std::move(chunk));
+        m_idle.notify_all();
+    }
+}
+
+} // namespace ns3
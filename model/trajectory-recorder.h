@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2025 NCSR Demokritos, Greece
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+ */
+
+#ifndef OPENGYM_TRAJECTORY_RECORDER_H
+#define OPENGYM_TRAJECTORY_RECORDER_H
+
+#include "messages.pb.h"
+
+#include <ns3/object.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ns3
+{
+
+class OpenGymDataContainer;
+
+/**
+ * @brief Records the steps of an environment into a directory of columns
+ *
+ * Every Box or Discrete of the observation and action spaces gets a column,
+ * the elements of a Tuple or Dict one each, besides reward, terminated,
+ * truncated and acted. A column is a file of raw, row-major values, one
+ * row per step, which numpy.memmap opens as it is; layout.json describes
+ * them (see python/src/ns3env/trajectory.py).
+ *
+ * Rows are gathered in chunks of chunkSteps steps in memory, which a
+ * writer thread appends to the files, so the simulation only pays for the
+ * copies of the values.
+ */
+class OpenGymTrajectoryRecorder : public Object
+{
+  public:
+    OpenGymTrajectoryRecorder();
+    ~OpenGymTrajectoryRecorder() override;
+
+    static TypeId GetTypeId();
+
+    /**
+     * @brief lay the columns out for the spaces of the init message
+     * @returns false if a space holds something other than Box, Discrete,
+     * Tuple and Dict
+     */
+    bool Configure(const ns3penv::SpaceDescription& obsSpace,
+                   const ns3penv::SpaceDescription& actSpace,
+                   uint32_t chunkSteps = 1024);
+
+    /**
+     * @brief the structs of a typed env (see TypedOpenGymEnv), whose data
+     * comes as one container of raw bytes, are copied field by field from
+     * their offsets into the columns of their Dict spaces. A layout without
+     * fields leaves its side as it is, as does a space that no longer
+     * matches its struct, e.g. once normalized. Call before Configure.
+     */
+    void SetStructLayouts(const ns3penv::StructLayout& obs, const ns3penv::StructLayout& act);
+
+    /**
+     * @brief create the directory path, or empty the columns in it, and
+     * start the writer. Aborts if the files cannot be created.
+     */
+    void Open(const std::string& path);
+    bool IsOpen() const;
+
+    /**
+     * @brief start the row of a state sent to the agent, writing the one
+     * before. The action columns stay zero, and acted 0, until RecordAction.
+     */
+    void RecordState(Ptr<OpenGymDataContainer> obs,
+                     float reward,
+                     bool terminated,
+                     bool truncated);
+
+    /** @brief fill in the action taken on the last state */
+    void RecordAction(Ptr<OpenGymDataContainer> action);
+
+    /** @brief end the episode at the row of the last state, e.g. on a reset */
+    void Truncate();
+
+    /** @brief write out every row, the last one as it is, and wait for the writer */
+    void Flush();
+
+    /** @brief flush, stop the writer and close the files */
+    void Close();
+
+    /** @brief rows written or waiting to be */
+    uint64_t GetSteps() const;
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    struct Column
+    {
+        std::string name;
+        ns3penv::Dtype dtype; // INT64 for a Discrete
+        bool discrete;
+        std::vector<uint32_t> shape;
+        uint32_t rowBytes;
+        int fd;
+    };
+
+    /** the columns of a struct, by the offsets of its fields */
+    struct StructCopy
+    {
+        ns3penv::StructLayout layout;
+        std::vector<std::pair<uint32_t, uint32_t>> fields; // offset, column
+    };
+
+    /** rows of every column, back to back */
+    struct Chunk
+    {
+        std::vector<std::vector<uint8_t>> columns;
+        uint32_t rows;
+    };
+
+    /** @brief add the columns of space, returning its layout as JSON */
+    bool AddColumns(const ns3penv::SpaceDescription& space,
+                    const std::string& name,
+                    std::string& layout);
+    /**
+     * @brief copy data into the row of its columns from column on, zeros
+     * where it does not match space
+     */
+    void CopyData(OpenGymDataContainer* data,
+                  const ns3penv::SpaceDescription& space,
+                  uint32_t& column);
+    /** @brief map the fields of copy to the columns first to last, if they match */
+    void PlanStruct(StructCopy& copy, const std::string& name, uint32_t first, uint32_t last);
+    /**
+     * @brief copy data into the columns of its struct
+     * @returns false if it is no struct of that layout
+     */
+    bool CopyStruct(OpenGymDataContainer* data, const StructCopy& copy);
+    void WarnMismatch(const ns3penv::SpaceDescription& space);
+    /** @brief the value of column in the row being filled */
+    uint8_t* Cell(uint32_t column);
+    Chunk NewChunk() const;
+    void CommitRow();
+    /** @brief hand the chunk to the writer and start another */
+    void SubmitChunk();
+    void WriterLoop();
+
+    std::vector<Column> m_columns;
+    ns3penv::SpaceDescription m_obsSpace;
+    ns3penv::SpaceDescription m_actSpace;
+    StructCopy m_obsStruct;
+    StructCopy m_actStruct;
+    std::vector<uint8_t> m_structBytes; // the struct being copied
+    uint32_t m_actColumn;     // the first action column
+    uint32_t m_rewardColumn;  // followed by terminated, truncated and acted
+    std::string m_layout;     // the spaces as JSON, written by Open
+    uint32_t m_chunkSteps;
+    uint64_t m_steps;
+    bool m_rowOpen;           // the row of the last state awaits its action
+    bool m_mismatchLogged;
+    bool m_open;
+    Chunk m_chunk;            // being filled
+
+    std::thread m_writer;
+    std::mutex m_mutex;
+    std::condition_variable m_wake; // the writer waits for a chunk
+    std::condition_variable m_idle; // Flush waits for the writer
+    std::deque<Chunk> m_queue;      // full chunks to write
+    std::vector<Chunk> m_free;      // written chunks, for reuse
+    bool m_writing;
+    bool m_stop;
+};
+
+} // namespace ns3
+
+#endif /* OPENGYM_TRAJECTORY_RECORDER_H */
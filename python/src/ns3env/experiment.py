@@ -40,6 +40,7 @@ try:
     from . import ns3penv_gym_msg_py as msg
 except ImportError:
     import ns3penv_gym_msg_py as msg
+from .transport import SocketMsgInterface
 
 SIMULATION_EARLY_ENDING = (
     0.5  # wait and see if the subprocess is running after creation
@@ -86,6 +87,15 @@ def run_single_ns3(
     return cmd, proc
 
 
+def local_address(address: str) -> str:
+    """The address a simulation on this host connects to, for the address
+    the agent listens at"""
+    host, _, port = address[len("tcp://") :].rpartition(":")
+    if host.strip("[]") in ("", "0.0.0.0", "::"):
+        host = "127.0.0.1"
+    return f"tcp://{host}:{port}"
+
+
 # used to kill the ns-3 script process and its child processes
 def kill_proc_tree(
     p: int | psutil.Process | subprocess.Popen[str],
@@ -140,11 +150,16 @@ class Experiment:
         handleFinish: bool = False,
         useVector: bool = False,
         vectorSize: int | None = None,
-        shmSize: int = 4096,
+        shmSize: int = 64 * 1024 * 1024,
         segName: str = "My Seg",
         cpp2pyMsgName: str = "My Cpp to Python Msg",
         py2cppMsgName: str = "My Python to Cpp Msg",
         lockableName: str = "My Lockable",
+        waitMode: str = "spin",
+        spinBudget: int = 4096,
+        ringSlots: int = 0,
+        transport: str = "",
+        launch: bool = True,
     ):
         if self._created:
             raise Exception("ns3penv_utils: Error: Experiment is singleton")
@@ -159,22 +174,47 @@ class Experiment:
         self.cpp2pyMsgName = cpp2pyMsgName
         self.py2cppMsgName = py2cppMsgName
         self.lockableName = lockableName
+        self.waitMode = waitMode
+        self.spinBudget = spinBudget
+        self.ringSlots = ringSlots
+        self.msgType = msgType
+        # "tcp://host:port" to exchange the messages over a socket instead of
+        # shared memory; launch=False waits for a simulation started elsewhere
+        # with NS3PENV_TRANSPORT set to an address of this host
+        self.transport = transport
+        self.launch = launch
 
         # FIXME: msg module is not any module, how to type it?
         # one way is to add a protocol
-        self.msgInterface = msgType(
+        self.msgInterface = self.create_interface()
+        self.proc = None
+        self.simCmd = None
+        print("ns3penv_utils: Experiment initialized")
+
+    # create a segment with the settings of the experiment, the names
+    # suffixed with suffix, e.g. one per episode forked from a template
+    # \param[in] suffix : appended to every name
+    def create_interface(self, suffix: str = "") -> msg.Ns3penvMsgInterfaceImpl:
+        if self.transport:
+            if suffix:
+                raise RuntimeError("Forked episodes need the shared memory transport")
+            return SocketMsgInterface(self.transport)
+        return self.msgType(
             True,
             self.useVector,
             self.handleFinish,
             self.shmSize,
-            self.segName,
-            self.cpp2pyMsgName,
-            self.py2cppMsgName,
-            self.lockableName,
+            self.segName + suffix,
+            self.cpp2pyMsgName + suffix,
+            self.py2cppMsgName + suffix,
+            self.lockableName + suffix,
+            # spin: lowest latency, burns a core while the simulator runs
+            # spin_yield / spin_futex: spin for spinBudget attempts, then give up the core
+            getattr(msg.Ns3penvWaitMode, self.waitMode.upper()),
+            self.spinBudget,
+            # ringSlots > 0 adds rings for streamed, non-blocking messages
+            self.ringSlots,
         )
-        self.proc = None
-        self.simCmd = None
-        print("ns3penv_utils: Experiment initialized")
 
     def __del__(self):
         self.kill()
@@ -191,9 +231,20 @@ class Experiment:
         setting: dict[str, str | int | float] | None = None,
         show_output: bool = False,
     ) -> msg.Ns3penvMsgInterfaceImpl:
+        # also drops the connection, the next simulation connects anew
         self.kill()
+        if not self.transport:
+            # the segment outlives the simulation, so that the waits do not
+            # take the one that exited for the next one crashing
+            self.msgInterface.PyForgetPeer()
+        if not self.launch:
+            print("ns3penv_utils: Waiting for ns-3 at", self.transport)
+            return self.msgInterface
+        env = {}
+        if self.transport:
+            env["NS3PENV_TRANSPORT"] = local_address(self.transport)
         self.simCmd, self.proc = run_single_ns3(
-            "./", self.targetName, setting=setting, show_output=show_output
+            "./", self.targetName, setting=setting, env=env, show_output=show_output
         )
         print("ns3penv_utils: Running ns-3 with: ", self.simCmd)
         # exit if an early error occurred, such as wrong target name
@@ -209,9 +260,98 @@ class Experiment:
             kill_proc_tree(self.proc, timeout=None, on_terminate=None)
             self.proc = None
             self.simCmd = None
+        if self.transport:
+            self.msgInterface.Disconnect()
 
     def isalive(self) -> bool:
+        if not self.launch:
+            # a remote simulation is only known to be gone once it disconnects
+            return True
         return self.proc.poll() is None if self.proc is not None else False
 
 
-__all__ = ["Experiment"]
+# This class sets up one batched shared memory segment and runs several
+# simulations on it, simulation i in slot i.
+class BatchExperiment:
+    procs: list[subprocess.Popen[str]]
+
+    # \param[in] targetName : program name of ns3
+    # \param[in] ns3Path : current working directory
+    # \param[in] numEnvs : number of simulations sharing the segment
+    def __init__(
+        self,
+        targetName: str,
+        ns3Path: Path,
+        numEnvs: int,
+        shmSize: int = 64 * 1024 * 1024,
+        segName: str = "My Batch Seg",
+        cpp2pyMsgName: str = "My Cpp to Python Msg",
+        py2cppMsgName: str = "My Python to Cpp Msg",
+        lockableName: str = "My Lockable",
+        waitMode: str = "spin_futex",
+        spinBudget: int = 4096,
+    ):
+        self.targetName = targetName
+        os.chdir(ns3Path)
+        self.numEnvs = numEnvs
+        self.msgInterface = msg.Ns3penvBatchMsgInterfaceImpl(
+            numEnvs,
+            shmSize,
+            segName,
+            cpp2pyMsgName,
+            py2cppMsgName,
+            lockableName,
+            # spinning would burn a core per waiting process with many envs
+            getattr(msg.Ns3penvWaitMode, waitMode.upper()),
+            spinBudget,
+        )
+        self.procs = []
+        print("ns3penv_utils: BatchExperiment initialized")
+
+    def __del__(self):
+        self.kill()
+        del self.msgInterface
+        print("ns3penv_utils: BatchExperiment destroyed")
+
+    # run numEnvs ns3 scripts, simulation i with --batchSlot=i added to
+    # its settings, which it has to pass to Ns3penvMsgInterface::SetBatchSlot
+    # \param[in] settings : one setting for all or one per simulation
+    # \param[in] show_output : whether to show output or not(default : False)
+    def run(
+        self,
+        settings: (
+            dict[str, str | int | float] | list[dict[str, str | int | float]] | None
+        ) = None,
+        show_output: bool = False,
+    ) -> msg.Ns3penvBatchMsgInterfaceImpl:
+        self.kill()
+        if settings is None or isinstance(settings, dict):
+            settings = [dict(settings or {}) for _ in range(self.numEnvs)]
+        if len(settings) != self.numEnvs:
+            raise ValueError(f"Expected {self.numEnvs} settings, got {len(settings)}")
+        for slot, setting in enumerate(settings):
+            setting = dict(setting)
+            setting["batchSlot"] = slot
+            simCmd, proc = run_single_ns3(
+                "./", self.targetName, setting=setting, show_output=show_output
+            )
+            print("ns3penv_utils: Running ns-3 with: ", simCmd)
+            self.procs.append(proc)
+        time.sleep(SIMULATION_EARLY_ENDING)
+        if not all(self.isalive(slot) for slot in range(self.numEnvs)):
+            print("ns3penv_utils: Subprocess died very early")
+            exit(1)
+        signal.signal(signal.SIGINT, sigint_handler)
+        return self.msgInterface
+
+    def kill(self) -> None:
+        for proc in self.procs:
+            if proc.poll() is None:
+                kill_proc_tree(proc, timeout=None, on_terminate=None)
+        self.procs = []
+
+    def isalive(self, slot: int) -> bool:
+        return slot < len(self.procs) and self.procs[slot].poll() is None
+
+
+__all__ = ["Experiment", "BatchExperiment"]
@@ -10,8 +10,44 @@ from numpy.typing import NDArray
 
 POLL_INTERVAL: int = 1  # seconds
 
+# numpy type of the values of each box dtype
+BOX_DTYPES: dict[int, type[np.generic]] = {
+    pb.INT: np.int32,
+    pb.UINT: np.uint32,
+    pb.FLOAT: np.float32,
+    pb.DOUBLE: np.float64,
+    pb.INT8: np.int8,
+    pb.UINT8: np.uint8,
+    pb.INT64: np.int64,
+    pb.FLOAT16: np.float16,
+}
+
+# box dtype of the actions of a numpy type, the types ns3 has no box of are
+# widened to int32 and uint32
+PACK_DTYPES: dict[np.dtype[Any], int] = {
+    np.dtype(np.int8): pb.INT8,
+    np.dtype(np.int16): pb.INT,
+    np.dtype(np.int32): pb.INT,
+    np.dtype(np.int64): pb.INT64,
+    np.dtype(np.uint8): pb.UINT8,
+    np.dtype(np.uint16): pb.UINT,
+    np.dtype(np.uint32): pb.UINT,
+    np.dtype(np.float16): pb.FLOAT16,
+    np.dtype(np.float32): pb.FLOAT,
+    np.dtype(np.float64): pb.DOUBLE,
+}
+
 DataType = np.generic | NDArray[np.generic] | tuple["DataType"] | dict[str, "DataType"]
 
+# the channels states arrive on, each with delta bases of its own
+NOTIFIED = "notified"
+STREAMED = "streamed"
+
+
+class DeltaResyncError(RuntimeError):
+    """A delta-mode box arrived without the base it applies to. The state
+    is dropped; the next action asks ns3 for the full box."""
+
 
 class Ns3Env(gym.Env[Any, Any]):
     exp: Experiment
@@ -32,18 +68,9 @@ class Ns3Env(gym.Env[Any, Any]):
                 high = spaceDesc.box.high
                 shape = tuple(spaceDesc.box.shape)
                 dtype = spaceDesc.box.dtype
-
-                match dtype:
-                    case pb.INT:
-                        mtype = np.int32
-                    case pb.UINT:
-                        mtype = np.uint32
-                    case pb.DOUBLE:
-                        mtype = np.float32
-                    case pb.FLOAT:
-                        mtype = np.float64
-                    case _:
-                        raise ValueError(f"Unknown box dtype {dtype}")
+                if dtype not in BOX_DTYPES:
+                    raise ValueError(f"Unknown box dtype {dtype}")
+                mtype = BOX_DTYPES[dtype]
 
                 return spaces.Box(low=low, high=high, shape=shape, dtype=mtype)
 
@@ -65,79 +92,222 @@ class Ns3Env(gym.Env[Any, Any]):
             case type_:
                 raise TypeError(f"Unknown space type {type_}")
 
-    def _create_data(self, dataContainer: pb.DataContainer) -> Any:
+    def _create_data(
+        self, dataContainer: pb.DataContainer, path: str = "", channel: str = NOTIFIED
+    ) -> Any:
         match dataContainer.WhichOneof("data"):
             case "discrete":
                 return dataContainer.discrete.data
 
             case "box":
                 box = dataContainer.box
-                # TODO: reshape data
                 match box.dtype:
                     case pb.INT:
-                        return np.array(box.intData)
+                        data = np.array(box.intData, dtype=np.int32)
                     case pb.UINT:
-                        return np.array(box.uintData)
+                        data = np.array(box.uintData, dtype=np.uint32)
                     case pb.DOUBLE:
-                        return np.array(box.doubleData)
+                        data = np.array(box.doubleData, dtype=np.float64)
                     case pb.FLOAT:
-                        return np.array(box.floatData)
+                        data = np.array(box.floatData, dtype=np.float32)
+                    case pb.INT64:
+                        data = np.array(box.int64Data, dtype=np.int64)
+                    case pb.INT8 | pb.UINT8 | pb.FLOAT16:
+                        # writable, delta mode patches it in place
+                        mtype = BOX_DTYPES[box.dtype]
+                        data = np.frombuffer(box.byteData, dtype=mtype).copy()
                     case _:
                         raise ValueError(f"Unknown box dtype {box.dtype}")
+                if box.seq != 0:
+                    data = self._apply_delta(box, data, path, channel)
+                if box.shape:
+                    # row-major like the container, fails early on a size mismatch
+                    data = data.reshape(tuple(box.shape))
+                return data
 
-            case pb.Tuple:
+            case "tuple":
                 return tuple(
-                    self._create_data(sub_data)
-                    for sub_data in dataContainer.tuple.element
+                    self._create_data(sub_data, f"{path}/{i}", channel)
+                    for i, sub_data in enumerate(dataContainer.tuple.element)
                 )
 
-            case pb.Dict:
+            case "dict":
                 return {
-                    sub_data.name: self._create_data(sub_data)
+                    sub_data.name: self._create_data(
+                        sub_data, f"{path}/{sub_data.name}", channel
+                    )
                     for sub_data in dataContainer.dict.element
                 }
             case type_:
                 raise TypeError(f"Unknown data type {type_}")
 
+    def _apply_delta(
+        self, box: pb.BoxDataContainer, data: NDArray[np.generic], path: str, channel: str
+    ) -> NDArray[np.generic]:
+        """Keep the box at path of channel up to date from a delta-mode
+        message and return a copy of it. A delta without a base or after a
+        lost message cannot be applied: DeltaResyncError is raised, and the
+        next action asks for the full box.
+        """
+        bases = self._deltaBases.setdefault(channel, {})
+        seqs = self._deltaSeqs.setdefault(channel, {})
+        base = bases.get(path)
+        if not box.isDelta:
+            bases[path] = data
+            seqs[path] = box.seq
+            return data.copy()
+
+        if base is None or box.seq != seqs[path] + 1:
+            self._resyncReq = True
+            # the base stays broken until the full box arrives
+            bases.pop(path, None)
+            raise DeltaResyncError(
+                f"Delta box {path or '/'} of seq {box.seq} has no base on the {channel} channel"
+            )
+
+        pos = 0
+        for offset, length in zip(box.spanOffsets, box.spanLengths):
+            base[offset : offset + length] = data[pos : pos + length]
+            pos += length
+        seqs[path] = box.seq
+        return base.copy()
+
+    def _split_flat(
+        self, space: spaces.Space[Any], data: NDArray[np.generic], pos: int = 0
+    ) -> tuple[Any, int]:
+        """Split the flat values of a dict or tuple of boxes into its boxes. ns3
+        lays them out in space order, dict entries sorted by key.
+        """
+        match space:
+            case spaces.Box():
+                size = int(np.prod(space.shape))
+                return data[pos : pos + size].reshape(space.shape), pos + size
+            case spaces.Tuple():
+                elements = []
+                for sub_space in space.spaces:
+                    element, pos = self._split_flat(sub_space, data, pos)
+                    elements.append(element)
+                return tuple(elements), pos
+            case spaces.Dict():
+                entries = {}
+                for key in sorted(space.spaces):
+                    entries[key], pos = self._split_flat(space.spaces[key], data, pos)
+                return entries, pos
+            case _:
+                raise TypeError(f"Space {space} cannot be flat-encoded")
+
+    def _struct_dtype(self, layout: pb.StructLayout) -> np.dtype[Any]:
+        """The numpy dtype of a struct of a TypedOpenGymEnv, with its padding"""
+        return np.dtype(
+            {
+                "names": [field.name for field in layout.field],
+                "formats": [
+                    (BOX_DTYPES[field.dtype], tuple(field.shape)) for field in layout.field
+                ],
+                "offsets": [field.offset for field in layout.field],
+                "itemsize": layout.size,
+            }
+        )
+
+    def _pack_struct(self, actions: Any) -> bytes:
+        """The action struct of a typed env, from a record of its dtype or
+        a dict of its fields"""
+        assert self.action_struct is not None
+        if isinstance(actions, (np.ndarray, np.void)) and actions.dtype == self.action_struct:
+            return actions.tobytes()
+        record = np.zeros(1, dtype=self.action_struct)
+        for name in self.action_struct.names:
+            record[name][0] = actions[name]
+        return record.tobytes()
+
     def initialize_env(self) -> bool:
         simInitMsg = pb.SimInitMsg()
         if self.msgInterface is not None:
-            self.msgInterface.PyRecvBegin()
-            request = self.msgInterface.GetCpp2PyStruct().get_buffer()
-            simInitMsg.ParseFromString(request)
-            self.msgInterface.PyRecvEnd()
-
-            self.action_space = self._create_space(simInitMsg.actSpace)
-            self.observation_space = self._create_space(simInitMsg.obsSpace)
+            self.msgInterface.PyRecvAndParse(simInitMsg)
+
+            self.flatObs = simInitMsg.flatObs
+            self._warmReset = simInitMsg.warmReset
+            if simInitMsg.spacesCached:
+                # ns3 saw our hash in the segment and left the spaces out
+                if simInitMsg.spaceHash != self._spaceHash:
+                    raise RuntimeError("ns3 skipped spaces this env does not know")
+            else:
+                self.action_space = self._create_space(simInitMsg.actSpace)
+                self.observation_space = self._create_space(simInitMsg.obsSpace)
+                self._spaceHash = simInitMsg.spaceHash
+                self.msgInterface.PySetSpaceHash(self._spaceHash)
+                self.obs_struct = (
+                    self._struct_dtype(simInitMsg.obsStruct)
+                    if simInitMsg.HasField("obsStruct")
+                    else None
+                )
+                self.action_struct = (
+                    self._struct_dtype(simInitMsg.actStruct)
+                    if simInitMsg.HasField("actStruct")
+                    else None
+                )
+            if simInitMsg.HasField("obsNormalizer"):
+                stats = simInitMsg.obsNormalizer
+                self.obs_normalizer = {
+                    "count": stats.count,
+                    "mean": np.array(stats.mean, dtype=np.float64),
+                    "var": np.array(stats.var, dtype=np.float64),
+                    "clip": stats.clip,
+                    "epsilon": stats.epsilon,
+                    "frozen": stats.frozen,
+                }
+            else:
+                self.obs_normalizer = None
 
             reply = pb.SimInitAck()
             reply.done = True
             reply.stopSimReq = False
-            reply_str = reply.SerializeToString()
-            assert len(reply_str) <= self.py_binding.msg_buffer_size
-
-            self.msgInterface.PySendBegin()
-            self.msgInterface.GetPy2CppStruct().size = len(reply_str)
-            self.msgInterface.GetPy2CppStruct().get_buffer_full()[: len(reply_str)] = (
-                reply_str
-            )
-            self.msgInterface.PySendEnd()
+            self.msgInterface.PySendSerialized(reply)
+            if simInitMsg.forkTemplate:
+                # ns3 waits at its checkpoint, the episodes are its children
+                self._forkTemplate = self.msgInterface
+                return self.fork_episode()
             return True
         return False
 
+    def fork_episode(self) -> bool:
+        """Have the fork template start a child playing the next episode
+        from the checkpoint, over a new segment, and initialize it"""
+        if self._forkTemplate is None:
+            return False
+        self._forkEpisode += 1
+        # drops, and so removes, the segment of the previous child
+        self.msgInterface = None
+        self.msgInterface = self.exp.create_interface(f"-{self._forkEpisode}")
+        # the child then leaves out the spaces the template sent
+        self.msgInterface.PySetSpaceHash(self._spaceHash)
+
+        self._forkTemplate.PySendSerialized(pb.ForkRequest(episode=self._forkEpisode))
+        reply = pb.ForkReply()
+        self._forkTemplate.PyRecvAndParse(reply)
+        if reply.pid <= 0:
+            raise RuntimeError(f"ns3 could not fork episode {self._forkEpisode}")
+        return self.initialize_env()
+
     def send_close_command(self) -> bool:
         reply = pb.EnvActMsg()
         reply.stopSimReq = True
 
-        replyMsg = reply.SerializeToString()
-        assert len(replyMsg) <= self.py_binding.msg_buffer_size
         if self.msgInterface is not None:
-            self.msgInterface.PySendBegin()
-            self.msgInterface.GetPy2CppStruct().size = len(replyMsg)
-            self.msgInterface.GetPy2CppStruct().get_buffer_full()[: len(replyMsg)] = (
-                replyMsg
-            )
-            self.msgInterface.PySendEnd()
+            self.msgInterface.PySendSerialized(reply)
+
+            self.newStateRx = False
+            return True
+        return False
+
+    def send_reset_command(self) -> bool:
+        """Ask ns3 to start the next episode in the same process, which it
+        answers with an init message and the first state"""
+        reply = pb.EnvActMsg()
+        reply.resetReq = True
+
+        if self.msgInterface is not None:
+            self.msgInterface.PySendSerialized(reply)
 
             self.newStateRx = False
             return True
@@ -149,25 +319,88 @@ class Ns3Env(gym.Env[Any, Any]):
 
         envStateMsg = pb.EnvStateMsg()
         if self.msgInterface is not None:
-            self.msgInterface.PyRecvBegin()
-            request = self.msgInterface.GetCpp2PyStruct().get_buffer()
-            envStateMsg.ParseFromString(request)
-            self.msgInterface.PyRecvEnd()
-
-            self.obsData = self._create_data(envStateMsg.obsData)
-            self.reward = envStateMsg.reward
-            self.gameOver = envStateMsg.isGameOver
-            self.gameOverReason = envStateMsg.reason
-
-            if self.gameOver:
+            cpp2pyMsg = None
+            if self.flatObs:
+                self.msgInterface.PyRecvBegin()
+                cpp2pyMsg = self.msgInterface.GetCpp2PyStruct()
+            if cpp2pyMsg is not None and cpp2pyMsg.is_flat():
+                # raw box values, copied once out of shared memory
+                header = cpp2pyMsg.get_flat_header()
+                if self.obs_struct is not None:
+                    # the struct of a typed env, its fields are views into
+                    # the one copy
+                    record = np.array(cpp2pyMsg.get_flat_record(self.obs_struct), copy=True)
+                    self.obsData = {name: record[name][0] for name in self.obs_struct.names}
+                else:
+                    self.obsData = np.array(cpp2pyMsg.get_flat_data(), copy=True)
+                if self.obs_struct is None and isinstance(
+                    self.observation_space, (spaces.Dict, spaces.Tuple)
+                ):
+                    # views into the one copy above
+                    self.obsData, _ = self._split_flat(self.observation_space, self.obsData)
+                self.reward = header.reward
+                self.gameOver = bool(header.isGameOver)
+                self.gameOverReason = header.reason
+                self.extraInfo = cpp2pyMsg.get_flat_info()
+                self.msgInterface.PyRecvEnd()
+            else:
+                if cpp2pyMsg is not None:
+                    envStateMsg.ParseFromString(cpp2pyMsg.get_buffer())
+                    self.msgInterface.PyRecvEnd()
+                else:
+                    # waits without the GIL, copies and releases in one call
+                    self.msgInterface.PyRecvAndParse(envStateMsg)
+
+                self.obsData = self._create_data(envStateMsg.obsData)
+                self.reward = envStateMsg.reward
+                self.gameOver = envStateMsg.isGameOver
+                self.gameOverReason = envStateMsg.reason
+                self.extraInfo = envStateMsg.info
+
+            if self.gameOver and not self._warmReset:
                 self.send_close_command()
 
-            self.extraInfo = envStateMsg.info
             if not self.extraInfo:
                 self.extraInfo = {}
 
             self.newStateRx = True
 
+    def poll_streamed_states(self) -> list[tuple[Any, float, bool, str]]:
+        """Drain the states streamed by `OpenGymEnv::Stream` without blocking.
+        Requires `ringSlots` in the msg interface settings.
+        """
+        states: list[tuple[Any, float, bool, str]] = []
+        if self.msgInterface is None or not self.msgInterface.HasRing():
+            return states
+        while (record := self.msgInterface.PyTryRecv()) is not None:
+            envStateMsg = pb.EnvStateMsg()
+            envStateMsg.ParseFromString(record)
+            try:
+                obs = self._create_data(envStateMsg.obsData, channel=STREAMED)
+            except DeltaResyncError:
+                # dropped until the full box comes
+                continue
+            states.append(
+                (
+                    obs,
+                    envStateMsg.reward,
+                    envStateMsg.isGameOver,
+                    envStateMsg.info,
+                )
+            )
+        return states
+
+    def get_step_stats(self) -> dict[str, dict[str, float]] | None:
+        """Read the step statistics recorded by ns3 after
+        `OpenGymInterface::SetRecordStepStats(true)`: count, mean, min, max
+        and percentiles of every phase in nanoseconds and of the message sizes
+        in bytes, and under "out_of_range" the action values clipped and the
+        observation values replaced so far. None if ns3 does not record them.
+        """
+        if self.msgInterface is None:
+            return None
+        return self.msgInterface.GetStats()
+
     def get_obs(self) -> Any | None:
         return self.obsData
 
@@ -191,76 +424,52 @@ class Ns3Env(gym.Env[Any, Any]):
 
             case spaces.Box:
                 assert isinstance(actions, np.ndarray)
-                match spaceDesc.dtype:
-                    case type_ if type_ in ["int", "int8", "int16", "int32", "int64"]:
-                        return pb.DataContainer(
-                            box=pb.BoxDataContainer(
-                                dtype=pb.INT,
-                                shape=actions.shape,
-                                intData=actions,
-                            )
-                        )
-                    case type_ if type_ in [
-                        "uint",
-                        "uint8",
-                        "uint16",
-                        "uint32",
-                        "uint64",
-                    ]:
-                        return pb.DataContainer(
-                            box=pb.BoxDataContainer(
-                                dtype=pb.UINT,
-                                shape=actions.shape,
-                                uintData=actions,
-                            )
-                        )
-                    case type_ if type_ in ["float", "float32", "float64"]:
-                        return pb.DataContainer(
-                            box=pb.BoxDataContainer(
-                                dtype=pb.FLOAT,
-                                shape=actions.shape,
-                                floatData=actions,
-                            )
-                        )
-                    case type_ if type_ in ["double"]:
-                        return pb.DataContainer(
-                            box=pb.BoxDataContainer(
-                                dtype=pb.DOUBLE,
-                                shape=actions.shape,
-                                doubleData=actions,
-                            )
-                        )
+                dtype = PACK_DTYPES.get(np.dtype(spaceDesc.dtype))
+                if dtype is None:
+                    raise ValueError(f"Unknown box dtype {spaceDesc.dtype}")
+                box = pb.BoxDataContainer(dtype=dtype, shape=actions.shape)
+                values = actions.ravel().astype(BOX_DTYPES[dtype], copy=False)
+                match dtype:
+                    case pb.INT:
+                        box.intData.extend(values)
+                    case pb.UINT:
+                        box.uintData.extend(values)
+                    case pb.FLOAT:
+                        box.floatData.extend(values)
+                    case pb.DOUBLE:
+                        box.doubleData.extend(values)
+                    case pb.INT64:
+                        box.int64Data.extend(values)
                     case _:
-                        raise ValueError(f"Unknown box dtype {spaceDesc.dtype}")
+                        box.byteData = values.tobytes()
+                return pb.DataContainer(box=box)
+
             case spaces.Tuple:
                 assert isinstance(actions, tuple)
-                assert isinstance(self.action_space, spaces.Tuple)
+                assert isinstance(spaceDesc, spaces.Tuple)
                 return pb.DataContainer(
                     tuple=pb.TupleDataContainer(
                         element=tuple(
                             self._pack_data(sub_action, sub_space)
-                            for sub_action, sub_space in zip(
-                                actions, self.action_space.spaces
-                            )
+                            for sub_action, sub_space in zip(actions, spaceDesc.spaces)
                         )
                     )
                 )
 
             case spaces.Dict:
                 assert isinstance(actions, dict)
-                assert isinstance(self.action_space, spaces.Dict)
+                assert isinstance(spaceDesc, spaces.Dict)
 
                 def rename(dat: pb.DataContainer, name: str) -> pb.DataContainer:
                     dat.name = name
                     return dat
 
+                # in the order of the space, which is the one ns3 expects
                 return pb.DataContainer(
                     dict=pb.DictDataContainer(
                         element=[
-                            rename(
-                                self._pack_data(sub_data, self.action_space[name]), name
-                            )
-                            for name, sub_data in actions.items()
+                            rename(self._pack_data(actions[name], sub_space), name)
+                            for name, sub_space in spaceDesc.spaces.items()
                         ]
                     )
                 )
@@ -270,18 +479,16 @@ class Ns3Env(gym.Env[Any, Any]):
     def send_actions(self, actions: DataType) -> bool:
         reply = pb.EnvActMsg()
 
-        actionMsg = self._pack_data(actions, self.action_space)
-        reply.actData.CopyFrom(actionMsg)
+        if self.action_struct is not None:
+            reply.actStruct = self._pack_struct(actions)
+        else:
+            actionMsg = self._pack_data(actions, self.action_space)
+            reply.actData.CopyFrom(actionMsg)
+        reply.resyncReq = self._resyncReq
+        self._resyncReq = False
 
-        replyMsg = reply.SerializeToString()
-        assert len(replyMsg) <= self.py_binding.msg_buffer_size
         if self.msgInterface is not None:
-            self.msgInterface.PySendBegin()
-            self.msgInterface.GetPy2CppStruct().size = len(replyMsg)
-            self.msgInterface.GetPy2CppStruct().get_buffer_full()[: len(replyMsg)] = (
-                replyMsg
-            )
-            self.msgInterface.PySendEnd()
+            self.msgInterface.PySendSerialized(reply)
             self.newStateRx = False
             return True
         return False
@@ -300,8 +507,8 @@ class Ns3Env(gym.Env[Any, Any]):
         targetName: str,
         ns3Path: str | Path,
         ns3Settings: dict[str, str | int | float] | None = None,
-        msg_interface_settings: dict[str, str | bool] | None = None,
-        shmSize: int = 4096,
+        msg_interface_settings: dict[str, str | bool | int] | None = None,
+        shmSize: int = 64 * 1024 * 1024,
     ):
         try:
             import ns3penv_gym_msg_py
@@ -326,6 +533,11 @@ class Ns3Env(gym.Env[Any, Any]):
                 py2cppMsgName=msg_interface_settings["py2cppMsgName"],
                 lockableName=msg_interface_settings["lockableName"],
                 handleFinish=msg_interface_settings["handleFinish"],
+                waitMode=str(msg_interface_settings.get("waitMode", "spin")),
+                spinBudget=int(msg_interface_settings.get("spinBudget", 4096)),
+                ringSlots=int(msg_interface_settings.get("ringSlots", 0)),
+                transport=str(msg_interface_settings.get("transport", "")),
+                launch=bool(msg_interface_settings.get("launch", True)),
                 shmSize=shmSize,
             )
         else:
@@ -338,6 +550,21 @@ class Ns3Env(gym.Env[Any, Any]):
         self.ns3Settings = ns3Settings
 
         self.newStateRx = False
+        self.flatObs = False
+        self._spaceHash = 0
+        # numpy dtypes of the structs of a TypedOpenGymEnv
+        self.obs_struct: np.dtype[Any] | None = None
+        self.action_struct: np.dtype[Any] | None = None
+        self._warmReset = False
+        self._forkTemplate = None
+        self._forkEpisode = 0
+        # running statistics of the normalized observations, as of the
+        # last init, when ns3 normalizes them
+        self.obs_normalizer: dict[str, Any] | None = None
+        # by channel, then by the path of the box
+        self._deltaBases: dict[str, dict[str, NDArray[np.generic]]] = {}
+        self._deltaSeqs: dict[str, dict[str, int]] = {}
+        self._resyncReq = False
         self.obsData = None
         self.reward = 0
         self.gameOver = False
@@ -363,21 +590,36 @@ class Ns3Env(gym.Env[Any, Any]):
             obs = self.get_obs()
             return obs, {}
 
+        fork = self._forkTemplate is not None
+        warm = not fork and self._warmReset and self.msgInterface is not None
         # not using self.exp.kill() here in order for semaphores to reset to initial state
         if not self.gameOver:
             self.rx_env_state()
+        if warm:
+            # ns3 rebuilds the episode itself, see OpenGymEnv::RunEpisodes
+            self.send_reset_command()
+        elif not self.gameOver:
             self.send_close_command()
 
-        self.msgInterface = None
+        if not warm and not fork:
+            self.msgInterface = None
         self.newStateRx = False
+        self._deltaBases.clear()
+        self._deltaSeqs.clear()
+        self._resyncReq = False
         self.obsData = None
         self.reward = 0
         self.gameOver = False
         self.gameOverReason = None
         self.extraInfo = None
 
-        self.msgInterface = self.exp.run(show_output=True)
-        self.initialize_env()
+        if fork:
+            # a copy of the process at its checkpoint, in milliseconds
+            self.fork_episode()
+        else:
+            if not warm:
+                self.msgInterface = self.exp.run(show_output=True)
+            self.initialize_env()
         # get first observations
         self.rx_env_state()
         self.envDirty = False
@@ -393,6 +635,9 @@ class Ns3Env(gym.Env[Any, Any]):
         return act
 
     def close(self):
+        # a fork template is killed along with its children, which it
+        # would orphan by exiting first
+        self._forkTemplate = None
         # environment is not needed anymore, so kill subprocess in a straightforward way
         self.exp.kill()
         # destroy the message interface and its shared memory segment
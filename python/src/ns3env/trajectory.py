@@ -0,0 +1,159 @@
+# Copyright (c) 2025 NCSR Demokritos, Greece
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation;
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+#
+# Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+
+"""Reading the recordings of OpenGymTrajectoryRecorder, see
+OpenGymInterface::SetTrajectoryRecording.
+
+A recording is a directory with a file of raw values per column, one row
+per state sent to the agent, and layout.json describing them. Row i holds
+the observation, the reward that came with it, whether the episode
+terminated or was truncated there, and the action the agent answered,
+where acted is 1.
+"""
+
+import json
+import os
+from collections.abc import Iterator
+from pathlib import Path
+from typing import Any
+
+import gymnasium as gym
+import numpy as np
+from numpy.typing import NDArray
+
+
+class Trajectory:
+    """The columns of a recording as numpy memmaps, by name. A recording
+    still being written can be opened, it holds the rows written so far."""
+
+    def __init__(self, path: str | os.PathLike[str]):
+        self.path = Path(path)
+        with open(self.path / "layout.json") as f:
+            self.layout: dict[str, Any] = json.load(f)
+        columns = self.layout["columns"]
+        # the writer appends column by column, the shortest is complete
+        rowBytes = {
+            column["name"]: np.dtype(column["dtype"]).itemsize * int(np.prod(column["shape"]))
+            for column in columns
+        }
+        self.steps = min(
+            os.path.getsize(self.path / column["file"]) // rowBytes[column["name"]]
+            for column in columns
+            if rowBytes[column["name"]] > 0
+        )
+        self.columns: dict[str, NDArray[np.generic]] = {}
+        for column in columns:
+            shape = (self.steps, *column["shape"])
+            if self.steps == 0:
+                self.columns[column["name"]] = np.zeros(shape, dtype=column["dtype"])
+            else:
+                self.columns[column["name"]] = np.memmap(
+                    self.path / column["file"], dtype=column["dtype"], mode="r", shape=shape
+                )
+
+    def __len__(self) -> int:
+        return self.steps
+
+    def __getitem__(self, name: str) -> NDArray[np.generic]:
+        return self.columns[name]
+
+    def _build(self, node: dict[str, Any], step: int) -> Any:
+        if "box" in node:
+            return np.array(self.columns[node["box"]][step])
+        if "discrete" in node:
+            return int(self.columns[node["discrete"]][step])
+        if "tuple" in node:
+            return tuple(self._build(element, step) for element in node["tuple"])
+        if "dict" in node:
+            return {name: self._build(entry, step) for name, entry in node["dict"].items()}
+        raise ValueError(f"Unknown layout node {node}")
+
+    def obs(self, step: int) -> Any:
+        """The observation of a step, shaped as the observation space"""
+        return self._build(self.layout["obs"], step)
+
+    def action(self, step: int) -> Any:
+        """The action of a step, as Ns3Env.step takes it"""
+        return self._build(self.layout["action"], step)
+
+    def episodes(self) -> Iterator[range]:
+        """The steps of every episode, each ending where it terminated or
+        was truncated, the last one where the recording ends"""
+        ends = np.flatnonzero(
+            np.asarray(self.columns["terminated"]) | np.asarray(self.columns["truncated"])
+        )
+        start = 0
+        for end in ends:
+            yield range(start, int(end) + 1)
+            start = int(end) + 1
+        if start < self.steps:
+            yield range(start, self.steps)
+
+
+def load_trajectory(path: str | os.PathLike[str]) -> Trajectory:
+    return Trajectory(path)
+
+
+class ReplayAgent:
+    """A fake agent answering every observation with the next recorded
+    action, e.g. to rerun a recorded episode against a changed scenario."""
+
+    def __init__(self, trajectory: Trajectory | str | os.PathLike[str]):
+        self.trajectory = (
+            trajectory if isinstance(trajectory, Trajectory) else Trajectory(trajectory)
+        )
+        acted = np.asarray(self.trajectory["acted"])
+        self._steps = np.flatnonzero(acted).tolist()
+        self._next = 0
+
+    def act(self, obs: Any = None) -> Any:
+        """The next recorded action, StopIteration once there are none"""
+        if self._next >= len(self._steps):
+            raise StopIteration
+        step = self._steps[self._next]
+        self._next += 1
+        return self.trajectory.action(step)
+
+
+def replay(
+    env: gym.Env[Any, Any], trajectory: Trajectory | str | os.PathLike[str]
+) -> list[tuple[float, float]]:
+    """Plays the recorded actions episode by episode in env, resetting it
+    where a recorded episode ended. Returns the recorded and the replayed
+    return of every episode."""
+    if not isinstance(trajectory, Trajectory):
+        trajectory = Trajectory(trajectory)
+    rewards = np.asarray(trajectory["reward"])
+    acted = np.asarray(trajectory["acted"])
+    returns: list[tuple[float, float]] = []
+    for episode in trajectory.episodes():
+        env.reset()
+        # the reward of a state was earned by the action before it
+        recorded = float(rewards[episode.start + 1 : episode.stop].sum())
+        replayed = 0.0
+        for step in episode:
+            if not acted[step]:
+                break
+            _, reward, terminated, truncated, _ = env.step(trajectory.action(step))
+            replayed += float(reward)
+            if terminated or truncated:
+                break
+        returns.append((recorded, replayed))
+    return returns
+
+
+__all__ = ["Trajectory", "load_trajectory", "ReplayAgent", "replay"]
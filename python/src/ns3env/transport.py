@@ -0,0 +1,261 @@
+# Copyright (c) 2025 NCSR Demokritos, Greece
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation;
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+#
+# Author:  Orfeas Karachalios <okarachalios@iit.demokritos.gr>
+
+"""The Python end of Ns3penvSocketTransport, for a simulation on another
+host. It has the methods of Ns3penvMsgInterfaceImpl that Ns3Env uses, so it
+can take the place of the shared memory segment.
+
+Every message is a frame: a little endian header of size and channel,
+followed by size bytes of payload, the same EnvStateMsg, EnvActMsg or flat
+state as in shared memory.
+"""
+
+import socket
+import struct
+from collections import deque
+from typing import Any
+
+import numpy as np
+from numpy.typing import NDArray
+
+FRAME_HEADER = struct.Struct("<II")  # Ns3penvFrameHeader
+FRAME_MESSAGE = 0
+FRAME_RECORD = 1
+FRAME_HELLO = 2
+RECV_CHUNK = 256 * 1024  # bytes asked of recv, so small frames come in together
+
+# Ns3penvFlatStateHeader, see model/ns3penv-flat-msg.h
+FLAT_HEADER = struct.Struct("<IHHI8IfBBHIII")
+FLAT_MAGIC = 0x4650334E
+
+# numpy type of each flat dtype, in ns3penv::Dtype order
+FLAT_DTYPES = {
+    1: np.int32,
+    2: np.uint32,
+    3: np.float32,
+    4: np.float64,
+    5: np.int8,
+    6: np.uint8,
+    7: np.int64,
+    8: np.float16,
+}
+
+
+class FlatStateHeader:
+    """The fields of a flat state header the Ns3Env reads"""
+
+    def __init__(self, buffer: memoryview):
+        fields = FLAT_HEADER.unpack_from(buffer)
+        self.magic = fields[0]
+        self.dtype = fields[2]
+        self.ndim = fields[3]
+        self.shape = tuple(fields[4 : 4 + self.ndim])
+        self.reward, self.isGameOver, self.reason = fields[12:15]
+        self.infoSize, self.dataOffset, self.dataSize = fields[16:19]
+
+
+class SocketMsg:
+    """A received message, with the accessors of Ns3penvGymMsg"""
+
+    def __init__(self, buffer: bytes):
+        self.buffer = memoryview(buffer)
+        self.size = len(buffer)
+
+    def get_buffer(self) -> memoryview:
+        return self.buffer
+
+    def is_flat(self) -> bool:
+        return (
+            self.size >= FLAT_HEADER.size
+            and struct.unpack_from("<I", self.buffer)[0] == FLAT_MAGIC
+        )
+
+    def get_flat_header(self) -> FlatStateHeader:
+        return FlatStateHeader(self.buffer)
+
+    def get_flat_info(self) -> str:
+        header = self.get_flat_header()
+        start = FLAT_HEADER.size
+        return bytes(self.buffer[start : start + header.infoSize]).decode()
+
+    def get_flat_data(self) -> NDArray[np.generic]:
+        # a view into the received frame, valid until PyRecvEnd
+        header = self.get_flat_header()
+        data = np.frombuffer(
+            self.buffer,
+            dtype=FLAT_DTYPES[header.dtype],
+            count=header.dataSize // np.dtype(FLAT_DTYPES[header.dtype]).itemsize,
+            offset=header.dataOffset,
+        )
+        return data.reshape(header.shape)
+
+    def get_flat_record(self, dtype: np.dtype[Any]) -> NDArray[np.void]:
+        # the struct of a typed env, one record viewing the received frame
+        header = self.get_flat_header()
+        if header.dataSize != dtype.itemsize:
+            raise ValueError(
+                f"Flat state of {header.dataSize} bytes does not match the struct of {dtype.itemsize}"
+            )
+        return np.frombuffer(self.buffer, dtype=dtype, count=1, offset=header.dataOffset)
+
+
+class SocketMsgInterface:
+    """Listens at address, "tcp://host:port", for the simulation to connect.
+
+    The connection is accepted on the first message, so a simulation can be
+    started after the interface. Streamed records that come in while
+    waiting for a message are kept for PyTryRecv.
+    """
+
+    def __init__(self, address: str, timeout: float | None = None):
+        scheme = "tcp://"
+        host, sep, port = address[len(scheme) :].rpartition(":")
+        if not address.startswith(scheme) or not sep:
+            raise ValueError(f"Transport address {address} is not of the form tcp://host:port")
+        host = host.strip("[]") or "0.0.0.0"
+        family = socket.AF_INET6 if ":" in host else socket.AF_INET
+        self.address = address
+        self.timeout = timeout
+        self._listener = socket.socket(family, socket.SOCK_STREAM)
+        self._listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self._listener.bind((host, int(port)))
+        self._listener.listen(1)
+        self._conn: socket.socket | None = None
+        self._spaceHash = 0
+        self._records: deque[bytes] = deque()
+        self._message: SocketMsg | None = None
+        self._in = bytearray()  # received bytes from _start on
+        self._start = 0
+        self._pending: bytes | None = None  # a message PyTryRecv came across
+
+    def __del__(self):
+        self.Disconnect()
+        self._listener.close()
+
+    def _connection(self) -> socket.socket:
+        if self._conn is None:
+            self._listener.settimeout(self.timeout)
+            conn, _ = self._listener.accept()
+            conn.settimeout(None)
+            # every message is a round trip, coalescing only adds latency
+            conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            self._conn = conn
+            self._send_frame(FRAME_HELLO, struct.pack("<Q", self._spaceHash))
+        return self._conn
+
+    def _send_frame(self, channel: int, payload: bytes) -> None:
+        assert self._conn is not None
+        self._conn.sendmsg([FRAME_HEADER.pack(len(payload), channel), payload])
+
+    def _fill(self, wait: bool) -> bool:
+        """Takes in what has arrived, waiting for it if wait"""
+        conn = self._connection()
+        if self._start > len(self._in) // 2:
+            del self._in[: self._start]
+            self._start = 0
+        if not wait:
+            conn.setblocking(False)
+        try:
+            chunk = conn.recv(RECV_CHUNK)
+        except BlockingIOError:
+            return False
+        finally:
+            if not wait:
+                conn.setblocking(True)
+        if not chunk:
+            raise ConnectionError(f"The simulation at {self.address} disconnected")
+        self._in += chunk
+        return True
+
+    def _take_records(self) -> bytes | None:
+        """Moves the complete records at the front of the buffer to the
+        queue, returning the message that follows them, if it is complete"""
+        while len(self._in) - self._start >= FRAME_HEADER.size:
+            size, channel = FRAME_HEADER.unpack_from(self._in, self._start)
+            begin = self._start + FRAME_HEADER.size
+            if len(self._in) < begin + size:
+                return None
+            payload = bytes(self._in[begin : begin + size])
+            self._start = begin + size
+            if channel == FRAME_MESSAGE:
+                return payload
+            if channel != FRAME_RECORD:
+                raise ConnectionError(f"Unexpected frame on channel {channel}")
+            self._records.append(payload)
+        return None
+
+    def _recv_message(self) -> bytes:
+        if self._pending is not None:
+            message, self._pending = self._pending, None
+            return message
+        while (message := self._take_records()) is None:
+            self._fill(True)
+        return message
+
+    def Disconnect(self) -> None:
+        """Closes the connection, the next message waits for a new one"""
+        if self._conn is not None:
+            self._conn.close()
+            self._conn = None
+        self._records.clear()
+        self._message = None
+        self._in.clear()
+        self._start = 0
+        self._pending = None
+
+    def PySetSpaceHash(self, spaceHash: int) -> None:
+        self._spaceHash = spaceHash
+        if self._conn is not None:
+            self._send_frame(FRAME_HELLO, struct.pack("<Q", spaceHash))
+
+    def GetSpaceHash(self) -> int:
+        return self._spaceHash
+
+    def PySendSerialized(self, message: Any) -> None:
+        self._connection()
+        payload = message if isinstance(message, bytes) else message.SerializeToString()
+        self._send_frame(FRAME_MESSAGE, payload)
+
+    def PyRecvAndParse(self, message: Any) -> None:
+        message.ParseFromString(self._recv_message())
+
+    def PyRecvBegin(self) -> None:
+        self._message = SocketMsg(self._recv_message())
+
+    def GetCpp2PyStruct(self) -> SocketMsg | None:
+        return self._message
+
+    def PyRecvEnd(self) -> None:
+        self._message = None
+
+    def HasRing(self) -> bool:
+        return True
+
+    def PyTryRecv(self) -> bytes | None:
+        """The oldest streamed record, None if none has arrived"""
+        if not self._records and self._conn is not None and self._pending is None:
+            self._pending = self._take_records()
+            while self._pending is None and self._fill(False):
+                self._pending = self._take_records()
+        return self._records.popleft() if self._records else None
+
+    def GetStats(self) -> None:
+        # the step statistics live in the shared memory segment
+        return None
+
+
+__all__ = ["SocketMsgInterface"]